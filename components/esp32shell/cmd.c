@@ -27,6 +27,8 @@ void cmd_init(void) {
     cmd_register_task("test", task_test, "参数测试命令");
     cmd_register_task("kv", task_kv, "键值存储操作");
     cmd_register_task("buffer", task_buffer, "显示命令缓冲区");
+    cmd_register_task("jobs", task_jobs, "列出后台作业");
+    cmd_register_task("kill", task_kill, "终止后台作业");
     
     // 注册系统命令
     cmd_register_task("status", task_status, "显示系统状态");
@@ -7,6 +7,7 @@
 #include "freertos/task.h"
 #include "string.h"
 #include "stdio.h"
+#include "stdlib.h"
 #include "stdbool.h"
 
 // 命令帮助信息结构
@@ -44,9 +45,11 @@ static const cmd_help_info_t cmd_help_table[] = {
      "kv del mykey\r\n"
      "kv clear"},
     
-    {"buffer", "buffer [操作] [参数]", "宏缓冲区管理",
+    {"buffer", "buffer [操作] [参数]", "宏缓冲区管理，buffer tx查看输出缓冲区统计并设置本通道命令输出的满时策略(block/drop，其他任务的输出总是满时丢弃)",
      "buffer\r\n"
      "buffer list\r\n"
+     "buffer tx\r\n"
+     "buffer tx drop\r\n"
      "buffer show mymacro\r\n"
      "buffer exec mymacro\r\n"
      "buffer del mymacro\r\n"
@@ -147,9 +150,12 @@ static const cmd_help_info_t cmd_help_table[] = {
      "find data"},
      
     // 宏相关命令
-    {"macro", "macro <宏名称>", "开始录制宏命令",
+    {"macro", "macro <宏名称>", "开始录制宏命令，宏内可用控制流: label <标签>, goto <标签> [键名], loop <次数>/endloop, while <键名>/endwhile, break, inc/dec <键名> [步长], exit",
      "macro mymacro\r\n"
-     "macro backup_files"},
+     "macro backup_files\r\n"
+     "loop 10 ... endloop\r\n"
+     "while count ... dec count ... endwhile\r\n"
+     "label retry ... goto retry error"},
      
     {"endmacro", "endmacro", "停止录制宏命令", "endmacro"},
     
@@ -161,12 +167,45 @@ static const cmd_help_info_t cmd_help_table[] = {
      "jump status 5\r\n"
      "jump count 10"},
      
+    // 后台作业命令（命令行末尾加&在后台执行）
+    {"jobs", "jobs", "列出后台作业。命令末尾加&在后台执行，控制台可继续使用",
+     "cp big.bin backup.bin &\r\n"
+     "led all blink 100 500 &\r\n"
+     "jobs"},
+     
+    {"kill", "kill <作业号>", "终止后台作业",
+     "kill 3"},
+     
     // 自定义测试命令
-    {"test", "test", "开始自动化测试(IO1-8循环,LED1-4循环,终端持续打印)",
-     "test"},
+    {"test", "test [period <毫秒>|status|plan [load <文件>|default|pattern <图案>]|console <模式>|capture [on|off]|trigger [on|off|fire|set]|pins <掩码>|checkpoint <秒>|resume [会话]|sessions|watch <会话>|unwatch]", "按测试计划执行自动化测试(每个通道一个会话,默认IO1-8循环,LED1-4循环,终端限速打印)",
+     "test\r\n"
+     "test period 10\r\n"
+     "test status\r\n"
+     "test plan load /sdcard/testplan.txt\r\n"
+     "test plan\r\n"
+     "test plan pattern walk0 0xFFFF 100\r\n"
+     "test console every 20\r\n"
+     "test console change 0.5\r\n"
+     "test console status\r\n"
+     "test capture on 0 100\r\n"
+     "test trigger set ch=3 src=level,io level=50 pre=64 post=192\r\n"
+     "test trigger on\r\n"
+     "test pins 0x00FF 0x3\r\n"
+     "test checkpoint 30\r\n"
+     "test resume\r\n"
+     "test sessions\r\n"
+     "test watch 1"},
      
-    {"testoff", "testoff", "停止自动化测试",
-     "testoff"},
+    {"testoff", "testoff [会话]", "停止自动化测试(默认本通道的会话)。紧急命令，不排在其他命令之后，立即执行并中断本通道的宏",
+     "testoff\r\n"
+     "testoff 2"},
+     
+    {"teststat", "teststat [hist <阶段>|reset] [会话]", "显示测试会话各阶段耗时统计(ADC/TCA9535/LED/SD/终端)，默认本通道的会话",
+     "teststat\r\n"
+     "teststat 2\r\n"
+     "teststat hist adc\r\n"
+     "teststat hist capture 2\r\n"
+     "teststat reset"},
      
     {"encoding", "encoding [status|utf8|gb2312]", "配置字符编码格式",
      "encoding"}
@@ -236,12 +275,12 @@ void task_help(uint32_t channel_id, const char *params) {
             }
         }
         
-        shell_snprintf(response, sizeof(response), "\r\n【宏命令】\r\n");
+        shell_snprintf(response, sizeof(response), "\r\n【宏和后台作业命令】\r\n");
         cmd_output(channel_id, (uint8_t *)response, strlen(response));
         
         // 显示宏命令
         for (size_t i = 0; i < cmd_help_table_size; i++) {
-            if (i >= 30 && i <= 33) { // 宏命令 (macro, endmacro, exec, jump)
+            if (i >= 30 && i <= 35) { // 宏和后台作业命令 (macro, endmacro, exec, jump, jobs, kill)
                 shell_snprintf(response, sizeof(response), "  %-12s - %s\r\n", 
                         cmd_help_table[i].name, cmd_help_table[i].description);
                 cmd_output(channel_id, (uint8_t *)response, strlen(response));
@@ -253,7 +292,7 @@ void task_help(uint32_t channel_id, const char *params) {
         
         // 显示测试命令
         for (size_t i = 0; i < cmd_help_table_size; i++) {
-            if (i >= 34) { // 测试命令 (test, testoff, encoding)
+            if (i >= 36) { // 测试命令 (test, testoff, encoding)
                 shell_snprintf(response, sizeof(response), "  %-12s - %s\r\n", 
                         cmd_help_table[i].name, cmd_help_table[i].description);
                 cmd_output(channel_id, (uint8_t *)response, strlen(response));
@@ -568,6 +607,41 @@ void task_buffer(uint32_t channel_id, const char *params) {
         
         shell_snprintf(response, sizeof(response), "==================\r\n");
         cmd_output(channel_id, (uint8_t *)response, strlen(response));
+    } else if (strncmp(params, "tx", 2) == 0 && (params[2] == '\0' || params[2] == ' ')) {
+        // 输出缓冲区统计和满时的处理策略
+        const char *arg = params + 2;
+        while (*arg == ' ') arg++; // 跳过空格
+        shell_tx_t *tx = &instance->tx;
+        
+        if (strcmp(arg, "block") == 0) {
+            tx->policy = SHELL_TX_BLOCK;
+        } else if (strcmp(arg, "drop") == 0) {
+            tx->policy = SHELL_TX_DROP;
+        } else if (strcmp(arg, "reset") == 0) {
+            memset(&tx->stats, 0, sizeof(tx->stats));
+        } else if (strlen(arg) > 0) {
+            shell_snprintf(response, sizeof(response), "用法: buffer tx [block|drop|reset]\r\n");
+            cmd_output(channel_id, (uint8_t *)response, strlen(response));
+            return;
+        }
+        
+        // 先取统计，避免本次输出计入
+        shell_tx_stats_t stats = tx->stats;
+        uint32_t pending = tx->head - tx->tail;
+        shell_snprintf(response, sizeof(response),
+                "=== 输出缓冲区 ===\r\n"
+                "策略: %s\r\n"
+                "待发送: %lu/%d 字节 (最大 %lu)\r\n"
+                "写入: %lu 字节, 发出: %lu 字节, 输出调用: %lu 次\r\n"
+                "丢弃: %lu 字节 (%lu 次), 等待空间: %lu 次\r\n"
+                "最大排队时间: %lu us\r\n"
+                "==================\r\n",
+                tx->policy == SHELL_TX_DROP ? "满时丢弃" : "满时等待",
+                (unsigned long)pending, SHELL_TX_BUFFER_SIZE, (unsigned long)stats.max_pending,
+                (unsigned long)stats.queued_bytes, (unsigned long)stats.sent_bytes, (unsigned long)stats.flushes,
+                (unsigned long)stats.dropped_bytes, (unsigned long)stats.dropped_writes,
+                (unsigned long)stats.blocked_writes, (unsigned long)stats.max_latency_us);
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
     } else if (strncmp(params, "exec", 4) == 0) {
         // 执行宏
         const char *macro_name = params + 4;
@@ -665,6 +739,7 @@ void task_buffer(uint32_t channel_id, const char *params) {
                 "buffer clear              - 清空所有宏\r\n"
                 "buffer exec [宏名称]      - 执行宏\r\n"
                 "buffer del <宏名称>       - 删除指定宏\r\n"
+                "buffer tx [block|drop|reset] - 输出缓冲区统计和满时策略\r\n"
                 "\r\n"
                 "宏录制命令:\r\n"
                 "macro <名称>              - 开始录制宏\r\n"
@@ -673,4 +748,26 @@ void task_buffer(uint32_t channel_id, const char *params) {
                 "exec <宏名称>             - 执行指定宏\r\n");
         cmd_output(channel_id, (uint8_t *)response, strlen(response));
     }
-}
\ No newline at end of file
+}
+
+void task_jobs(uint32_t channel_id, const char *params) {
+    char response[1024];
+    shell_job_list(response, sizeof(response));
+    if (strlen(response) == 0) {
+        shell_snprintf(response, sizeof(response), "没有后台作业\r\n");
+    }
+    cmd_output(channel_id, (uint8_t *)response, strlen(response));
+}
+
+void task_kill(uint32_t channel_id, const char *params) {
+    char response[128];
+    uint32_t job_id = (uint32_t)strtoul(params, NULL, 10);
+    if (job_id == 0) {
+        shell_snprintf(response, sizeof(response), "用法: kill <作业号>\r\n");
+    } else if (shell_job_kill(job_id)) {
+        shell_snprintf(response, sizeof(response), "已请求终止作业 [%lu]\r\n", job_id);
+    } else {
+        shell_snprintf(response, sizeof(response), "错误: 作业 [%lu] 不存在\r\n", job_id);
+    }
+    cmd_output(channel_id, (uint8_t *)response, strlen(response));
+}
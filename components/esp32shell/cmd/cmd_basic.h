@@ -58,6 +58,20 @@ void task_kv(uint32_t channel_id, const char *params);
  */
 void task_buffer(uint32_t channel_id, const char *params);
 
+/**
+ * @brief 列出后台作业
+ * @param channel_id 通信通道ID
+ * @param params 参数
+ */
+void task_jobs(uint32_t channel_id, const char *params);
+
+/**
+ * @brief 终止后台作业
+ * @param channel_id 通信通道ID
+ * @param params 作业号
+ */
+void task_kill(uint32_t channel_id, const char *params);
+
 #ifdef __cplusplus
 }
 #endif
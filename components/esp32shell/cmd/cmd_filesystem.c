@@ -516,6 +516,13 @@ void task_cp(uint32_t channel_id, const char *params) {
     size_t total_bytes = 0;
     
     while ((bytes_read = fread(buffer, 1, sizeof(buffer), src_file)) > 0) {
+        if (shell_job_cancelled()) {
+            shell_snprintf(response, sizeof(response), "复制已终止，已复制 %zu 字节\r\n", total_bytes);
+            fclose(src_file);
+            fclose(dst_file);
+            cmd_output(channel_id, (uint8_t *)response, strlen(response));
+            return;
+        }
         bytes_written = fwrite(buffer, 1, bytes_read, dst_file);
         if (bytes_written != bytes_read) {
             shell_snprintf(response, sizeof(response), "错误: 写入失败\r\n");
@@ -760,7 +767,7 @@ void task_du(uint32_t channel_id, const char *params) {
     long total_size = 0;
     int file_count = 0;
     
-    while ((entry = readdir(dir)) != NULL) {
+    while ((entry = readdir(dir)) != NULL && !shell_job_cancelled()) {
         char full_path[MAX_PATH_LEN];
         if (strlen(target_path) <= SAFE_PATH_LEN && strlen(entry->d_name) <= 255) {
             strcpy(full_path, target_path);
@@ -818,7 +825,7 @@ void task_find(uint32_t channel_id, const char *params) {
     struct dirent *entry;
     int found_count = 0;
     
-    while ((entry = readdir(dir)) != NULL) {
+    while ((entry = readdir(dir)) != NULL && !shell_job_cancelled()) {
         // 简单的字符串匹配
         if (strstr(entry->d_name, params) != NULL) {
             // 检查输出字符串长度避免截断
@@ -3,6 +3,7 @@
 #include "shell.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_heap_caps.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <stdio.h>
@@ -58,6 +59,7 @@ void task_heap(uint32_t channel_id, const char *params) {
     char response[512];
     size_t free_heap = esp_get_free_heap_size();
     size_t min_free_heap = esp_get_minimum_free_heap_size();
+    size_t largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
     
     // 获取总堆内存大小（ESP32-S3通常是512KB）
     size_t total_heap = 512 * 1024; // 512KB
@@ -74,12 +76,27 @@ void task_heap(uint32_t channel_id, const char *params) {
              "已用内存: %lu bytes (%.1f%%)\r\n"
              "可用内存: %lu bytes (%.1f%%)\r\n"
              "最小可用: %lu bytes (%.1f%%)\r\n"
+             "最大空闲块: %lu bytes\r\n"
              "==================\r\n",
              (unsigned long)total_heap,
              (unsigned long)used_heap, used_percent,
              (unsigned long)free_heap, free_percent,
-             (unsigned long)min_free_heap, min_free_percent);
+             (unsigned long)min_free_heap, min_free_percent,
+             (unsigned long)largest_block);
     cmd_output(channel_id, (uint8_t *)response, strlen(response));
+    
+    // 本通道shell实例的命令池使用情况
+    shell_instance_t *instance = shell_get_instance_by_channel(channel_id);
+    if (instance != NULL) {
+        char pool_stats[320];
+        cmd_pool_stats(instance->cmd_pool, pool_stats, sizeof(pool_stats));
+        shell_snprintf(response, sizeof(response),
+                 "=== 命令池 ===\r\n"
+                 "%s"
+                 "==================\r\n",
+                 pool_stats);
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+    }
 }
 
 void task_uptime(uint32_t channel_id, const char *params) {
@@ -236,8 +253,11 @@ void task_delay(uint32_t channel_id, const char *params) {
         if (ms > 0) {
             shell_snprintf(response, sizeof(response), "延时 %d 毫秒...\r\n", ms);
             cmd_output(channel_id, (uint8_t *)response, strlen(response));
-            vTaskDelay(pdMS_TO_TICKS(ms));
-            shell_snprintf(response, sizeof(response), "延时完成\r\n");
+            if (shell_job_delay(ms)) {
+                shell_snprintf(response, sizeof(response), "延时完成\r\n");
+            } else {
+                shell_snprintf(response, sizeof(response), "延时已终止\r\n");
+            }
         } else {
             shell_snprintf(response, sizeof(response), "错误: 无效的延时时间 '%s'\r\n", params);
         }
@@ -8,11 +8,21 @@
 #include <stddef.h>
 #include <stdint.h>
 
-// 命令缓冲区大小
+// 命令缓冲区大小（必须为2的幂，下标用掩码回绕）
 #define CMD_BUFFER_SIZE 2048
+#define CMD_BUFFER_MASK (CMD_BUFFER_SIZE - 1)
+// 缓冲区满时等待解析任务腾出空间的最长时间
+#define CMD_BUFFER_WAIT_MS 200
 #define MAX_CMD_LENGTH 512
-#define MAX_TASKS 32
+#define CMD_LINE_SLOTS 8                      // 待执行命令行槽数（必须为2的幂）
+#define SHELL_URGENT_SLOTS 4                  // 待执行紧急命令行槽数（必须为2的幂）
+#define SHELL_URGENT_LENGTH 128               // 紧急命令行最大长度（含结束符）
+#define CMD_TABLE_INIT_CAPACITY 32           // 命令表初始容量，注册满时自动加倍
 #define MAX_SHELL_INSTANCES 4
+#define SHELL_JOB_WORKERS 2                   // 后台作业工作任务数（所有通道共用）
+#define SHELL_MAX_JOBS 8                      // 同时存在（排队或运行）的后台作业数
+
+_Static_assert((CMD_BUFFER_SIZE & CMD_BUFFER_MASK) == 0, "CMD_BUFFER_SIZE必须为2的幂");
 
 // 命令缓冲区结构
 typedef struct cmd_buffer {
@@ -20,17 +30,65 @@ typedef struct cmd_buffer {
   size_t head;
   size_t tail;
   size_t count;
+  size_t scanned;                             // 已查找过行结束符的长度（从tail起）
+  size_t line_end;                            // 最后一个完整行的结束位置（从tail起），0为没有
+  bool discarding;                            // 溢出后丢弃数据直到下一个行结束符
+  uint32_t overflow_count;                    // 溢出次数
+  uint32_t dropped_bytes;                     // 溢出丢弃的字节数
   SemaphoreHandle_t mutex;
 } cmd_buffer_t;
 
+_Static_assert((CMD_LINE_SLOTS & (CMD_LINE_SLOTS - 1)) == 0, "CMD_LINE_SLOTS必须为2的幂");
+_Static_assert((SHELL_URGENT_SLOTS & (SHELL_URGENT_SLOTS - 1)) == 0, "SHELL_URGENT_SLOTS必须为2的幂");
+
+// 命令池初始容量（每个shell实例一份，创建实例时一次性分配，用满后按块追加，可在编译选项中覆盖）
+#ifndef CMD_POOL_ITEMS
+#define CMD_POOL_ITEMS 128                    // 命令节点数（宏命令行共用）
+#endif
+#ifndef CMD_POOL_MACROS
+#define CMD_POOL_MACROS 16                    // 宏数量
+#endif
+#ifndef CMD_POOL_GROW_ITEMS
+#define CMD_POOL_GROW_ITEMS 64                // 命令节点用满后每次追加的节点数
+#endif
+#define CMD_POOL_CLASS_COUNT 4                // 命令行存储的尺寸等级数
+#define CMD_POOL_CLASS_SIZES {32, 64, 128, MAX_CMD_LENGTH}
+#ifndef CMD_POOL_CLASS_BLOCKS
+#define CMD_POOL_CLASS_BLOCKS {64, 32, 16, 4} // 各尺寸等级的初始块数，用满后每次追加同样多
+#endif
+
+// 命令行槽：解析任务从缓冲区直接取行写入，执行任务在槽内原地解析执行
+typedef struct {
+  char lines[CMD_LINE_SLOTS][MAX_CMD_LENGTH];
+  volatile uint32_t head;                     // 已写入的行数（只由解析任务修改）
+  volatile uint32_t tail;                     // 已执行的行数（只由执行任务修改）
+  SemaphoreHandle_t free_slots;               // 空闲槽计数
+} cmd_line_slots_t;
+
+// 紧急命令通道：接收的数据写入命令缓冲区之前逐字节识别紧急命令行，
+// 识别出的行不进命令缓冲区，不受缓冲区背压和溢出丢弃的影响，由控制任务执行
+typedef struct {
+  char lines[SHELL_URGENT_SLOTS][SHELL_URGENT_LENGTH];
+  volatile uint32_t head;                     // 已识别的行数（只由接收方修改）
+  volatile uint32_t tail;                     // 已执行的行数（只由控制任务修改）
+  char pending[SHELL_URGENT_LENGTH];          // 当前行：命令名确定前暂存的开头部分，或紧急命令行
+  size_t pending_length;
+  uint8_t state;                              // 当前行的识别状态
+  uint32_t dropped;                           // 槽满丢弃的紧急命令数
+} shell_urgent_t;
+
 // 任务函数指针类型
 typedef void (*task_func_t)(uint32_t channel_id, const char *params);
 
+// 命令标志
+#define CMD_TASK_URGENT 0x01                  // 紧急命令：接收时识别，不排队，由控制任务立即执行并中断本通道的宏
+
 // 命令任务结构
 typedef struct {
   const char *cmd_name;
   task_func_t task_func;
   const char *description;
+  uint8_t flags;                              // CMD_TASK_*
 } cmd_task_t;
 
 // I/O函数指针类型
@@ -46,13 +104,123 @@ typedef struct {
   void *user_data;                            // 用户自定义数据（用于存储当前工作目录）
 } shell_config_t;
 
+// 输出缓冲区：cmd_output写入后由发送任务调用输出函数，调用者不等待数据发出
+#define SHELL_TX_BUFFER_SIZE 2048             // 每个通道的输出缓冲区大小（必须为2的幂）
+#define SHELL_TX_BUFFER_MASK (SHELL_TX_BUFFER_SIZE - 1)
+#define SHELL_TX_CHUNK 256                    // 发送任务每次交给输出函数的最大字节数
+#define SHELL_TX_BLOCK_MS 200                 // 阻塞策略下本通道命令输出等待缓冲区空间的最长时间
+#define SHELL_TX_MARKS 32                     // 记录写入时间的标记数（必须为2的幂）
+
+_Static_assert((SHELL_TX_BUFFER_SIZE & SHELL_TX_BUFFER_MASK) == 0, "SHELL_TX_BUFFER_SIZE必须为2的幂");
+_Static_assert((SHELL_TX_MARKS & (SHELL_TX_MARKS - 1)) == 0, "SHELL_TX_MARKS必须为2的幂");
+
+// 输出缓冲区满时的处理策略（只约束本通道执行任务，其他任务的输出总是满时丢弃）
+typedef enum {
+  SHELL_TX_BLOCK = 0,                         // 等待发送任务腾出空间，超时后丢弃剩余部分
+  SHELL_TX_DROP,                              // 放不下时整条丢弃，不等待
+} shell_tx_policy_t;
+
+// 输出缓冲区统计
+typedef struct {
+  uint32_t queued_bytes;                      // 写入缓冲区的字节数
+  uint32_t sent_bytes;                        // 已交给输出函数的字节数
+  uint32_t dropped_bytes;                     // 缓冲区满丢弃的字节数
+  uint32_t dropped_writes;                    // 被丢弃（或部分丢弃）的输出次数
+  uint32_t blocked_writes;                    // 等待过缓冲区空间的输出次数
+  uint32_t flushes;                           // 调用输出函数的次数
+  uint32_t max_pending;                       // 缓冲区最大占用（字节）
+  uint32_t max_latency_us;                    // 最大排队时间（微秒，从写入缓冲区到交给输出函数）
+} shell_tx_stats_t;
+
+// 写入时间标记：end之前（累计字节数）尚未发出的数据最早在time_us写入
+typedef struct {
+  volatile uint32_t end;
+  uint32_t time_us;                           // esp_timer低32位
+} shell_tx_mark_t;
+
+// 通道输出缓冲区：多个任务写入（持mutex），发送任务单独读出
+typedef struct {
+  uint8_t buffer[SHELL_TX_BUFFER_SIZE];
+  volatile uint32_t head;                     // 累计写入字节数（持mutex修改）
+  volatile uint32_t tail;                     // 累计发出字节数（只由发送任务修改）
+  shell_tx_mark_t marks[SHELL_TX_MARKS];      // 每次写入一个标记，标记用满时并入最后一个
+  volatile uint32_t mark_head;                // 累计标记数（持mutex修改）
+  volatile uint32_t mark_tail;                // 累计已发完的标记数（只由发送任务修改）
+  shell_tx_policy_t policy;                   // 缓冲区满时的处理策略
+  shell_tx_stats_t stats;
+  SemaphoreHandle_t mutex;
+} shell_tx_t;
+
+// 编译后的命令标志
+#define CMD_ITEM_BUILTIN 0x01                 // shell内置命令（macro/exec/jump等），经cmd_execute执行
+#define CMD_ITEM_TOO_DEEP 0x02                // 循环嵌套超过MACRO_MAX_DEPTH（连接时标记，重新编译后保留）
+
+// 宏控制流
+#define MACRO_MAX_DEPTH 8                     // loop/while最大嵌套层数
+#define MACRO_YIELD_STEPS 256                 // 每执行这么多条宏指令让出一次CPU
+
+// 宏指令（录制结束时由命令行编译得到）
+typedef enum {
+  MACRO_OP_COMMAND = 0,                       // 普通命令
+  MACRO_OP_LABEL,                             // label <标签>
+  MACRO_OP_GOTO,                              // goto <标签> [键名]，给出键名时值不为0才跳转
+  MACRO_OP_LOOP,                              // loop <次数>
+  MACRO_OP_ENDLOOP,                           // endloop
+  MACRO_OP_WHILE,                             // while <键名>，值不为0时循环
+  MACRO_OP_ENDWHILE,                          // endwhile
+  MACRO_OP_BREAK,                             // break，跳出最内层循环
+  MACRO_OP_INC,                               // inc <键名> [增量]
+  MACRO_OP_DEC,                               // dec <键名> [减量]，减到0为止
+  MACRO_OP_EXIT,                              // exit，结束宏
+} macro_op_t;
+
 // 命令队列项结构体
 typedef struct cmd_queue_item {
-  char command[MAX_CMD_LENGTH];
+  char *command;                              // 命令行（存放在命令池的行存储区）
   int line_number;                            // 行号
+  uint8_t size_class;                         // 命令行存储块的尺寸等级
+  uint8_t flags;                              // 编译后的命令标志
+  uint8_t opcode;                             // 宏指令（macro_op_t）
+  uint16_t params_offset;                     // 参数在命令行中的偏移
+  int32_t operand;                            // 指令的数值参数（循环次数、增量）
+  task_func_t handler;                        // 编译后的任务函数，NULL时经cmd_execute执行
+  uint32_t compiled_version;                  // 编译时的命令注册表版本，0为未编译
+  struct cmd_queue_item *target;              // 跳转目标（配对的循环首尾、标签）
   struct cmd_queue_item *next;
 } cmd_queue_item_t;
 
+// 命令池尺寸等级：同一等级的块大小相同，空闲块串成链表
+typedef struct {
+  uint16_t size;                              // 块大小
+  uint16_t capacity;                          // 块数
+  uint16_t used;                              // 已分配块数
+  uint16_t peak;                              // 已分配块数的最大值
+  void *free_list;                            // 空闲块链表
+} cmd_pool_class_t;
+
+// 命令池追加的存储块，数据紧跟在块头之后，销毁池时一并释放
+typedef struct cmd_pool_slab {
+  struct cmd_pool_slab *next;
+} cmd_pool_slab_t;
+
+// 命令池：命令节点、宏和命令行存储都从随池分配的存储区中切分，O(1)分配释放；
+// 某种存储用满时追加一整块（slab）切分后加入空闲链表，不逐行malloc
+typedef struct {
+  cmd_queue_item_t *free_items;               // 空闲命令节点
+  struct macro_item *free_macros;             // 空闲宏
+  uint16_t items_capacity;
+  uint16_t items_used;
+  uint16_t items_peak;
+  uint16_t macros_capacity;
+  uint16_t macros_used;
+  uint16_t macros_peak;
+  cmd_pool_class_t classes[CMD_POOL_CLASS_COUNT];
+  cmd_pool_slab_t *slabs;                     // 追加的存储块
+  uint16_t slab_count;
+  uint32_t alloc_failures;                    // 内存不足导致的分配失败次数
+  SemaphoreHandle_t mutex;
+} cmd_pool_t;
+
 // 键值对结构体
 typedef struct kv_pair {
   char key[64];
@@ -72,6 +240,7 @@ typedef struct {
   cmd_queue_item_t *head;
   cmd_queue_item_t *tail;
   size_t count;
+  cmd_pool_t *pool;                           // 节点所在的命令池
   SemaphoreHandle_t mutex;
 } cmd_queue_t;
 
@@ -86,11 +255,12 @@ typedef struct macro_item {
 typedef struct {
   macro_item_t *head;                         // 宏列表头
   size_t count;                               // 宏数量
-  bool recording;                             // 是否正在录制
+  volatile bool recording;                    // 是否正在录制
   char current_macro_name[64];                // 当前录制宏名称
   cmd_queue_t temp_queue;                     // 临时录制队列
+  cmd_pool_t *pool;                           // 宏和命令行所在的命令池
   SemaphoreHandle_t mutex;                    // 互斥锁
-  bool executing;                             // 是否正在执行宏
+  volatile bool executing;                    // 是否正在执行宏（执行中每条命令前检查，不加锁）
   uint32_t executing_channel_id;              // 正在执行的通道ID
   SemaphoreHandle_t execution_mutex;          // 执行互斥锁
 } macro_buffer_t;
@@ -99,12 +269,18 @@ typedef struct {
 typedef struct {
   shell_config_t config;                      // 配置信息
   cmd_buffer_t cmd_buffer;                    // 命令缓冲区
-  cmd_queue_t cmd_queue;                      // 命令队列
+  cmd_line_slots_t cmd_lines;                 // 待执行命令行
+  shell_urgent_t urgent;                      // 待执行紧急命令行
   kv_store_t kv_store;                        // 键值存储
   macro_buffer_t macro_buffer;                // 宏缓冲区
+  cmd_pool_t *cmd_pool;                       // 命令池
+  shell_tx_t tx;                              // 输出缓冲区
   TaskHandle_t parser_task_handle;            // 解析任务句柄
   TaskHandle_t executor_task_handle;          // 执行任务句柄
-  bool initialized;                           // 是否已初始化
+  TaskHandle_t tx_task_handle;                // 发送任务句柄
+  TaskHandle_t control_task_handle;           // 紧急命令控制任务句柄
+  volatile bool initialized;                  // 是否已初始化
+  volatile uint32_t output_users;             // 正在调用输出函数的任务数，销毁时等待归零
 } shell_instance_t;
 
 // 全局命令系统初始化
@@ -120,15 +296,25 @@ bool shell_stop_instance(shell_instance_t *instance);
 void shell_destroy_instance(shell_instance_t *instance);
 
 // 命令缓冲区操作函数
-void cmd_add_data(cmd_buffer_t *buffer, uint8_t *data, size_t length);
+size_t cmd_add_data(cmd_buffer_t *buffer, const uint8_t *data, size_t length);
+void cmd_drop_data(cmd_buffer_t *buffer, const uint8_t *data, size_t length);
 bool cmd_get_command(cmd_buffer_t *buffer, char *cmd, size_t max_length);
-bool cmd_get_all_commands(cmd_buffer_t *buffer, char *commands, size_t max_length);
+
+// 命令池操作函数
+cmd_pool_t *cmd_pool_create(void);
+void cmd_pool_destroy(cmd_pool_t *pool);
+cmd_queue_item_t *cmd_pool_alloc_item(cmd_pool_t *pool, const char *command);
+void cmd_pool_free_item(cmd_pool_t *pool, cmd_queue_item_t *item);
+macro_item_t *cmd_pool_alloc_macro(cmd_pool_t *pool);
+void cmd_pool_free_macro(cmd_pool_t *pool, macro_item_t *macro);
+void cmd_pool_stats(cmd_pool_t *pool, char *buffer, size_t buffer_size);
 
 // 命令队列操作函数
-void cmd_queue_init(cmd_queue_t *queue);
-void cmd_queue_enqueue(cmd_queue_t *queue, const char *command);
-bool cmd_queue_dequeue(cmd_queue_t *queue, char *command, size_t max_length);
-bool cmd_queue_peek(cmd_queue_t *queue, char *command, size_t max_length, size_t index);
+void cmd_queue_init(cmd_queue_t *queue, cmd_pool_t *pool);
+void cmd_queue_deinit(cmd_queue_t *queue);
+bool cmd_queue_enqueue(cmd_queue_t *queue, const char *command);
+// 返回队列的第一个命令，沿next顺序遍历；遍历期间调用者须保证队列不被修改
+cmd_queue_item_t *cmd_queue_first(cmd_queue_t *queue);
 void cmd_queue_clear(cmd_queue_t *queue);
 size_t cmd_queue_size(cmd_queue_t *queue);
 void cmd_queue_list(cmd_queue_t *queue, char *buffer, size_t buffer_size);
@@ -143,7 +329,7 @@ size_t kv_store_count(kv_store_t *store);
 void kv_store_list(kv_store_t *store, char *buffer, size_t buffer_size);
 
 // 宏缓冲区操作函数
-void macro_buffer_init(macro_buffer_t *macro);
+void macro_buffer_init(macro_buffer_t *macro, cmd_pool_t *pool);
 bool macro_buffer_start_recording(macro_buffer_t *macro, const char *macro_name);
 bool macro_buffer_stop_recording(macro_buffer_t *macro);
 bool macro_buffer_add_command(macro_buffer_t *macro, const char *command);
@@ -166,11 +352,21 @@ bool macro_buffer_jump_if_not_zero(macro_buffer_t *macro, const char *macro_name
 
 // 命令注册和执行函数
 bool cmd_register_task(const char *cmd_name, task_func_t task_func, const char *description);
+bool cmd_register_urgent_task(const char *cmd_name, task_func_t task_func, const char *description);
 void cmd_execute(uint32_t channel_id, const char *command);
+void cmd_execute_line(uint32_t channel_id, char *line);
 
 // 获取已注册的任务列表
 const cmd_task_t *cmd_get_task_list(size_t *count);
 
+// 后台作业函数（命令行以&结尾时在工作任务中执行）
+void shell_job_list(char *buffer, size_t buffer_size);
+bool shell_job_kill(uint32_t job_id);
+// 当前任务执行的后台作业是否已被kill，长时间运行的命令应定期检查；前台执行时总是false
+bool shell_job_cancelled(void);
+// 可被kill打断的延时，被打断时返回false；前台执行时等同vTaskDelay
+bool shell_job_delay(uint32_t ms);
+
 // 提示符相关函数
 void cmd_show_prompt(uint32_t channel_id);
 void cmd_show_command(uint32_t channel_id, const char *command);
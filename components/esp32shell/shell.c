@@ -3,6 +3,7 @@
 #include "cmd/cmd_encoding.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
@@ -13,15 +14,130 @@
 
 static const char *TAG = "SHELL";
 
-// 全局任务列表
-static cmd_task_t task_list[MAX_TASKS];
-static size_t task_count = 0;
-static SemaphoreHandle_t task_list_mutex = NULL;
-
-// 全局shell实例列表
+// 命令表：任务数组加开放寻址的哈希索引，与数组一次性分配
+// 读取不加锁：注册只追加，先写数组元素再发布索引槽；表满时复制到加倍的新表后替换指针
+typedef struct {
+  size_t count;                               // 已注册的任务数
+  size_t capacity;                            // 任务数组容量
+  size_t slot_mask;                           // 索引槽数-1（槽数为容量的2倍，2的幂）
+  cmd_task_t *tasks;
+  uint16_t *slots;                            // 任务下标+1，0为空槽
+} cmd_task_table_t;
+
+static cmd_task_table_t *task_table = NULL;
+static SemaphoreHandle_t task_list_mutex = NULL;  // 只在注册时使用
+static volatile uint32_t task_list_version = 1;  // 注册表每次变化加1，已编译的宏命令据此重新解析
+
+// 后台作业：排队和运行中的作业占用一个槽，id为0表示空闲
+typedef struct {
+  uint32_t id;                                // 作业号
+  uint32_t channel_id;                        // 提交作业的通道
+  task_func_t handler;                        // 任务函数
+  char command[MAX_CMD_LENGTH];               // 命令行（不含&）
+  size_t params_offset;                       // 参数在命令行中的位置
+  volatile bool running;                      // 已被工作任务取出执行
+  volatile bool cancelled;                    // 已被kill
+  volatile TaskHandle_t worker;               // 执行该作业的工作任务
+} shell_job_t;
+
+static shell_job_t shell_jobs[SHELL_MAX_JOBS];
+static uint32_t shell_next_job_id = 1;
+static QueueHandle_t shell_job_queue = NULL;    // 待执行作业的槽号，第一次提交时创建工作任务
+static SemaphoreHandle_t shell_jobs_mutex = NULL;
+
+// 全局shell实例列表：实例创建后位置不变，销毁后槽位复用
 static shell_instance_t shell_instances[MAX_SHELL_INSTANCES];
 static size_t shell_instance_count = 0;
-static SemaphoreHandle_t shell_instances_mutex = NULL;
+static SemaphoreHandle_t shell_instances_mutex = NULL;  // 只在创建和销毁时使用
+
+// 通道表：与实例槽一一对应，实例初始化完成后发布，销毁前撤下
+// 输出和按通道查找只读此表，不加锁
+static shell_instance_t *shell_channels[MAX_SHELL_INSTANCES];
+
+// 命令名哈希（FNV-1a），按长度计算，可直接用于未截断的命令行
+static uint32_t cmd_name_hash(const char *name, size_t len) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+  }
+  return hash;
+}
+
+// 把任务下标写入索引槽，调用者已写好任务数组元素
+static void cmd_task_table_index(cmd_task_table_t *table, size_t index) {
+  const char *name = table->tasks[index].cmd_name;
+  size_t slot = cmd_name_hash(name, strlen(name)) & table->slot_mask;
+  while (table->slots[slot] != 0) {
+    slot = (slot + 1) & table->slot_mask;
+  }
+  __atomic_store_n(&table->slots[slot], (uint16_t)(index + 1), __ATOMIC_RELEASE);
+}
+
+// 分配指定容量的命令表，复制当前表的内容后替换，持有task_list_mutex或初始化时调用
+// 旧表不释放：其他任务可能仍在读取，容量加倍增长，累计占用不超过当前表
+static cmd_task_table_t *cmd_task_table_grow(size_t capacity) {
+  size_t slot_count = 1;
+  while (slot_count < capacity * 2) {
+    slot_count <<= 1;
+  }
+  
+  cmd_task_table_t *table = calloc(1, sizeof(cmd_task_table_t) + capacity * sizeof(cmd_task_t) +
+                                      slot_count * sizeof(uint16_t));
+  if (table == NULL) {
+    return NULL;
+  }
+  table->capacity = capacity;
+  table->slot_mask = slot_count - 1;
+  table->tasks = (cmd_task_t *)(table + 1);
+  table->slots = (uint16_t *)(table->tasks + capacity);
+  
+  cmd_task_table_t *old = task_table;
+  if (old != NULL) {
+    memcpy(table->tasks, old->tasks, old->count * sizeof(cmd_task_t));
+    table->count = old->count;
+    for (size_t i = 0; i < table->count; i++) {
+      cmd_task_table_index(table, i);
+    }
+  }
+  __atomic_store_n(&task_table, table, __ATOMIC_RELEASE);
+  return table;
+}
+
+// 按命令名查找任务，name不要求以结束符结尾
+static const cmd_task_t *cmd_find_task(const char *name, size_t len) {
+  const cmd_task_table_t *table = __atomic_load_n(&task_table, __ATOMIC_ACQUIRE);
+  if (table == NULL) {
+    return NULL;
+  }
+  
+  size_t slot = cmd_name_hash(name, len) & table->slot_mask;
+  uint16_t entry;
+  while ((entry = __atomic_load_n(&table->slots[slot], __ATOMIC_ACQUIRE)) != 0) {
+    const cmd_task_t *task = &table->tasks[entry - 1];
+    if (strncmp(task->cmd_name, name, len) == 0 && task->cmd_name[len] == '\0') {
+      return task;
+    }
+    slot = (slot + 1) & table->slot_mask;
+  }
+  return NULL;
+}
+
+// 判断命令行是否以&结尾（后台执行），返回去掉&和其前面空白后的长度
+static bool cmd_is_background(const char *line, size_t *length) {
+  size_t len = strlen(line);
+  while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t')) {
+    len--;
+  }
+  if (len == 0 || line[len - 1] != '&') {
+    return false;
+  }
+  len--;
+  while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t')) {
+    len--;
+  }
+  *length = len;
+  return true;
+}
 
 void cmd_system_init(void) {
   // 初始化Shell编码配置
@@ -33,6 +149,13 @@ void cmd_system_init(void) {
     return;
   }
   
+  if (cmd_task_table_grow(CMD_TABLE_INIT_CAPACITY) == NULL) {
+    ESP_LOGE(TAG, "分配命令表失败");
+    vSemaphoreDelete(task_list_mutex);
+    task_list_mutex = NULL;
+    return;
+  }
+  
   shell_instances_mutex = xSemaphoreCreateMutex();
   if (shell_instances_mutex == NULL) {
     ESP_LOGE(TAG, "创建shell实例互斥锁失败");
@@ -41,8 +164,14 @@ void cmd_system_init(void) {
     return;
   }
   
+  shell_jobs_mutex = xSemaphoreCreateMutex();
+  if (shell_jobs_mutex == NULL) {
+    ESP_LOGE(TAG, "创建后台作业互斥锁失败");
+  }
+  
   // 初始化shell实例列表
   memset(shell_instances, 0, sizeof(shell_instances));
+  memset(shell_channels, 0, sizeof(shell_channels));
   shell_instance_count = 0;
   
   ESP_LOGI(TAG, "命令系统初始化完成");
@@ -77,16 +206,19 @@ shell_instance_t* shell_create_instance(const shell_config_t *config) {
     return NULL;
   }
   
-  // 创建新实例
-  shell_instance_t *instance = &shell_instances[shell_instance_count];
+  // 取一个空闲槽创建新实例
+  size_t slot = 0;
+  while (shell_channels[slot] != NULL) {
+    slot++;
+  }
+  shell_instance_t *instance = &shell_instances[slot];
+  memset(instance, 0, sizeof(shell_instance_t));
   
   // 复制配置
   memcpy(&instance->config, config, sizeof(shell_config_t));
   
   // 初始化命令缓冲区
-  instance->cmd_buffer.head = 0;
-  instance->cmd_buffer.tail = 0;
-  instance->cmd_buffer.count = 0;
+  memset(&instance->cmd_buffer, 0, sizeof(cmd_buffer_t));
   instance->cmd_buffer.mutex = xSemaphoreCreateMutex();
   if (instance->cmd_buffer.mutex == NULL) {
     ESP_LOGE(TAG, "创建命令缓冲区互斥锁失败");
@@ -94,14 +226,49 @@ shell_instance_t* shell_create_instance(const shell_config_t *config) {
     return NULL;
   }
   
-  // 初始化命令队列
-  cmd_queue_init(&instance->cmd_queue);
+  // 初始化命令行槽
+  instance->cmd_lines.head = 0;
+  instance->cmd_lines.tail = 0;
+  instance->cmd_lines.free_slots = xSemaphoreCreateCounting(CMD_LINE_SLOTS, CMD_LINE_SLOTS);
+  if (instance->cmd_lines.free_slots == NULL) {
+    ESP_LOGE(TAG, "创建命令行槽信号量失败");
+    vSemaphoreDelete(instance->cmd_buffer.mutex);
+    instance->cmd_buffer.mutex = NULL;
+    xSemaphoreGive(shell_instances_mutex);
+    return NULL;
+  }
+  
+  // 初始化输出缓冲区
+  instance->tx.policy = SHELL_TX_BLOCK;
+  instance->tx.mutex = xSemaphoreCreateMutex();
+  if (instance->tx.mutex == NULL) {
+    ESP_LOGE(TAG, "创建输出缓冲区互斥锁失败");
+    vSemaphoreDelete(instance->cmd_lines.free_slots);
+    instance->cmd_lines.free_slots = NULL;
+    vSemaphoreDelete(instance->cmd_buffer.mutex);
+    instance->cmd_buffer.mutex = NULL;
+    xSemaphoreGive(shell_instances_mutex);
+    return NULL;
+  }
   
   // 初始化键值存储
   kv_store_init(&instance->kv_store);
   
+  // 初始化命令池，宏和录制的命令行都从池中分配
+  instance->cmd_pool = cmd_pool_create();
+  if (instance->cmd_pool == NULL) {
+    vSemaphoreDelete(instance->tx.mutex);
+    instance->tx.mutex = NULL;
+    vSemaphoreDelete(instance->cmd_lines.free_slots);
+    instance->cmd_lines.free_slots = NULL;
+    vSemaphoreDelete(instance->cmd_buffer.mutex);
+    instance->cmd_buffer.mutex = NULL;
+    xSemaphoreGive(shell_instances_mutex);
+    return NULL;
+  }
+  
   // 初始化宏缓冲区
-  macro_buffer_init(&instance->macro_buffer);
+  macro_buffer_init(&instance->macro_buffer, instance->cmd_pool);
   
   // 初始化当前工作目录
   if (instance->config.user_data == NULL) {
@@ -113,8 +280,12 @@ shell_instance_t* shell_create_instance(const shell_config_t *config) {
   
   instance->parser_task_handle = NULL;
   instance->executor_task_handle = NULL;
+  instance->tx_task_handle = NULL;
+  instance->control_task_handle = NULL;
   instance->initialized = true;
   
+  // 实例完全初始化后再发布到通道表
+  __atomic_store_n(&shell_channels[slot], instance, __ATOMIC_RELEASE);
   shell_instance_count++;
   
   ESP_LOGI(TAG, "创建shell实例成功，通道ID: %lu, 名称: %s", 
@@ -124,6 +295,199 @@ shell_instance_t* shell_create_instance(const shell_config_t *config) {
   return instance;
 }
 
+// 记录写入数据的结束位置和写入时间，在数据对发送任务可见之前调用（持tx->mutex）
+static void shell_tx_mark(shell_tx_t *tx, uint32_t end, uint32_t time_us) {
+  uint32_t mark_head = tx->mark_head;
+  if (mark_head - __atomic_load_n(&tx->mark_tail, __ATOMIC_ACQUIRE) < SHELL_TX_MARKS) {
+    shell_tx_mark_t *mark = &tx->marks[mark_head & (SHELL_TX_MARKS - 1)];
+    mark->time_us = time_us;
+    mark->end = end;
+    __atomic_store_n(&tx->mark_head, mark_head + 1, __ATOMIC_RELEASE);
+  } else {
+    // 标记用满时并入最后一个标记，按其中最早的写入时间计
+    __atomic_store_n(&tx->marks[(mark_head - 1) & (SHELL_TX_MARKS - 1)].end, end, __ATOMIC_RELEASE);
+  }
+}
+
+// 写入输出缓冲区并唤醒发送任务，返回写入的字节数
+// 阻塞策略只对本通道执行任务的命令输出生效；控制任务、测试任务、后台作业等其他
+// 写入者总按丢弃策略处理，缓冲区满或锁被占用时不等待
+static size_t shell_tx_write(shell_instance_t *instance, const uint8_t *data, size_t length) {
+  shell_tx_t *tx = &instance->tx;
+  bool may_block = tx->policy == SHELL_TX_BLOCK && xTaskGetCurrentTaskHandle() == instance->executor_task_handle;
+  if (xSemaphoreTake(tx->mutex, may_block ? pdMS_TO_TICKS(SHELL_TX_BLOCK_MS) : 1) != pdTRUE) {
+    tx->stats.dropped_bytes += length;
+    tx->stats.dropped_writes++;
+    return 0;
+  }
+  
+  size_t written = 0;
+  uint32_t now_us = (uint32_t)esp_timer_get_time();
+  TickType_t start = xTaskGetTickCount();
+  bool blocked = false;
+  while (written < length) {
+    uint32_t head = tx->head;
+    uint32_t used = head - __atomic_load_n(&tx->tail, __ATOMIC_ACQUIRE);
+    size_t space = SHELL_TX_BUFFER_SIZE - used;
+    
+    // 丢弃策略下整条放不下就丢弃，避免终端上出现半行
+    if (!may_block && space < length - written) {
+      break;
+    }
+    
+    if (space == 0) {
+      // 实例停止时发送任务不再取数据，不必等待
+      TaskHandle_t tx_task = instance->tx_task_handle;
+      if (tx_task == NULL || !instance->initialized ||
+          xTaskGetTickCount() - start >= pdMS_TO_TICKS(SHELL_TX_BLOCK_MS)) {
+        break;
+      }
+      blocked = true;
+      xTaskNotifyGive(tx_task);
+      vTaskDelay(1);
+      continue;
+    }
+    
+    // 分两段复制到环形缓冲区
+    size_t n = length - written;
+    if (n > space) {
+      n = space;
+    }
+    size_t offset = head & SHELL_TX_BUFFER_MASK;
+    size_t first = SHELL_TX_BUFFER_SIZE - offset;
+    if (first > n) {
+      first = n;
+    }
+    memcpy(&tx->buffer[offset], data + written, first);
+    memcpy(tx->buffer, data + written + first, n - first);
+    shell_tx_mark(tx, head + n, now_us);
+    __atomic_store_n(&tx->head, head + n, __ATOMIC_RELEASE);
+    written += n;
+    
+    if (used + n > tx->stats.max_pending) {
+      tx->stats.max_pending = used + n;
+    }
+  }
+  
+  tx->stats.queued_bytes += written;
+  if (blocked) {
+    tx->stats.blocked_writes++;
+  }
+  if (written < length) {
+    tx->stats.dropped_bytes += length - written;
+    tx->stats.dropped_writes++;
+  }
+  xSemaphoreGive(tx->mutex);
+  
+  TaskHandle_t tx_task = instance->tx_task_handle;
+  if (written > 0 && tx_task != NULL) {
+    xTaskNotifyGive(tx_task);
+  }
+  return written;
+}
+
+// 发送任务函数：把输出缓冲区中积累的小块输出合并后交给输出函数
+static void shell_tx_task(void *arg) {
+  shell_instance_t *instance = (shell_instance_t *)arg;
+  shell_tx_t *tx = &instance->tx;
+  uint32_t channel_id = instance->config.channel_id;
+  
+  while (instance->initialized) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    
+    // 输出函数阻塞期间写入的数据在下一轮一次发出
+    while (instance->initialized) {
+      uint32_t tail = tx->tail;
+      uint32_t used = __atomic_load_n(&tx->head, __ATOMIC_ACQUIRE) - tail;
+      if (used == 0) {
+        break;
+      }
+      
+      size_t offset = tail & SHELL_TX_BUFFER_MASK;
+      size_t n = SHELL_TX_BUFFER_SIZE - offset;
+      if (n > used) {
+        n = used;
+      }
+      if (n > SHELL_TX_CHUNK) {
+        n = SHELL_TX_CHUNK;
+      }
+      instance->config.output_func(channel_id, &tx->buffer[offset], n);
+      
+      uint32_t now_us = (uint32_t)esp_timer_get_time();
+      __atomic_store_n(&tx->tail, tail + n, __ATOMIC_RELEASE);
+      tx->stats.sent_bytes += n;
+      tx->stats.flushes++;
+      
+      // 已全部发出的写入，排队时间为写入到现在
+      uint32_t mark_tail = tx->mark_tail;
+      while (mark_tail != __atomic_load_n(&tx->mark_head, __ATOMIC_ACQUIRE)) {
+        shell_tx_mark_t *mark = &tx->marks[mark_tail & (SHELL_TX_MARKS - 1)];
+        if ((int32_t)(__atomic_load_n(&mark->end, __ATOMIC_ACQUIRE) - (tail + n)) > 0) {
+          break;
+        }
+        uint32_t latency = now_us - mark->time_us;
+        if (latency > tx->stats.max_latency_us) {
+          tx->stats.max_latency_us = latency;
+        }
+        mark_tail++;
+      }
+      __atomic_store_n(&tx->mark_tail, mark_tail, __ATOMIC_RELEASE);
+    }
+  }
+  
+  instance->tx_task_handle = NULL;
+  vTaskDelete(NULL);
+}
+
+// 在控制任务中执行紧急命令：中断本通道正在回放的宏，直接调用任务函数（不录制到宏）
+static void shell_execute_urgent(shell_instance_t *instance, char *line) {
+  uint32_t channel_id = instance->config.channel_id;
+  char response[MAX_CMD_LENGTH + 32];
+  snprintf(response, sizeof(response), "紧急执行: %s\r\n", line);
+  cmd_output(channel_id, (uint8_t *)response, strlen(response));
+  
+  char *cmd_name = line + strspn(line, " \t");
+  char *name_end = cmd_name + strcspn(cmd_name, " \t");
+  char *params = name_end;
+  if (*name_end != '\0') {
+    *name_end = '\0';
+    params = name_end + 1;
+  }
+  
+  const cmd_task_t *task = cmd_find_task(cmd_name, strlen(cmd_name));
+  if (task == NULL) {
+    return;
+  }
+  
+  if (macro_buffer_stop_execution(&instance->macro_buffer, channel_id)) {
+    snprintf(response, sizeof(response), "宏执行已中断\r\n");
+    cmd_output(channel_id, (uint8_t *)response, strlen(response));
+  }
+  
+  ESP_LOGI(TAG, "执行紧急任务: %s", cmd_name);
+  task->task_func(channel_id, params);
+  cmd_show_prompt(channel_id);
+}
+
+// 紧急命令控制任务：与执行任务并行，执行任务阻塞在长命令或宏回放中时紧急命令也能立即执行；
+// 紧急命令的任务函数须自行与同一资源上的普通命令互斥
+static void shell_control_task(void *arg) {
+  shell_instance_t *instance = (shell_instance_t *)arg;
+  shell_urgent_t *urgent = &instance->urgent;
+  
+  while (instance->initialized) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    
+    while (instance->initialized && urgent->tail != __atomic_load_n(&urgent->head, __ATOMIC_ACQUIRE)) {
+      shell_execute_urgent(instance, urgent->lines[urgent->tail & (SHELL_URGENT_SLOTS - 1)]);
+      __atomic_store_n(&urgent->tail, urgent->tail + 1, __ATOMIC_RELEASE);
+    }
+  }
+  
+  instance->control_task_handle = NULL;
+  vTaskDelete(NULL);
+}
+
 // 命令解析任务函数
 static void shell_parser_task(void *arg) {
   shell_instance_t *instance = (shell_instance_t *)arg;
@@ -136,26 +500,33 @@ static void shell_parser_task(void *arg) {
   cmd_show_prompt(channel_id);
   
   while (instance->initialized) {
-    char all_commands[MAX_CMD_LENGTH * 4]; // 支持多个命令
-    if (cmd_get_all_commands(&instance->cmd_buffer, all_commands, sizeof(all_commands))) {
-      // 分割命令并加入队列
-      char *command = strtok(all_commands, "\r\n");
+    // 阻塞等待shell_add_data_to_instance的通知，空闲时不占用CPU
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    
+    cmd_line_slots_t *slots = &instance->cmd_lines;
+    while (instance->initialized) {
+      // 等待空闲槽，槽满时输入留在缓冲区，由缓冲区向接收端施加背压
+      if (xSemaphoreTake(slots->free_slots, pdMS_TO_TICKS(100)) != pdTRUE) {
+        continue;
+      }
       
-      while (command != NULL) {
-        // 跳过空命令
-        if (strlen(command) > 0) {
-          // 将命令加入队列
-          cmd_queue_enqueue(&instance->cmd_queue, command);
-        }
-        
-        // 获取下一个命令
-        command = strtok(NULL, "\r\n");
+      // 每行只从缓冲区复制一次，直接写入槽
+      char *line = slots->lines[slots->head & (CMD_LINE_SLOTS - 1)];
+      if (!cmd_get_command(&instance->cmd_buffer, line, MAX_CMD_LENGTH)) {
+        xSemaphoreGive(slots->free_slots);
+        break;
+      }
+      slots->head++;
+      
+      // 唤醒执行任务
+      if (instance->executor_task_handle != NULL) {
+        xTaskNotifyGive(instance->executor_task_handle);
       }
     }
-    vTaskDelay(pdMS_TO_TICKS(10));
   }
   
   ESP_LOGI(TAG, "Shell解析任务退出，通道ID: %lu, 名称: %s", channel_id, channel_name);
+  instance->parser_task_handle = NULL;
   vTaskDelete(NULL);
 }
 
@@ -168,28 +539,32 @@ static void shell_executor_task(void *arg) {
   ESP_LOGI(TAG, "Shell执行任务启动，通道ID: %lu, 名称: %s", channel_id, channel_name);
   
   while (instance->initialized) {
-    char command[MAX_CMD_LENGTH];
+    // 阻塞等待解析任务的通知
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
     
-    // 从命令队列中取出命令执行
-    if (cmd_queue_dequeue(&instance->cmd_queue, command, MAX_CMD_LENGTH)) {
+    // 依次执行槽中的所有命令
+    cmd_line_slots_t *slots = &instance->cmd_lines;
+    while (instance->initialized && slots->tail != slots->head) {
+      char *line = slots->lines[slots->tail & (CMD_LINE_SLOTS - 1)];
+      
       // 显示输入的命令
-      if (instance->config.output_func) {
-        char display_cmd[MAX_CMD_LENGTH + 10];
-        snprintf(display_cmd, sizeof(display_cmd), "%s\r\n", command);
-        instance->config.output_func(channel_id, (uint8_t *)display_cmd, strlen(display_cmd));
-      }
+      cmd_output(channel_id, (uint8_t *)line, strlen(line));
+      cmd_output(channel_id, (uint8_t *)"\r\n", 2);
+      
+      // 在槽内原地解析并执行命令
+      cmd_execute_line(channel_id, line);
       
-      // 执行命令
-      cmd_execute(channel_id, command);
+      // 释放槽
+      slots->tail++;
+      xSemaphoreGive(slots->free_slots);
       
       // 显示新的动态提示符
       cmd_show_prompt(channel_id);
     }
-    
-    vTaskDelay(pdMS_TO_TICKS(10));
   }
   
   ESP_LOGI(TAG, "Shell执行任务退出，通道ID: %lu, 名称: %s", channel_id, channel_name);
+  instance->executor_task_handle = NULL;
   vTaskDelete(NULL);
 }
 
@@ -204,8 +579,22 @@ bool shell_start_instance(shell_instance_t *instance) {
     return true;
   }
   
+  // 先创建发送任务，解析任务的提示符经输出缓冲区发出
+  BaseType_t ret = xTaskCreate(shell_tx_task,
+                               "shell_tx",
+                               3072,
+                               instance,
+                               4,
+                               &instance->tx_task_handle);
+  
+  if (ret != pdPASS) {
+    ESP_LOGE(TAG, "创建shell发送任务失败");
+    instance->tx_task_handle = NULL;
+    return false;
+  }
+  
   // 创建解析任务
-  BaseType_t ret = xTaskCreate(shell_parser_task, 
+  ret = xTaskCreate(shell_parser_task, 
                                "shell_parser", 
                                8192, 
                                instance, 
@@ -214,6 +603,8 @@ bool shell_start_instance(shell_instance_t *instance) {
   
   if (ret != pdPASS) {
     ESP_LOGE(TAG, "创建shell解析任务失败");
+    vTaskDelete(instance->tx_task_handle);
+    instance->tx_task_handle = NULL;
     return false;
   }
   
@@ -229,6 +620,27 @@ bool shell_start_instance(shell_instance_t *instance) {
     ESP_LOGE(TAG, "创建shell执行任务失败");
     vTaskDelete(instance->parser_task_handle);
     instance->parser_task_handle = NULL;
+    vTaskDelete(instance->tx_task_handle);
+    instance->tx_task_handle = NULL;
+    return false;
+  }
+  
+  // 创建紧急命令控制任务，优先级高于执行任务
+  ret = xTaskCreate(shell_control_task, 
+                    "shell_ctrl", 
+                    8192, 
+                    instance, 
+                    5, 
+                    &instance->control_task_handle);
+  
+  if (ret != pdPASS) {
+    ESP_LOGE(TAG, "创建shell控制任务失败");
+    vTaskDelete(instance->executor_task_handle);
+    instance->executor_task_handle = NULL;
+    vTaskDelete(instance->parser_task_handle);
+    instance->parser_task_handle = NULL;
+    vTaskDelete(instance->tx_task_handle);
+    instance->tx_task_handle = NULL;
     return false;
   }
   
@@ -243,9 +655,24 @@ bool shell_stop_instance(shell_instance_t *instance) {
     return false;
   }
   
-  if (instance->parser_task_handle != NULL || instance->executor_task_handle != NULL) {
+  if (instance->parser_task_handle != NULL || instance->executor_task_handle != NULL ||
+      instance->tx_task_handle != NULL || instance->control_task_handle != NULL) {
     instance->initialized = false;
-    vTaskDelay(pdMS_TO_TICKS(100)); // 等待任务退出
+    
+    // 唤醒阻塞等待的任务，使其检查退出条件
+    if (instance->parser_task_handle != NULL) {
+      xTaskNotifyGive(instance->parser_task_handle);
+    }
+    if (instance->executor_task_handle != NULL) {
+      xTaskNotifyGive(instance->executor_task_handle);
+    }
+    if (instance->tx_task_handle != NULL) {
+      xTaskNotifyGive(instance->tx_task_handle);
+    }
+    if (instance->control_task_handle != NULL) {
+      xTaskNotifyGive(instance->control_task_handle);
+    }
+    vTaskDelay(pdMS_TO_TICKS(100)); // 等待任务退出（发送任务最多在发一块数据）
     
     if (instance->parser_task_handle != NULL) {
       vTaskDelete(instance->parser_task_handle);
@@ -257,6 +684,16 @@ bool shell_stop_instance(shell_instance_t *instance) {
       instance->executor_task_handle = NULL;
     }
     
+    if (instance->tx_task_handle != NULL) {
+      vTaskDelete(instance->tx_task_handle);
+      instance->tx_task_handle = NULL;
+    }
+    
+    if (instance->control_task_handle != NULL) {
+      vTaskDelete(instance->control_task_handle);
+      instance->control_task_handle = NULL;
+    }
+    
     ESP_LOGI(TAG, "停止shell实例成功，通道ID: %lu, 名称: %s", 
              instance->config.channel_id,
              instance->config.channel_name ? instance->config.channel_name : "未知");
@@ -273,17 +710,37 @@ void shell_destroy_instance(shell_instance_t *instance) {
   // 先停止实例
   shell_stop_instance(instance);
   
+  // 从通道表撤下，等待正在输出的任务返回后再释放资源
+  if (xSemaphoreTake(shell_instances_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+    for (size_t i = 0; i < MAX_SHELL_INSTANCES; i++) {
+      if (shell_channels[i] == instance) {
+        __atomic_store_n(&shell_channels[i], NULL, __ATOMIC_RELEASE);
+        shell_instance_count--;
+        break;
+      }
+    }
+    xSemaphoreGive(shell_instances_mutex);
+  }
+  while (__atomic_load_n(&instance->output_users, __ATOMIC_ACQUIRE) != 0) {
+    vTaskDelay(1);
+  }
+  
   // 清理资源
   if (instance->cmd_buffer.mutex != NULL) {
     vSemaphoreDelete(instance->cmd_buffer.mutex);
     instance->cmd_buffer.mutex = NULL;
   }
   
-  // 清理命令队列
-  cmd_queue_clear(&instance->cmd_queue);
-  if (instance->cmd_queue.mutex != NULL) {
-    vSemaphoreDelete(instance->cmd_queue.mutex);
-    instance->cmd_queue.mutex = NULL;
+  // 清理命令行槽
+  if (instance->cmd_lines.free_slots != NULL) {
+    vSemaphoreDelete(instance->cmd_lines.free_slots);
+    instance->cmd_lines.free_slots = NULL;
+  }
+  
+  // 清理输出缓冲区
+  if (instance->tx.mutex != NULL) {
+    vSemaphoreDelete(instance->tx.mutex);
+    instance->tx.mutex = NULL;
   }
   
   // 清理键值存储
@@ -295,29 +752,15 @@ void shell_destroy_instance(shell_instance_t *instance) {
   
   // 清理宏缓冲区
   macro_buffer_clear(&instance->macro_buffer);
-  if (instance->macro_buffer.temp_queue.mutex != NULL) {
-    vSemaphoreDelete(instance->macro_buffer.temp_queue.mutex);
-    instance->macro_buffer.temp_queue.mutex = NULL;
-  }
+  cmd_queue_deinit(&instance->macro_buffer.temp_queue);
   if (instance->macro_buffer.mutex != NULL) {
     vSemaphoreDelete(instance->macro_buffer.mutex);
     instance->macro_buffer.mutex = NULL;
   }
   
-  // 从实例列表中移除
-  if (xSemaphoreTake(shell_instances_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-    for (size_t i = 0; i < shell_instance_count; i++) {
-      if (&shell_instances[i] == instance) {
-        // 将最后一个实例移到当前位置
-        if (i < shell_instance_count - 1) {
-          memcpy(&shell_instances[i], &shell_instances[shell_instance_count - 1], sizeof(shell_instance_t));
-        }
-        shell_instance_count--;
-        break;
-      }
-    }
-    xSemaphoreGive(shell_instances_mutex);
-  }
+  // 释放命令池（宏和命令节点已全部归还）
+  cmd_pool_destroy(instance->cmd_pool);
+  instance->cmd_pool = NULL;
   
   memset(instance, 0, sizeof(shell_instance_t));
   ESP_LOGI(TAG, "销毁shell实例成功");
@@ -343,24 +786,94 @@ void shell_stop_and_destroy(shell_instance_t *instance) {
 }
 
 // 命令缓冲区操作函数
-void cmd_add_data(cmd_buffer_t *buffer, uint8_t *data, size_t length) {
+
+// 判断是否为行结束符
+static bool cmd_is_eol(uint8_t c) {
+  return c == '\n' || c == '\r';
+}
+
+// 从缓冲区尾部复制length字节，环绕时分两段复制
+static void cmd_buffer_copy_out(const cmd_buffer_t *buffer, char *dest, size_t length) {
+  size_t first = CMD_BUFFER_SIZE - buffer->tail;
+  if (first > length) {
+    first = length;
+  }
+  memcpy(dest, &buffer->buffer[buffer->tail], first);
+  memcpy(dest + first, buffer->buffer, length - first);
+}
+
+// 移除尾部length字节，同步调整已扫描位置
+static void cmd_buffer_consume(cmd_buffer_t *buffer, size_t length) {
+  buffer->tail = (buffer->tail + length) & CMD_BUFFER_MASK;
+  buffer->count -= length;
+  buffer->scanned = buffer->scanned > length ? buffer->scanned - length : 0;
+  buffer->line_end = buffer->line_end > length ? buffer->line_end - length : 0;
+}
+
+// 扫描上次之后新到的数据，记录最后一个行结束符之后的位置
+static void cmd_buffer_scan(cmd_buffer_t *buffer) {
+  while (buffer->scanned < buffer->count) {
+    if (cmd_is_eol(buffer->buffer[(buffer->tail + buffer->scanned) & CMD_BUFFER_MASK])) {
+      buffer->line_end = buffer->scanned + 1;
+    }
+    buffer->scanned++;
+  }
+}
+
+size_t cmd_add_data(cmd_buffer_t *buffer, const uint8_t *data, size_t length) {
   if (xSemaphoreTake(buffer->mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
-    return;
+    return 0;
   }
 
-  for (size_t i = 0; i < length; i++) {
-    if (buffer->count < CMD_BUFFER_SIZE) {
-      buffer->buffer[buffer->head] = data[i];
-      buffer->head = (buffer->head + 1) % CMD_BUFFER_SIZE;
-      buffer->count++;
-    } else {
-      // 缓冲区满，丢弃最旧的数据
-      buffer->tail = (buffer->tail + 1) % CMD_BUFFER_SIZE;
-      buffer->buffer[buffer->head] = data[i];
-      buffer->head = (buffer->head + 1) % CMD_BUFFER_SIZE;
+  size_t skipped = 0;
+  if (buffer->discarding) {
+    // 丢弃溢出行的剩余部分，直到下一个行结束符
+    while (skipped < length && !cmd_is_eol(data[skipped])) {
+      skipped++;
     }
+    if (skipped < length) {
+      buffer->discarding = false;
+      skipped++;
+    }
+    buffer->dropped_bytes += skipped;
+  }
+
+  // 只写入剩余空间，不覆盖未处理的数据
+  size_t accepted = length - skipped;
+  if (accepted > CMD_BUFFER_SIZE - buffer->count) {
+    accepted = CMD_BUFFER_SIZE - buffer->count;
   }
 
+  size_t first = CMD_BUFFER_SIZE - buffer->head;
+  if (first > accepted) {
+    first = accepted;
+  }
+  memcpy(&buffer->buffer[buffer->head], data + skipped, first);
+  memcpy(buffer->buffer, data + skipped + first, accepted - first);
+  buffer->head = (buffer->head + accepted) & CMD_BUFFER_MASK;
+  buffer->count += accepted;
+
+  xSemaphoreGive(buffer->mutex);
+  return skipped + accepted;
+}
+
+void cmd_drop_data(cmd_buffer_t *buffer, const uint8_t *data, size_t length) {
+  if (length == 0 || xSemaphoreTake(buffer->mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+    return;
+  }
+
+  // 已收到的半行不再有效，退回到最后一个行结束符
+  cmd_buffer_scan(buffer);
+  buffer->dropped_bytes += buffer->count - buffer->line_end;
+  buffer->head = (buffer->tail + buffer->line_end) & CMD_BUFFER_MASK;
+  buffer->count = buffer->line_end;
+  buffer->scanned = buffer->line_end;
+
+  // 丢弃的数据若止于行中间，后续数据丢弃到下一个行结束符为止
+  buffer->discarding = !cmd_is_eol(data[length - 1]);
+  buffer->dropped_bytes += length;
+  buffer->overflow_count++;
+
   xSemaphoreGive(buffer->mutex);
 }
 
@@ -369,125 +882,312 @@ bool cmd_get_command(cmd_buffer_t *buffer, char *cmd, size_t max_length) {
     return false;
   }
 
-  bool found_cmd = false;
+  // 跳过空行
+  while (buffer->count > 0 && cmd_is_eol(buffer->buffer[buffer->tail])) {
+    cmd_buffer_consume(buffer, 1);
+  }
+
+  // 只扫描新到的数据，还没有完整的行时直接返回
+  cmd_buffer_scan(buffer);
+  if (buffer->line_end == 0 && buffer->count < CMD_BUFFER_SIZE) {
+    xSemaphoreGive(buffer->mutex);
+    return false;
+  }
+
+  // 查找第一个行结束符
   size_t cmd_len = 0;
-  size_t temp_tail = buffer->tail;
-  size_t temp_count = buffer->count;
-
-  // 如果有数据，就尝试解析命令
-  if (temp_count > 0) {
-    // 查找换行符或回车符
-    bool found_eol = false;
-    size_t search_count = temp_count;
-    size_t search_tail = temp_tail;
-    
-    while (search_count > 0 && cmd_len < max_length - 1) {
-      char c = buffer->buffer[search_tail];
-      search_tail = (search_tail + 1) % CMD_BUFFER_SIZE;
-      search_count--;
-      
-      if (c == '\n' || c == '\r') {
-        found_eol = true;
-        break;
-      }
+  bool found_eol = false;
+  while (cmd_len < buffer->count) {
+    if (cmd_is_eol(buffer->buffer[(buffer->tail + cmd_len) & CMD_BUFFER_MASK])) {
+      found_eol = true;
+      break;
+    }
+    cmd_len++;
+  }
+
+
+  // 超长的行截断，剩余部分一并移除
+  size_t copy_len = cmd_len < max_length - 1 ? cmd_len : max_length - 1;
+  cmd_buffer_copy_out(buffer, cmd, copy_len);
+  cmd[copy_len] = '\0';
+  cmd_buffer_consume(buffer, cmd_len + (found_eol ? 1 : 0));
+
+  xSemaphoreGive(buffer->mutex);
+
+  if (copy_len > 0) {
+    ESP_LOGI(TAG, "找到命令: '%s'", cmd);
+  }
+  return copy_len > 0;
+}
+
+// 命令池操作函数实现
+static const uint16_t cmd_pool_class_sizes[CMD_POOL_CLASS_COUNT] = CMD_POOL_CLASS_SIZES;
+static const uint16_t cmd_pool_class_blocks[CMD_POOL_CLASS_COUNT] = CMD_POOL_CLASS_BLOCKS;
+
+// 把连续的命令节点加入空闲链表
+static void cmd_pool_link_items(cmd_pool_t *pool, cmd_queue_item_t *items, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    items[i].next = (i + 1 < count) ? &items[i + 1] : pool->free_items;
+  }
+  pool->free_items = items;
+  pool->items_capacity += count;
+}
+
+// 把连续的宏加入空闲链表
+static void cmd_pool_link_macros(cmd_pool_t *pool, macro_item_t *macros, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    macros[i].next = (i + 1 < count) ? &macros[i + 1] : pool->free_macros;
+  }
+  pool->free_macros = macros;
+  pool->macros_capacity += count;
+}
+
+// 把连续的命令行存储块加入尺寸等级的空闲链表，空闲块的前几个字节存放下一个空闲块的指针
+static void cmd_pool_link_blocks(cmd_pool_class_t *cls, uint8_t *blocks, size_t count) {
+  for (size_t j = count; j > 0; j--) {
+    void *block = blocks + (j - 1) * cls->size;
+    *(void **)block = cls->free_list;
+    cls->free_list = block;
+  }
+  cls->capacity += count;
+}
+
+// 追加一个存储块，持有pool->mutex时调用
+static void *cmd_pool_add_slab(cmd_pool_t *pool, size_t size) {
+  cmd_pool_slab_t *slab = malloc(sizeof(cmd_pool_slab_t) + size);
+  if (slab == NULL) {
+    ESP_LOGW(TAG, "命令池扩展失败 (%zu bytes)", sizeof(cmd_pool_slab_t) + size);
+    return NULL;
+  }
+  slab->next = pool->slabs;
+  pool->slabs = slab;
+  pool->slab_count++;
+  return slab + 1;
+}
+
+cmd_pool_t *cmd_pool_create(void) {
+  // 计算存储区大小：命令节点、宏、各尺寸等级的块依次排列在池结构之后
+  size_t arena_size = sizeof(cmd_queue_item_t) * CMD_POOL_ITEMS + sizeof(macro_item_t) * CMD_POOL_MACROS;
+  for (int i = 0; i < CMD_POOL_CLASS_COUNT; i++) {
+    arena_size += (size_t)cmd_pool_class_sizes[i] * cmd_pool_class_blocks[i];
+  }
+
+  cmd_pool_t *pool = malloc(sizeof(cmd_pool_t) + arena_size);
+  if (pool == NULL) {
+    ESP_LOGE(TAG, "创建命令池失败 (%zu bytes)", sizeof(cmd_pool_t) + arena_size);
+    return NULL;
+  }
+  memset(pool, 0, sizeof(cmd_pool_t));
+  pool->mutex = xSemaphoreCreateMutex();
+  if (pool->mutex == NULL) {
+    free(pool);
+    return NULL;
+  }
+
+  uint8_t *p = (uint8_t *)(pool + 1);
+  cmd_pool_link_items(pool, (cmd_queue_item_t *)p, CMD_POOL_ITEMS);
+  p += sizeof(cmd_queue_item_t) * CMD_POOL_ITEMS;
+
+  cmd_pool_link_macros(pool, (macro_item_t *)p, CMD_POOL_MACROS);
+  p += sizeof(macro_item_t) * CMD_POOL_MACROS;
+
+  for (int i = 0; i < CMD_POOL_CLASS_COUNT; i++) {
+    cmd_pool_class_t *cls = &pool->classes[i];
+    cls->size = cmd_pool_class_sizes[i];
+    cmd_pool_link_blocks(cls, p, cmd_pool_class_blocks[i]);
+    p += (size_t)cls->size * cmd_pool_class_blocks[i];
+  }
 
-      cmd[cmd_len++] = c;
+  ESP_LOGI(TAG, "命令池已分配 %zu bytes", sizeof(cmd_pool_t) + arena_size);
+  return pool;
+}
+
+void cmd_pool_destroy(cmd_pool_t *pool) {
+  if (pool == NULL) {
+    return;
+  }
+  while (pool->slabs != NULL) {
+    cmd_pool_slab_t *next = pool->slabs->next;
+    free(pool->slabs);
+    pool->slabs = next;
+  }
+  vSemaphoreDelete(pool->mutex);
+  free(pool);
+}
+
+cmd_queue_item_t *cmd_pool_alloc_item(cmd_pool_t *pool, const char *command) {
+  if (xSemaphoreTake(pool->mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+    return NULL;
+  }
+
+  // 取能放下命令行的最小尺寸等级（最后一级为MAX_CMD_LENGTH，总能放下）
+  size_t length = strnlen(command, MAX_CMD_LENGTH - 1);
+  int class_index = 0;
+  while (pool->classes[class_index].size <= length) {
+    class_index++;
+  }
+
+  // 该等级用完时追加一块；内存不足时借用更大等级的空闲块
+  if (pool->classes[class_index].free_list == NULL) {
+    cmd_pool_class_t *cls = &pool->classes[class_index];
+    uint8_t *blocks = cmd_pool_add_slab(pool, (size_t)cls->size * cmd_pool_class_blocks[class_index]);
+    if (blocks != NULL) {
+      cmd_pool_link_blocks(cls, blocks, cmd_pool_class_blocks[class_index]);
     }
+    while (class_index < CMD_POOL_CLASS_COUNT && pool->classes[class_index].free_list == NULL) {
+      class_index++;
+    }
+  }
 
-    if (cmd_len > 0) {
-      found_cmd = true;
-      cmd[cmd_len] = '\0';
-      
-      // 移除已处理的数据（包括换行符）
-      size_t remove_count = cmd_len + (found_eol ? 1 : 0);
-      while (remove_count > 0 && buffer->count > 0) {
-        buffer->tail = (buffer->tail + 1) % CMD_BUFFER_SIZE;
-        buffer->count--;
-        remove_count--;
-      }
-      
-      ESP_LOGI(TAG, "找到命令: '%s'", cmd);
+  if (pool->free_items == NULL) {
+    cmd_queue_item_t *items = cmd_pool_add_slab(pool, sizeof(cmd_queue_item_t) * CMD_POOL_GROW_ITEMS);
+    if (items != NULL) {
+      cmd_pool_link_items(pool, items, CMD_POOL_GROW_ITEMS);
     }
   }
 
-  xSemaphoreGive(buffer->mutex);
-  return found_cmd;
+  if (pool->free_items == NULL || class_index == CMD_POOL_CLASS_COUNT) {
+    pool->alloc_failures++;
+    xSemaphoreGive(pool->mutex);
+    return NULL;
+  }
+
+  cmd_pool_class_t *cls = &pool->classes[class_index];
+  char *line = cls->free_list;
+  cls->free_list = *(void **)line;
+  if (++cls->used > cls->peak) {
+    cls->peak = cls->used;
+  }
+
+  cmd_queue_item_t *item = pool->free_items;
+  pool->free_items = item->next;
+  if (++pool->items_used > pool->items_peak) {
+    pool->items_peak = pool->items_used;
+  }
+  xSemaphoreGive(pool->mutex);
+
+  memcpy(line, command, length);
+  line[length] = '\0';
+  item->command = line;
+  item->size_class = class_index;
+  item->line_number = 0;
+  item->flags = 0;
+  item->opcode = MACRO_OP_COMMAND;
+  item->params_offset = 0;
+  item->operand = 0;
+  item->handler = NULL;
+  item->compiled_version = 0;
+  item->target = NULL;
+  item->next = NULL;
+  return item;
 }
 
-// 新增：获取所有可用命令（以换行符分隔）
-bool cmd_get_all_commands(cmd_buffer_t *buffer, char *commands, size_t max_length) {
-  if (xSemaphoreTake(buffer->mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
-    return false;
+void cmd_pool_free_item(cmd_pool_t *pool, cmd_queue_item_t *item) {
+  if (item == NULL) {
+    return;
   }
 
-  bool found_commands = false;
-  size_t commands_len = 0;
-  size_t temp_tail = buffer->tail;
-  size_t temp_count = buffer->count;
+  xSemaphoreTake(pool->mutex, portMAX_DELAY);
+  cmd_pool_class_t *cls = &pool->classes[item->size_class];
+  *(void **)item->command = cls->free_list;
+  cls->free_list = item->command;
+  cls->used--;
 
-  // 如果有数据，就尝试解析所有命令
-  if (temp_count > 0) {
-    size_t search_count = temp_count;
-    size_t search_tail = temp_tail;
-    
-    while (search_count > 0 && commands_len < max_length - 1) {
-      char c = buffer->buffer[search_tail];
-      search_tail = (search_tail + 1) % CMD_BUFFER_SIZE;
-      search_count--;
-      
-      if (c == '\n' || c == '\r') {
-        // 遇到换行符，检查是否有下一个命令
-        if (search_count > 0) {
-          // 还有更多数据，继续读取
-          commands[commands_len++] = c;
-        } else {
-          // 没有更多数据，结束
-          break;
-        }
-      } else {
-        commands[commands_len++] = c;
-      }
+  item->command = NULL;
+  item->next = pool->free_items;
+  pool->free_items = item;
+  pool->items_used--;
+  xSemaphoreGive(pool->mutex);
+}
+
+macro_item_t *cmd_pool_alloc_macro(cmd_pool_t *pool) {
+  if (xSemaphoreTake(pool->mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+    return NULL;
+  }
+
+  if (pool->free_macros == NULL) {
+    macro_item_t *macros = cmd_pool_add_slab(pool, sizeof(macro_item_t) * CMD_POOL_MACROS);
+    if (macros != NULL) {
+      cmd_pool_link_macros(pool, macros, CMD_POOL_MACROS);
     }
+  }
 
-    if (commands_len > 0) {
-      found_commands = true;
-      commands[commands_len] = '\0';
-      
-      // 移除已处理的所有数据
-      size_t remove_count = commands_len;
-      while (remove_count > 0 && buffer->count > 0) {
-        buffer->tail = (buffer->tail + 1) % CMD_BUFFER_SIZE;
-        buffer->count--;
-        remove_count--;
-      }
-      
-      ESP_LOGI(TAG, "找到多个命令: '%s'", commands);
+  macro_item_t *macro = pool->free_macros;
+  if (macro != NULL) {
+    pool->free_macros = macro->next;
+    if (++pool->macros_used > pool->macros_peak) {
+      pool->macros_peak = pool->macros_used;
     }
+  } else {
+    pool->alloc_failures++;
   }
 
-  xSemaphoreGive(buffer->mutex);
-  return found_commands;
+  xSemaphoreGive(pool->mutex);
+  return macro;
+}
+
+void cmd_pool_free_macro(cmd_pool_t *pool, macro_item_t *macro) {
+  if (macro == NULL) {
+    return;
+  }
+
+  xSemaphoreTake(pool->mutex, portMAX_DELAY);
+  macro->next = pool->free_macros;
+  pool->free_macros = macro;
+  pool->macros_used--;
+  xSemaphoreGive(pool->mutex);
+}
+
+void cmd_pool_stats(cmd_pool_t *pool, char *buffer, size_t buffer_size) {
+  if (pool == NULL || xSemaphoreTake(pool->mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+    snprintf(buffer, buffer_size, "命令池不可用\r\n");
+    return;
+  }
+
+  int offset = snprintf(buffer, buffer_size,
+                        "命令节点: %u/%u (峰值 %u)\r\n"
+                        "宏: %u/%u (峰值 %u)\r\n",
+                        pool->items_used, pool->items_capacity, pool->items_peak,
+                        pool->macros_used, pool->macros_capacity, pool->macros_peak);
+  for (int i = 0; i < CMD_POOL_CLASS_COUNT && offset > 0 && (size_t)offset < buffer_size; i++) {
+    cmd_pool_class_t *cls = &pool->classes[i];
+    offset += snprintf(buffer + offset, buffer_size - offset, "行存储 %uB: %u/%u (峰值 %u)\r\n",
+                       cls->size, cls->used, cls->capacity, cls->peak);
+  }
+  if (offset > 0 && (size_t)offset < buffer_size) {
+    snprintf(buffer + offset, buffer_size - offset, "追加块: %u, 分配失败: %lu\r\n",
+             pool->slab_count, (unsigned long)pool->alloc_failures);
+  }
+
+  xSemaphoreGive(pool->mutex);
 }
 
 // 命令队列操作函数实现
-void cmd_queue_init(cmd_queue_t *queue) {
+void cmd_queue_init(cmd_queue_t *queue, cmd_pool_t *pool) {
   queue->head = NULL;
   queue->tail = NULL;
   queue->count = 0;
+  queue->pool = pool;
   queue->mutex = xSemaphoreCreateMutex();
 }
 
-void cmd_queue_enqueue(cmd_queue_t *queue, const char *command) {
-  if (xSemaphoreTake(queue->mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+void cmd_queue_deinit(cmd_queue_t *queue) {
+  if (queue->mutex == NULL) {
     return;
   }
+  cmd_queue_clear(queue);
+  vSemaphoreDelete(queue->mutex);
+  queue->mutex = NULL;
+}
+
+bool cmd_queue_enqueue(cmd_queue_t *queue, const char *command) {
+  if (xSemaphoreTake(queue->mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+    return false;
+  }
   
-  cmd_queue_item_t *item = malloc(sizeof(cmd_queue_item_t));
+  cmd_queue_item_t *item = cmd_pool_alloc_item(queue->pool, command);
   if (item != NULL) {
-    strncpy(item->command, command, MAX_CMD_LENGTH - 1);
-    item->command[MAX_CMD_LENGTH - 1] = '\0';
     item->line_number = queue->count + 1;  // 自动分配行号
-    item->next = NULL;
     
     if (queue->tail == NULL) {
       queue->head = item;
@@ -499,60 +1199,22 @@ void cmd_queue_enqueue(cmd_queue_t *queue, const char *command) {
     queue->count++;
     
     ESP_LOGI(TAG, "命令已加入队列: '%s'", command);
+  } else {
+    ESP_LOGW(TAG, "命令池内存不足，丢弃命令: '%s'", command);
   }
   
   xSemaphoreGive(queue->mutex);
+  return item != NULL;
 }
 
-bool cmd_queue_dequeue(cmd_queue_t *queue, char *command, size_t max_length) {
-  if (xSemaphoreTake(queue->mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
-    return false;
-  }
-  
-  bool success = false;
-  if (queue->head != NULL) {
-    cmd_queue_item_t *item = queue->head;
-    strncpy(command, item->command, max_length - 1);
-    command[max_length - 1] = '\0';
-    
-    queue->head = item->next;
-    if (queue->head == NULL) {
-      queue->tail = NULL;
-    }
-    queue->count--;
-    
-    free(item);
-    success = true;
-    
-    ESP_LOGI(TAG, "命令已从队列取出: '%s'", command);
-  }
-  
-  xSemaphoreGive(queue->mutex);
-  return success;
-}
-
-bool cmd_queue_peek(cmd_queue_t *queue, char *command, size_t max_length, size_t index) {
+cmd_queue_item_t *cmd_queue_first(cmd_queue_t *queue) {
   if (xSemaphoreTake(queue->mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
-    return false;
-  }
-  
-  bool success = false;
-  cmd_queue_item_t *current = queue->head;
-  size_t current_index = 0;
-  
-  while (current != NULL && current_index < index) {
-    current = current->next;
-    current_index++;
-  }
-  
-  if (current != NULL) {
-    strncpy(command, current->command, max_length - 1);
-    command[max_length - 1] = '\0';
-    success = true;
+    return NULL;
   }
   
+  cmd_queue_item_t *head = queue->head;
   xSemaphoreGive(queue->mutex);
-  return success;
+  return head;
 }
 
 void cmd_queue_clear(cmd_queue_t *queue) {
@@ -563,7 +1225,7 @@ void cmd_queue_clear(cmd_queue_t *queue) {
   while (queue->head != NULL) {
     cmd_queue_item_t *item = queue->head;
     queue->head = item->next;
-    free(item);
+    cmd_pool_free_item(queue->pool, item);
   }
   queue->tail = NULL;
   queue->count = 0;
@@ -755,12 +1417,155 @@ void kv_store_list(kv_store_t *store, char *buffer, size_t buffer_size) {
 }
 
 // 宏缓冲区操作函数实现
-void macro_buffer_init(macro_buffer_t *macro) {
+// 宏控制流关键字
+static const struct {
+  const char *name;
+  macro_op_t opcode;
+} macro_keywords[] = {
+  {"label", MACRO_OP_LABEL},
+  {"goto", MACRO_OP_GOTO},
+  {"loop", MACRO_OP_LOOP},
+  {"endloop", MACRO_OP_ENDLOOP},
+  {"while", MACRO_OP_WHILE},
+  {"endwhile", MACRO_OP_ENDWHILE},
+  {"break", MACRO_OP_BREAK},
+  {"inc", MACRO_OP_INC},
+  {"dec", MACRO_OP_DEC},
+  {"exit", MACRO_OP_EXIT},
+};
+
+// 编译一条宏命令：识别控制流指令，解析命令名和参数位置，查找任务函数
+static void macro_compile_command(cmd_queue_item_t *item) {
+  static const char *const builtins[] = {"macro", "endmacro", "exec", "jump"};
+  
+  // 与cmd_execute_line的解析规则一致：命令名后的第一个分隔符之后为参数
+  const char *name = item->command + strspn(item->command, " \t");
+  size_t name_len = strcspn(name, " \t");
+  const char *params = name + name_len;
+  if (*params != '\0') {
+    params++;
+  }
+  
+  item->params_offset = params - item->command;
+  item->handler = NULL;
+  item->flags &= CMD_ITEM_TOO_DEEP;
+  item->opcode = MACRO_OP_COMMAND;
+  item->operand = 0;
+  item->compiled_version = task_list_version;
+  
+  for (size_t i = 0; i < sizeof(macro_keywords) / sizeof(macro_keywords[0]); i++) {
+    if (strlen(macro_keywords[i].name) == name_len && strncmp(name, macro_keywords[i].name, name_len) == 0) {
+      item->opcode = macro_keywords[i].opcode;
+      if (item->opcode == MACRO_OP_LOOP) {
+        item->operand = atoi(params);
+      } else if (item->opcode == MACRO_OP_INC || item->opcode == MACRO_OP_DEC) {
+        long amount = 1;
+        sscanf(params, "%*s %ld", &amount);
+        item->operand = amount;
+      }
+      return;
+    }
+  }
+  
+  for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+    if (strlen(builtins[i]) == name_len && strncmp(name, builtins[i], name_len) == 0) {
+      item->flags |= CMD_ITEM_BUILTIN;
+      return;
+    }
+  }
+  
+  // 后台执行的命令经cmd_execute提交作业
+  size_t length;
+  if (cmd_is_background(item->command, &length)) {
+    return;
+  }
+  
+  const cmd_task_t *task = cmd_find_task(name, name_len);
+  if (task != NULL) {
+    item->handler = task->task_func;
+  }
+}
+
+// 连接宏的跳转目标：配对loop/endloop、while/endwhile，break指向所在循环的结尾，goto指向标签
+// 无法配对的指令目标为NULL，执行到时报错；超过MACRO_MAX_DEPTH的循环及其结尾标记为嵌套过深
+// 返回第一个嵌套过深的循环，没有时返回NULL
+static const cmd_queue_item_t *macro_link(cmd_queue_t *queue) {
+  cmd_queue_item_t *open[MACRO_MAX_DEPTH];
+  int depth = 0;
+  int excess = 0;                             // 超出MACRO_MAX_DEPTH的层数，这些层的结尾不与外层配对
+  const cmd_queue_item_t *too_deep = NULL;
+  
+  for (cmd_queue_item_t *item = queue->head; item != NULL; item = item->next) {
+    item->target = NULL;
+    item->flags &= ~CMD_ITEM_TOO_DEEP;
+    switch (item->opcode) {
+      case MACRO_OP_LOOP:
+      case MACRO_OP_WHILE:
+        if (depth < MACRO_MAX_DEPTH) {
+          open[depth++] = item;
+        } else {
+          item->flags |= CMD_ITEM_TOO_DEEP;
+          excess++;
+          if (too_deep == NULL) {
+            too_deep = item;
+          }
+        }
+        break;
+      case MACRO_OP_ENDLOOP:
+      case MACRO_OP_ENDWHILE: {
+        if (excess > 0) {
+          item->flags |= CMD_ITEM_TOO_DEEP;
+          excess--;
+          break;
+        }
+        macro_op_t expected = (item->opcode == MACRO_OP_ENDLOOP) ? MACRO_OP_LOOP : MACRO_OP_WHILE;
+        if (depth > 0 && open[depth - 1]->opcode == expected) {
+          cmd_queue_item_t *start = open[--depth];
+          start->target = item;
+          item->target = start;
+        }
+        break;
+      }
+      case MACRO_OP_BREAK:
+        // 先指向循环开头，循环结尾配对后再改为结尾
+        if (depth > 0 && excess == 0) {
+          item->target = open[depth - 1];
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  
+  for (cmd_queue_item_t *item = queue->head; item != NULL; item = item->next) {
+    if (item->opcode == MACRO_OP_BREAK && item->target != NULL) {
+      item->target = item->target->target;
+    } else if (item->opcode == MACRO_OP_GOTO) {
+      char label[64];
+      if (sscanf(item->command + item->params_offset, "%63s", label) != 1) {
+        continue;
+      }
+      for (cmd_queue_item_t *l = queue->head; l != NULL; l = l->next) {
+        char name[64];
+        if (l->opcode == MACRO_OP_LABEL && sscanf(l->command + l->params_offset, "%63s", name) == 1 &&
+            strcmp(name, label) == 0) {
+          item->target = l;
+          break;
+        }
+      }
+    }
+  }
+  
+  return too_deep;
+}
+
+void macro_buffer_init(macro_buffer_t *macro, cmd_pool_t *pool) {
   macro->head = NULL;
   macro->count = 0;
   macro->recording = false;
   memset(macro->current_macro_name, 0, sizeof(macro->current_macro_name));
-  cmd_queue_init(&macro->temp_queue);
+  macro->pool = pool;
+  cmd_queue_init(&macro->temp_queue, pool);
   macro->mutex = xSemaphoreCreateMutex();
   macro->executing = false;
   macro->executing_channel_id = 0;
@@ -803,7 +1608,7 @@ bool macro_buffer_stop_recording(macro_buffer_t *macro) {
   }
   
   // 创建新的宏项
-  macro_item_t *new_macro = (macro_item_t *)malloc(sizeof(macro_item_t));
+  macro_item_t *new_macro = cmd_pool_alloc_macro(macro->pool);
   if (new_macro == NULL) {
     xSemaphoreGive(macro->mutex);
     return false;
@@ -812,11 +1617,24 @@ bool macro_buffer_stop_recording(macro_buffer_t *macro) {
   strncpy(new_macro->name, macro->current_macro_name, sizeof(new_macro->name) - 1);
   new_macro->name[sizeof(new_macro->name) - 1] = '\0';
   
-  // 复制命令队列
-  cmd_queue_init(&new_macro->queue);
-  char command[MAX_CMD_LENGTH];
-  while (cmd_queue_dequeue(&macro->temp_queue, command, MAX_CMD_LENGTH)) {
-    cmd_queue_enqueue(&new_macro->queue, command);
+  // 录制的命令节点直接移交给新宏，不再逐条复制
+  cmd_queue_init(&new_macro->queue, macro->pool);
+  xSemaphoreTake(macro->temp_queue.mutex, portMAX_DELAY);
+  new_macro->queue.head = macro->temp_queue.head;
+  new_macro->queue.tail = macro->temp_queue.tail;
+  new_macro->queue.count = macro->temp_queue.count;
+  macro->temp_queue.head = NULL;
+  macro->temp_queue.tail = NULL;
+  macro->temp_queue.count = 0;
+  xSemaphoreGive(macro->temp_queue.mutex);
+  
+  // 录制结束时编译每条命令并连接跳转目标，回放时直接调用任务函数
+  for (cmd_queue_item_t *item = new_macro->queue.head; item != NULL; item = item->next) {
+    macro_compile_command(item);
+  }
+  const cmd_queue_item_t *too_deep = macro_link(&new_macro->queue);
+  if (too_deep != NULL) {
+    ESP_LOGW(TAG, "宏 %s 第%d行循环嵌套过深", new_macro->name, too_deep->line_number);
   }
   
   // 添加到宏列表
@@ -841,10 +1659,205 @@ bool macro_buffer_add_command(macro_buffer_t *macro, const char *command) {
     xSemaphoreGive(macro->mutex);
     return false; // 没有在录制
   }
-  
-  cmd_queue_enqueue(&macro->temp_queue, command);
+  
+  bool added = cmd_queue_enqueue(&macro->temp_queue, command);
+  xSemaphoreGive(macro->mutex);
+  return added;
+}
+
+// 宏执行出错时通知终端并结束执行
+static void macro_report_error(uint32_t channel_id, const cmd_queue_item_t *item, const char *message) {
+  char response[MAX_CMD_LENGTH + 64];
+  snprintf(response, sizeof(response), "宏错误: 第%d行 '%s': %s\r\n", item->line_number, item->command, message);
+  cmd_output(channel_id, (uint8_t *)response, strlen(response));
+}
+
+// 报告刚录制完的宏（宏列表头）在连接时发现的错误
+static void macro_report_link_errors(macro_buffer_t *macro, uint32_t channel_id) {
+  if (xSemaphoreTake(macro->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    return;
+  }
+  if (macro->head != NULL) {
+    for (cmd_queue_item_t *item = cmd_queue_first(&macro->head->queue); item != NULL; item = item->next) {
+      if ((item->flags & CMD_ITEM_TOO_DEEP) &&
+          (item->opcode == MACRO_OP_LOOP || item->opcode == MACRO_OP_WHILE)) {
+        macro_report_error(channel_id, item, "循环嵌套过深");
+      }
+    }
+  }
   xSemaphoreGive(macro->mutex);
-  return true;
+}
+
+// 读取键值，键不存在时为0
+static uint32_t macro_key_value(shell_instance_t *instance, const char *params) {
+  char key[64];
+  uint32_t value = 0;
+  if (instance != NULL && sscanf(params, "%63s", key) == 1) {
+    kv_store_get(&instance->kv_store, key, &value);
+  }
+  return value;
+}
+
+// 从指定命令开始按程序计数器执行宏，返回执行的普通命令数
+// 调用者持有macro->mutex，宏在执行期间不会被修改或删除，遍历命令链表无需再加锁
+static size_t macro_run_commands(macro_buffer_t *macro, cmd_queue_item_t *item,
+                                 uint32_t channel_id, bool interruptible) {
+  shell_instance_t *instance = shell_get_instance_by_channel(channel_id);
+  struct {
+    cmd_queue_item_t *loop;                   // 循环开头的loop指令
+    int32_t remaining;                        // 剩余次数
+  } frames[MACRO_MAX_DEPTH];
+  int depth = 0;
+  size_t executed = 0;
+  uint32_t steps = 0;
+  
+  cmd_queue_item_t *pc = item;
+  while (pc != NULL) {
+    // 检查是否被中断
+    if (interruptible && !macro->executing) {
+      ESP_LOGI(TAG, "宏执行被中断");
+      break;
+    }
+    
+    // 只含控制流的循环不会阻塞，定期让出CPU
+    if (++steps % MACRO_YIELD_STEPS == 0) {
+      vTaskDelay(1);
+    }
+    
+    // 注册表变化后重新编译
+    if (pc->compiled_version != task_list_version) {
+      macro_compile_command(pc);
+    }
+    
+    if (pc->flags & CMD_ITEM_TOO_DEEP) {
+      macro_report_error(channel_id, pc, "循环嵌套过深");
+      return executed;
+    }
+    
+    const char *params = pc->command + pc->params_offset;
+    cmd_queue_item_t *next = pc->next;
+    switch (pc->opcode) {
+      case MACRO_OP_LABEL:
+        break;
+        
+      case MACRO_OP_GOTO: {
+        if (pc->target == NULL) {
+          macro_report_error(channel_id, pc, "标签不存在");
+          return executed;
+        }
+        char key[64];
+        if (sscanf(params, "%*s %63s", key) != 1 || macro_key_value(instance, key) != 0) {
+          next = pc->target;
+        }
+        break;
+      }
+      
+      case MACRO_OP_LOOP:
+        if (pc->target == NULL) {
+          macro_report_error(channel_id, pc, "缺少配对的endloop");
+          return executed;
+        }
+        if (pc->operand <= 0) {
+          next = pc->target->next;
+        } else if (depth == MACRO_MAX_DEPTH) {
+          macro_report_error(channel_id, pc, "循环嵌套过深");
+          return executed;
+        } else {
+          frames[depth].loop = pc;
+          frames[depth].remaining = pc->operand;
+          depth++;
+        }
+        break;
+        
+      case MACRO_OP_ENDLOOP: {
+        if (pc->target == NULL) {
+          macro_report_error(channel_id, pc, "缺少配对的loop");
+          return executed;
+        }
+        // 经goto跳出的内层循环在此一并结束
+        int frame = depth - 1;
+        while (frame >= 0 && frames[frame].loop != pc->target) {
+          frame--;
+        }
+        if (frame >= 0) {
+          depth = frame + 1;
+          if (--frames[frame].remaining > 0) {
+            next = pc->target->next;
+          } else {
+            depth = frame;
+          }
+        }
+        break;
+      }
+      
+      case MACRO_OP_WHILE:
+        if (pc->target == NULL) {
+          macro_report_error(channel_id, pc, "缺少配对的endwhile");
+          return executed;
+        }
+        if (macro_key_value(instance, params) == 0) {
+          next = pc->target->next;
+        }
+        break;
+        
+      case MACRO_OP_ENDWHILE:
+        if (pc->target == NULL) {
+          macro_report_error(channel_id, pc, "缺少配对的while");
+          return executed;
+        }
+        next = pc->target;
+        break;
+        
+      case MACRO_OP_BREAK:
+        if (pc->target == NULL) {
+          macro_report_error(channel_id, pc, "不在循环内");
+          return executed;
+        }
+        if (pc->target->opcode == MACRO_OP_ENDLOOP) {
+          while (depth > 0 && frames[depth - 1].loop != pc->target->target) {
+            depth--;
+          }
+          if (depth > 0) {
+            depth--;
+          }
+        }
+        next = pc->target->next;
+        break;
+        
+      case MACRO_OP_INC:
+      case MACRO_OP_DEC: {
+        char key[64];
+        if (instance == NULL || sscanf(params, "%63s", key) != 1) {
+          macro_report_error(channel_id, pc, "缺少键名");
+          return executed;
+        }
+        uint32_t value = macro_key_value(instance, key);
+        if (pc->opcode == MACRO_OP_INC) {
+          value += pc->operand;
+        } else {
+          value = (value > (uint32_t)pc->operand) ? value - pc->operand : 0;
+        }
+        kv_store_set(&instance->kv_store, key, value);
+        break;
+      }
+      
+      case MACRO_OP_EXIT:
+        next = NULL;
+        break;
+        
+      default:
+        // 已编译的命令直接调用任务函数；内置命令、未知命令和录制中的命令仍走完整解析
+        if (pc->handler != NULL && !macro->recording) {
+          pc->handler(channel_id, params);
+        } else {
+          cmd_execute(channel_id, pc->command);
+        }
+        executed++;
+        break;
+    }
+    pc = next;
+  }
+  return executed;
 }
 
 bool macro_buffer_execute(macro_buffer_t *macro, uint32_t channel_id) {
@@ -875,27 +1888,10 @@ bool macro_buffer_execute(macro_buffer_t *macro, uint32_t channel_id) {
   xSemaphoreGive(macro->execution_mutex);
   
   macro_item_t *first_macro = macro->head;
-  char command[MAX_CMD_LENGTH];
-  bool executed = false;
-  size_t command_count = cmd_queue_size(&first_macro->queue);
   
   // 遍历所有命令并执行，但不删除
-  for (size_t i = 0; i < command_count; i++) {
-    // 检查是否被中断
-    if (xSemaphoreTake(macro->execution_mutex, pdMS_TO_TICKS(1)) == pdTRUE) {
-      if (!macro->executing) {
-        xSemaphoreGive(macro->execution_mutex);
-        ESP_LOGI(TAG, "宏执行被中断");
-        break;
-      }
-      xSemaphoreGive(macro->execution_mutex);
-    }
-    
-    if (cmd_queue_peek(&first_macro->queue, command, MAX_CMD_LENGTH, i)) {
-      cmd_execute(channel_id, command);
-      executed = true;
-    }
-  }
+  size_t command_count = macro_run_commands(macro, cmd_queue_first(&first_macro->queue), channel_id, true);
+  bool executed = command_count > 0;
   
   // 清除执行状态
   if (xSemaphoreTake(macro->execution_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
@@ -936,27 +1932,9 @@ bool macro_buffer_execute_by_name(macro_buffer_t *macro, const char *macro_name,
       macro->executing_channel_id = channel_id;
       xSemaphoreGive(macro->execution_mutex);
       
-      char command[MAX_CMD_LENGTH];
-      bool executed = false;
-      size_t command_count = cmd_queue_size(&current->queue);
-      
       // 遍历所有命令并执行，但不删除
-      for (size_t i = 0; i < command_count; i++) {
-        // 检查是否被中断
-        if (xSemaphoreTake(macro->execution_mutex, pdMS_TO_TICKS(1)) == pdTRUE) {
-          if (!macro->executing) {
-            xSemaphoreGive(macro->execution_mutex);
-            ESP_LOGI(TAG, "宏执行被中断");
-            break;
-          }
-          xSemaphoreGive(macro->execution_mutex);
-        }
-        
-        if (cmd_queue_peek(&current->queue, command, MAX_CMD_LENGTH, i)) {
-          cmd_execute(channel_id, command);
-          executed = true;
-        }
-      }
+      size_t command_count = macro_run_commands(macro, cmd_queue_first(&current->queue), channel_id, true);
+      bool executed = command_count > 0;
       
       // 清除执行状态
       if (xSemaphoreTake(macro->execution_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
@@ -995,8 +1973,8 @@ bool macro_buffer_delete(macro_buffer_t *macro, const char *macro_name) {
         prev->next = current->next;
       }
       
-      cmd_queue_clear(&current->queue);
-      free(current);
+      cmd_queue_deinit(&current->queue);
+      cmd_pool_free_macro(macro->pool, current);
       macro->count--;
       
       ESP_LOGI(TAG, "删除宏: %s", macro_name);
@@ -1019,8 +1997,8 @@ void macro_buffer_clear(macro_buffer_t *macro) {
   macro_item_t *current = macro->head;
   while (current != NULL) {
     macro_item_t *next = current->next;
-    cmd_queue_clear(&current->queue);
-    free(current);
+    cmd_queue_deinit(&current->queue);
+    cmd_pool_free_macro(macro->pool, current);
     current = next;
   }
   
@@ -1075,13 +2053,27 @@ void macro_buffer_list(macro_buffer_t *macro, char *buffer, size_t buffer_size)
 }
 
 bool macro_buffer_is_recording(macro_buffer_t *macro) {
-  if (xSemaphoreTake(macro->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+  // 单个标志直接读取：宏执行期间本任务持有macro->mutex，加锁会在每条命令上阻塞到超时
+  return macro->recording;
+}
+
+bool macro_buffer_stop_execution(macro_buffer_t *macro, uint32_t channel_id) {
+  if (xSemaphoreTake(macro->execution_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
     return false;
   }
   
-  bool recording = macro->recording;
-  xSemaphoreGive(macro->mutex);
-  return recording;
+  // 回放在下一条命令前检查executing，清除后即退出
+  bool stopped = macro->executing && macro->executing_channel_id == channel_id;
+  if (stopped) {
+    macro->executing = false;
+  }
+  
+  xSemaphoreGive(macro->execution_mutex);
+  return stopped;
+}
+
+bool macro_buffer_is_executing(macro_buffer_t *macro, uint32_t channel_id) {
+  return macro->executing && macro->executing_channel_id == channel_id;
 }
 
 bool macro_buffer_exists(macro_buffer_t *macro, const char *macro_name) {
@@ -1150,38 +2142,15 @@ bool macro_buffer_jump_if_not_zero(macro_buffer_t *macro, const char *macro_name
       
       // 如果值不等于0，执行跳转
       if (value != 0) {
-        // 创建临时队列用于跳转执行
-        cmd_queue_t temp_queue;
-        cmd_queue_init(&temp_queue);
-        
-        // 复制命令到临时队列
-        cmd_queue_item_t *item = current->queue.head;
-        int current_line = 1;
-        
-        while (item != NULL) {
-          if (current_line >= target_line) {
-            cmd_queue_enqueue(&temp_queue, item->command);
-          }
+        // 找到目标行后直接从该行执行，不再复制命令
+        cmd_queue_item_t *item = cmd_queue_first(&current->queue);
+        for (int current_line = 1; item != NULL && current_line < target_line; current_line++) {
           item = item->next;
-          current_line++;
-        }
-        
-        // 执行临时队列中的命令
-        char command[MAX_CMD_LENGTH];
-        bool executed = false;
-        size_t temp_count = cmd_queue_size(&temp_queue);
-        
-        for (size_t i = 0; i < temp_count; i++) {
-          if (cmd_queue_peek(&temp_queue, command, MAX_CMD_LENGTH, i)) {
-            cmd_execute(channel_id, command);
-            executed = true;
-          }
         }
-        
-        // 清理临时队列
-        cmd_queue_clear(&temp_queue);
-        
+        // 目标行可能只有控制流语句，行存在即视为已执行
+        bool executed = item != NULL;
         if (executed) {
+          macro_run_commands(macro, item, channel_id, false);
           ESP_LOGI(TAG, "宏 '%s' 跳转到第 %d 行执行完成", macro_name, target_line);
         }
         
@@ -1201,61 +2170,269 @@ bool macro_buffer_jump_if_not_zero(macro_buffer_t *macro, const char *macro_name
   return false; // 宏不存在
 }
 
-bool cmd_register_task(const char *cmd_name, task_func_t task_func, const char *description) {
+// 后台作业工作任务：依次取出作业执行，执行完释放作业槽
+static void shell_job_worker(void *arg) {
+  uint8_t index;
+  while (1) {
+    if (xQueueReceive(shell_job_queue, &index, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    
+    shell_job_t *job = &shell_jobs[index];
+    char response[MAX_CMD_LENGTH + 32];
+    
+    // 清除上一个作业被kill时留下的通知
+    ulTaskNotifyTake(pdTRUE, 0);
+    job->worker = xTaskGetCurrentTaskHandle();
+    job->running = true;
+    if (!job->cancelled) {
+      ESP_LOGI(TAG, "后台作业[%lu]开始: %s", job->id, job->command);
+      job->handler(job->channel_id, job->command + job->params_offset);
+    }
+    
+    snprintf(response, sizeof(response), "[%lu] %s: %s\r\n", job->id,
+             job->cancelled ? "已终止" : "完成", job->command);
+    cmd_output(job->channel_id, (uint8_t *)response, strlen(response));
+    
+    xSemaphoreTake(shell_jobs_mutex, portMAX_DELAY);
+    job->worker = NULL;
+    job->running = false;
+    job->id = 0;
+    xSemaphoreGive(shell_jobs_mutex);
+  }
+}
+
+// 提交后台作业，返回作业号，作业已满或资源不足时返回0
+static uint32_t shell_job_submit(uint32_t channel_id, task_func_t handler, const char *cmd_name, const char *params) {
+  if (shell_jobs_mutex == NULL || xSemaphoreTake(shell_jobs_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    return 0;
+  }
+  
+  // 第一次提交时创建队列和工作任务
+  if (shell_job_queue == NULL) {
+    shell_job_queue = xQueueCreate(SHELL_MAX_JOBS, sizeof(uint8_t));
+    if (shell_job_queue == NULL) {
+      xSemaphoreGive(shell_jobs_mutex);
+      return 0;
+    }
+    for (int i = 0; i < SHELL_JOB_WORKERS; i++) {
+      // 优先级低于执行任务，前台命令不受后台作业影响
+      if (xTaskCreate(shell_job_worker, "shell_job", 8192, NULL, 2, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "创建后台作业工作任务失败");
+      }
+    }
+  }
+  
+  uint32_t job_id = 0;
+  for (uint8_t i = 0; i < SHELL_MAX_JOBS; i++) {
+    shell_job_t *job = &shell_jobs[i];
+    if (job->id != 0) {
+      continue;
+    }
+    
+    int name_len = snprintf(job->command, sizeof(job->command), "%s", cmd_name);
+    job->params_offset = name_len;
+    if (params != NULL) {
+      snprintf(job->command + name_len, sizeof(job->command) - name_len, " %s", params);
+      job->params_offset = name_len + 1;
+    }
+    job->channel_id = channel_id;
+    job->handler = handler;
+    job->running = false;
+    job->cancelled = false;
+    job->worker = NULL;
+    job->id = shell_next_job_id++;
+    if (shell_next_job_id == 0) {
+      shell_next_job_id = 1;
+    }
+    
+    // 队列长度等于作业槽数，不会满
+    xQueueSend(shell_job_queue, &i, 0);
+    job_id = job->id;
+    break;
+  }
+  
+  xSemaphoreGive(shell_jobs_mutex);
+  return job_id;
+}
+
+void shell_job_list(char *buffer, size_t buffer_size) {
+  size_t offset = 0;
+  buffer[0] = '\0';
+  if (shell_jobs_mutex == NULL || xSemaphoreTake(shell_jobs_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    return;
+  }
+  
+  for (size_t i = 0; i < SHELL_MAX_JOBS && offset < buffer_size; i++) {
+    shell_job_t *job = &shell_jobs[i];
+    if (job->id == 0) {
+      continue;
+    }
+    int written = snprintf(buffer + offset, buffer_size - offset, "[%lu] %s 通道%lu: %s\r\n", job->id,
+                           job->cancelled ? "终止中" : (job->running ? "运行中" : "排队中"),
+                           job->channel_id, job->command);
+    if (written < 0) {
+      break;
+    }
+    offset += written;
+  }
+  
+  xSemaphoreGive(shell_jobs_mutex);
+}
+
+bool shell_job_kill(uint32_t job_id) {
+  if (job_id == 0 || shell_jobs_mutex == NULL || xSemaphoreTake(shell_jobs_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    return false;
+  }
+  
+  bool found = false;
+  for (size_t i = 0; i < SHELL_MAX_JOBS; i++) {
+    shell_job_t *job = &shell_jobs[i];
+    if (job->id == job_id) {
+      // 排队中的作业不再执行；运行中的作业在下一个检查点退出，延时中的立即唤醒
+      job->cancelled = true;
+      if (job->worker != NULL) {
+        xTaskNotifyGive(job->worker);
+      }
+      found = true;
+      break;
+    }
+  }
+  
+  xSemaphoreGive(shell_jobs_mutex);
+  return found;
+}
+
+bool shell_job_cancelled(void) {
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  for (size_t i = 0; i < SHELL_MAX_JOBS; i++) {
+    if (shell_jobs[i].worker == self) {
+      return shell_jobs[i].cancelled;
+    }
+  }
+  return false;
+}
+
+bool shell_job_delay(uint32_t ms) {
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  for (size_t i = 0; i < SHELL_MAX_JOBS; i++) {
+    shell_job_t *job = &shell_jobs[i];
+    if (job->worker != self) {
+      continue;
+    }
+    
+    // 后台作业：等待kill的通知，到时或被kill时返回
+    TickType_t start = xTaskGetTickCount();
+    TickType_t ticks = pdMS_TO_TICKS(ms);
+    while (!job->cancelled) {
+      TickType_t elapsed = xTaskGetTickCount() - start;
+      if (elapsed >= ticks) {
+        return true;
+      }
+      ulTaskNotifyTake(pdTRUE, ticks - elapsed);
+    }
+    return false;
+  }
+  
+  // 前台执行时执行任务的通知用于唤醒命令处理，不能用来等待
+  vTaskDelay(pdMS_TO_TICKS(ms));
+  return true;
+}
+
+static bool cmd_register(const char *cmd_name, task_func_t task_func, const char *description, uint8_t flags) {
   if (xSemaphoreTake(task_list_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
     return false;
   }
 
-  if (task_count >= MAX_TASKS) {
-    ESP_LOGE(TAG, "任务列表已满，无法注册新任务");
+  // 检查是否已存在同名任务（指针单次写入，读取方看到的是旧值或新值）
+  cmd_task_t *existing = (cmd_task_t *)cmd_find_task(cmd_name, strlen(cmd_name));
+  if (existing != NULL) {
+    ESP_LOGW(TAG, "任务 '%s' 已存在，将被覆盖", cmd_name);
+    existing->task_func = task_func;
+    existing->description = description;
+    existing->flags = flags;
+    task_list_version++;
     xSemaphoreGive(task_list_mutex);
-    return false;
+    return true;
   }
 
-  // 检查是否已存在同名任务
-  for (size_t i = 0; i < task_count; i++) {
-    if (strcmp(task_list[i].cmd_name, cmd_name) == 0) {
-      ESP_LOGW(TAG, "任务 '%s' 已存在，将被覆盖", cmd_name);
-      task_list[i].task_func = task_func;
-      task_list[i].description = description;
+  cmd_task_table_t *table = task_table;
+  if (table->count == table->capacity) {
+    if (table->capacity >= UINT16_MAX / 2) {
+      ESP_LOGE(TAG, "任务列表已满，无法注册新任务");
       xSemaphoreGive(task_list_mutex);
-      return true;
+      return false;
+    }
+    table = cmd_task_table_grow(table->capacity * 2);
+    if (table == NULL) {
+      ESP_LOGE(TAG, "扩展命令表失败，无法注册新任务");
+      xSemaphoreGive(task_list_mutex);
+      return false;
     }
   }
 
-  // 添加新任务
-  task_list[task_count].cmd_name = cmd_name;
-  task_list[task_count].task_func = task_func;
-  task_list[task_count].description = description;
-  task_count++;
+  // 添加新任务：先写数组元素，再发布索引槽
+  size_t index = table->count;
+  table->tasks[index].cmd_name = cmd_name;
+  table->tasks[index].task_func = task_func;
+  table->tasks[index].description = description;
+  table->tasks[index].flags = flags;
+  cmd_task_table_index(table, index);
+  __atomic_store_n(&table->count, index + 1, __ATOMIC_RELEASE);
+  task_list_version++;
 
   ESP_LOGI(TAG, "注册任务: %s", cmd_name);
   xSemaphoreGive(task_list_mutex);
   return true;
 }
 
+bool cmd_register_task(const char *cmd_name, task_func_t task_func, const char *description) {
+  return cmd_register(cmd_name, task_func, description, 0);
+}
+
+bool cmd_register_urgent_task(const char *cmd_name, task_func_t task_func, const char *description) {
+  return cmd_register(cmd_name, task_func, description, CMD_TASK_URGENT);
+}
+
 void cmd_execute(uint32_t channel_id, const char *command) {
   if (command == NULL || strlen(command) == 0) {
     return;
   }
 
+  // 复制一份后原地解析
+  char cmd_copy[MAX_CMD_LENGTH];
+  strncpy(cmd_copy, command, MAX_CMD_LENGTH - 1);
+  cmd_copy[MAX_CMD_LENGTH - 1] = '\0';
+  cmd_execute_line(channel_id, cmd_copy);
+}
+
+// 原地解析并执行命令行，line会被修改
+void cmd_execute_line(uint32_t channel_id, char *line) {
   // 获取shell实例
   shell_instance_t *instance = shell_get_instance_by_channel(channel_id);
   if (instance == NULL) {
     return;
   }
 
-  // 解析命令和参数
-  char cmd_copy[MAX_CMD_LENGTH];
-  strncpy(cmd_copy, command, MAX_CMD_LENGTH - 1);
-  cmd_copy[MAX_CMD_LENGTH - 1] = '\0';
-
-  char *cmd_name = strtok(cmd_copy, " \t");
-  char *params = strtok(NULL, "");
+  // 行尾的&表示后台执行，去掉后再解析；内置命令不支持后台执行，按前台执行
+  size_t length;
+  bool background = cmd_is_background(line, &length);
+  if (background) {
+    line[length] = '\0';
+  }
 
-  if (cmd_name == NULL) {
+  // 解析命令和参数：命令名后的第一个分隔符替换为结束符
+  char *cmd_name = line + strspn(line, " \t");
+  if (*cmd_name == '\0') {
     return;
   }
+  char *name_end = cmd_name + strcspn(cmd_name, " \t");
+  char separator = *name_end;
+  char *params = NULL;
+  if (separator != '\0') {
+    *name_end = '\0';
+    params = (name_end[1] != '\0') ? name_end + 1 : NULL;
+  }
 
   // 检查是否是宏开始命令
   if (strcmp(cmd_name, "macro") == 0) {
@@ -1283,6 +2460,7 @@ void cmd_execute(uint32_t channel_id, const char *command) {
       char response[256];
       snprintf(response, sizeof(response), "停止录制宏\r\n");
       cmd_output(channel_id, (uint8_t *)response, strlen(response));
+      macro_report_link_errors(&instance->macro_buffer, channel_id);
     } else {
       char response[256];
       snprintf(response, sizeof(response), "错误: 没有在录制宏\r\n");
@@ -1356,26 +2534,38 @@ void cmd_execute(uint32_t channel_id, const char *command) {
 
   // 如果正在录制宏，将命令添加到宏缓冲区而不是执行
   if (macro_buffer_is_recording(&instance->macro_buffer)) {
-    if (macro_buffer_add_command(&instance->macro_buffer, command)) {
+    // 恢复分隔符，录制完整的命令行（后台执行的保留&）
+    *name_end = separator;
+    if (background && length + 2 < MAX_CMD_LENGTH) {
+      strcpy(line + length, " &");
+    }
+    if (macro_buffer_add_command(&instance->macro_buffer, line)) {
+      char response[256];
+      snprintf(response, sizeof(response), "已添加到宏: %s\r\n", line);
+      cmd_output(channel_id, (uint8_t *)response, strlen(response));
+    } else {
       char response[256];
-      snprintf(response, sizeof(response), "已添加到宏: %s\r\n", command);
+      snprintf(response, sizeof(response), "错误: 内存不足，未添加到宏: %s\r\n", line);
       cmd_output(channel_id, (uint8_t *)response, strlen(response));
     }
     return;
   }
 
   // 查找并执行任务
-  bool found = false;
-  for (size_t i = 0; i < task_count; i++) {
-    if (strcmp(task_list[i].cmd_name, cmd_name) == 0) {
-      ESP_LOGI(TAG, "执行任务: %s", cmd_name);
-      task_list[i].task_func(channel_id, params ? params : "");
-      found = true;
-      break;
+  const cmd_task_t *task = cmd_find_task(cmd_name, strlen(cmd_name));
+  if (task != NULL && background) {
+    char response[64];
+    uint32_t job_id = shell_job_submit(channel_id, task->task_func, cmd_name, params);
+    if (job_id != 0) {
+      snprintf(response, sizeof(response), "[%lu] 后台执行\r\n", job_id);
+    } else {
+      snprintf(response, sizeof(response), "错误: 后台作业已满\r\n");
     }
-  }
-
-  if (!found) {
+    cmd_output(channel_id, (uint8_t *)response, strlen(response));
+  } else if (task != NULL) {
+    ESP_LOGI(TAG, "执行任务: %s", cmd_name);
+    task->task_func(channel_id, params ? params : "");
+  } else {
     char error_msg[256];
     snprintf(error_msg, sizeof(error_msg), "未知命令: %s\r\n", cmd_name);
     cmd_output(channel_id, (uint8_t *)error_msg, strlen(error_msg));
@@ -1383,10 +2573,17 @@ void cmd_execute(uint32_t channel_id, const char *command) {
 }
 
 const cmd_task_t *cmd_get_task_list(size_t *count) {
+  const cmd_task_table_t *table = __atomic_load_n(&task_table, __ATOMIC_ACQUIRE);
+  if (table == NULL) {
+    if (count != NULL) {
+      *count = 0;
+    }
+    return NULL;
+  }
   if (count != NULL) {
-    *count = task_count;
+    *count = __atomic_load_n(&table->count, __ATOMIC_ACQUIRE);
   }
-  return task_list;
+  return table->tasks;
 }
 
 // 动态提示符生成函数
@@ -1433,18 +2630,28 @@ void cmd_show_command(uint32_t channel_id, const char *command) {
 
 // 内部输出函数，通过I/O接口发送数据
 void cmd_output(uint32_t channel_id, const uint8_t *data, size_t length) {
-  // 从shell实例中查找对应的输出函数
-  if (xSemaphoreTake(shell_instances_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-    for (size_t i = 0; i < shell_instance_count; i++) {
-      if (shell_instances[i].initialized && 
-          shell_instances[i].config.channel_id == channel_id &&
-          shell_instances[i].config.output_func != NULL) {
-        shell_instances[i].config.output_func(channel_id, data, length);
-        xSemaphoreGive(shell_instances_mutex);
-        return;
+  // 从通道表中查找对应的输出函数，不加锁，不会因其他任务持锁而丢弃输出
+  for (size_t i = 0; i < MAX_SHELL_INSTANCES; i++) {
+    shell_instance_t *instance = __atomic_load_n(&shell_channels[i], __ATOMIC_ACQUIRE);
+    if (instance == NULL || instance->config.channel_id != channel_id) {
+      continue;
+    }
+    
+    // 登记后再次确认仍在表中，销毁方撤下实例后会等待登记归零
+    __atomic_add_fetch(&instance->output_users, 1, __ATOMIC_ACQ_REL);
+    if (__atomic_load_n(&shell_channels[i], __ATOMIC_ACQUIRE) == instance &&
+        instance->initialized && instance->config.output_func != NULL) {
+      // 发送任务运行时写入输出缓冲区，调用者不等待数据发出；未启动时直接输出
+      if (instance->tx_task_handle != NULL) {
+        shell_tx_write(instance, data, length);
+      } else {
+        instance->config.output_func(channel_id, data, length);
       }
+      __atomic_sub_fetch(&instance->output_users, 1, __ATOMIC_RELEASE);
+      return;
     }
-    xSemaphoreGive(shell_instances_mutex);
+    __atomic_sub_fetch(&instance->output_users, 1, __ATOMIC_RELEASE);
+    break;
   }
   
   ESP_LOGW(TAG, "未找到通道 %lu 的输出函数", (unsigned long)channel_id);
@@ -1452,19 +2659,12 @@ void cmd_output(uint32_t channel_id, const uint8_t *data, size_t length) {
 
 // 获取指定通道的shell实例
 shell_instance_t* shell_get_instance_by_channel(uint32_t channel_id) {
-  if (xSemaphoreTake(shell_instances_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
-    return NULL;
-  }
-  
-  for (size_t i = 0; i < shell_instance_count; i++) {
-    if (shell_instances[i].initialized && 
-        shell_instances[i].config.channel_id == channel_id) {
-      xSemaphoreGive(shell_instances_mutex);
-      return &shell_instances[i];
+  for (size_t i = 0; i < MAX_SHELL_INSTANCES; i++) {
+    shell_instance_t *instance = __atomic_load_n(&shell_channels[i], __ATOMIC_ACQUIRE);
+    if (instance != NULL && instance->initialized && instance->config.channel_id == channel_id) {
+      return instance;
     }
   }
-  
-  xSemaphoreGive(shell_instances_mutex);
   return NULL;
 }
 
@@ -1481,11 +2681,154 @@ shell_config_t create_shell_config(uint32_t channel_id,
                            .user_data = NULL};
 }
 
+// 当前行的紧急命令识别状态
+enum {
+  SHELL_URGENT_NAME = 0,                      // 命令名尚未收全，收到的部分暂存
+  SHELL_URGENT_PASS,                          // 普通命令行，直接写入命令缓冲区
+  SHELL_URGENT_LINE,                          // 紧急命令行，收集到行结束符为止
+};
+
+// 写入命令缓冲区，缓冲区满时等待解析任务取走数据，从start起超过CMD_BUFFER_WAIT_MS后丢弃剩余数据
+static void shell_buffer_input(shell_instance_t *instance, const uint8_t *data, size_t length, TickType_t start) {
+  size_t offset = 0;
+  while (offset < length) {
+    offset += cmd_add_data(&instance->cmd_buffer, data + offset, length - offset);
+    
+    // 通知解析任务处理新数据
+    if (instance->parser_task_handle != NULL) {
+      xTaskNotifyGive(instance->parser_task_handle);
+    }
+    
+    if (offset < length) {
+      if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(CMD_BUFFER_WAIT_MS)) {
+        cmd_drop_data(&instance->cmd_buffer, data + offset, length - offset);
+        ESP_LOGW(TAG, "通道 %lu 命令缓冲区溢出，丢弃 %u 字节 (累计溢出 %lu 次)",
+                 (unsigned long)instance->config.channel_id, (unsigned)(length - offset),
+                 (unsigned long)instance->cmd_buffer.overflow_count);
+        break;
+      }
+      vTaskDelay(1);
+    }
+  }
+}
+
+// 识别出完整的紧急命令行，放入紧急命令槽并唤醒控制任务
+static void shell_urgent_submit(shell_instance_t *instance) {
+  shell_urgent_t *urgent = &instance->urgent;
+  if (urgent->head - __atomic_load_n(&urgent->tail, __ATOMIC_ACQUIRE) >= SHELL_URGENT_SLOTS) {
+    urgent->dropped++;
+    ESP_LOGW(TAG, "通道 %lu 紧急命令槽已满，丢弃: '%.*s'", (unsigned long)instance->config.channel_id,
+             (int)urgent->pending_length, urgent->pending);
+    return;
+  }
+  
+  char *line = urgent->lines[urgent->head & (SHELL_URGENT_SLOTS - 1)];
+  memcpy(line, urgent->pending, urgent->pending_length);
+  line[urgent->pending_length] = '\0';
+  __atomic_store_n(&urgent->head, urgent->head + 1, __ATOMIC_RELEASE);
+  
+  if (instance->control_task_handle != NULL) {
+    xTaskNotifyGive(instance->control_task_handle);
+  }
+}
+
+// 当前行的命令名已收全（或不可能是命令名），判断是否为紧急命令
+static bool shell_urgent_match(shell_urgent_t *urgent) {
+  size_t skip = 0;
+  while (skip < urgent->pending_length && (urgent->pending[skip] == ' ' || urgent->pending[skip] == '\t')) {
+    skip++;
+  }
+  size_t name_len = urgent->pending_length - skip;
+  if (name_len == 0) {
+    return false;
+  }
+  const cmd_task_t *task = cmd_find_task(urgent->pending + skip, name_len);
+  return task != NULL && (task->flags & CMD_TASK_URGENT);
+}
+
 // Shell实例缓冲区操作函数（供外部组件使用）
+// 同一通道的数据由一个接收任务依次写入：紧急命令行在进入命令缓冲区前取出交给控制任务，
+// 其余数据按原顺序成段写入命令缓冲区
 void shell_add_data_to_instance(uint32_t channel_id, const uint8_t *data, size_t length) {
   shell_instance_t *instance = shell_get_instance_by_channel(channel_id);
   if (instance != NULL && instance->initialized) {
-    cmd_add_data(&instance->cmd_buffer, (uint8_t *)data, length);
+    shell_urgent_t *urgent = &instance->urgent;
+    TickType_t start = xTaskGetTickCount();
+    size_t run = 0;                           // 尚未写入命令缓冲区的普通数据起点
+    size_t carried = urgent->state == SHELL_URGENT_NAME ? urgent->pending_length : 0; // 上次暂存的行开头
+    
+    for (size_t i = 0; i < length; i++) {
+      uint8_t c = data[i];
+      
+      if (urgent->state == SHELL_URGENT_PASS) {
+        if (cmd_is_eol(c)) {
+          urgent->state = SHELL_URGENT_NAME;
+          urgent->pending_length = 0;
+          carried = 0;
+        }
+        continue;
+      }
+      
+      if (urgent->state == SHELL_URGENT_LINE) {
+        if (cmd_is_eol(c)) {
+          // 紧急命令行连同行结束符都不写入命令缓冲区
+          shell_urgent_submit(instance);
+          urgent->state = SHELL_URGENT_NAME;
+          urgent->pending_length = 0;
+          carried = 0;
+          run = i + 1;
+        } else if (urgent->pending_length < SHELL_URGENT_LENGTH - 1) {
+          urgent->pending[urgent->pending_length++] = c;
+        }
+        continue;
+      }
+      
+      // 命令名之前的空白和命令名先暂存，遇到命令名后的空白或行结束符时判断
+      bool blank = c == ' ' || c == '\t';
+      bool named = urgent->pending_length > 0 &&
+                   urgent->pending[urgent->pending_length - 1] != ' ' &&
+                   urgent->pending[urgent->pending_length - 1] != '\t';
+      if (!cmd_is_eol(c) && !(blank && named) && urgent->pending_length < SHELL_URGENT_LENGTH - 1) {
+        urgent->pending[urgent->pending_length++] = c;
+        continue;
+      }
+      
+      if (cmd_is_eol(c) || blank) {
+        if (shell_urgent_match(urgent)) {
+          // 行开头之前的普通数据先写入，保持顺序
+          shell_buffer_input(instance, data + run, i - (urgent->pending_length - carried) - run, start);
+          if (cmd_is_eol(c)) {
+            shell_urgent_submit(instance);
+            urgent->pending_length = 0;
+          } else {
+            urgent->pending[urgent->pending_length++] = c;
+            urgent->state = SHELL_URGENT_LINE;
+          }
+          carried = 0;
+          run = i + 1;
+          continue;
+        }
+      }
+      
+      // 普通命令行：上次暂存的行开头补写入，本次收到的部分留在待写入的数据段中
+      if (carried > 0) {
+        shell_buffer_input(instance, (const uint8_t *)urgent->pending, carried, start);
+      }
+      carried = 0;
+      urgent->pending_length = 0;
+      urgent->state = cmd_is_eol(c) ? SHELL_URGENT_NAME : SHELL_URGENT_PASS;
+    }
+    
+    // 写入剩余的普通数据，未判断完的行开头留到下次
+    size_t end = length;
+    if (urgent->state == SHELL_URGENT_NAME) {
+      end -= urgent->pending_length - carried;
+    } else if (urgent->state == SHELL_URGENT_LINE) {
+      end = run;
+    }
+    if (end > run) {
+      shell_buffer_input(instance, data + run, end - run, start);
+    }
   } else {
     ESP_LOGW(TAG, "未找到通道 %lu 的shell实例", (unsigned long)channel_id);
   }
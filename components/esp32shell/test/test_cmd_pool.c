@@ -0,0 +1,45 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "shell.h"
+
+#define TEST_MACRO_LINES 500
+
+// 录制超过命令池初始容量的宏，池应按块追加而不是拒绝命令行
+TEST_CASE("command pool grows to record a 500 line macro", "[esp32shell]")
+{
+  cmd_pool_t *pool = cmd_pool_create();
+  TEST_ASSERT_NOT_NULL(pool);
+
+  macro_buffer_t macro;
+  macro_buffer_init(&macro, pool);
+  TEST_ASSERT_TRUE(macro_buffer_start_recording(&macro, "production"));
+
+  char line[MAX_CMD_LENGTH];
+  for (int i = 0; i < TEST_MACRO_LINES; i++) {
+    // 长短命令行混合，每8行一条超过128字节的长行
+    int length = snprintf(line, sizeof(line), "io set %d %d", i % 32, i & 1);
+    if (i % 8 == 0) {
+      memset(line + length, 'x', 160);
+      line[length + 160] = '\0';
+    }
+    TEST_ASSERT_TRUE(macro_buffer_add_command(&macro, line));
+  }
+  TEST_ASSERT_TRUE(macro_buffer_stop_recording(&macro));
+
+  TEST_ASSERT_NOT_NULL(macro.head);
+  TEST_ASSERT_EQUAL(TEST_MACRO_LINES, macro.head->queue.count);
+  TEST_ASSERT_EQUAL(TEST_MACRO_LINES, pool->items_used);
+  TEST_ASSERT_GREATER_OR_EQUAL(TEST_MACRO_LINES, pool->items_capacity);
+  TEST_ASSERT_GREATER_THAN(0, pool->slab_count);
+  TEST_ASSERT_EQUAL(0, pool->alloc_failures);
+
+  macro_buffer_clear(&macro);
+  TEST_ASSERT_EQUAL(0, pool->items_used);
+  TEST_ASSERT_EQUAL(0, pool->macros_used);
+
+  cmd_queue_deinit(&macro.temp_queue);
+  vSemaphoreDelete(macro.mutex);
+  vSemaphoreDelete(macro.execution_mutex);
+  cmd_pool_destroy(pool);
+}
@@ -208,7 +208,9 @@ void app_main(void) {
   // 注册自定义命令
   cmd_register_task("led", task_led_control, "控制LED (on/off/toggle/blink)");
   cmd_register_task("test", task_test_control, "开始自动化测试");
-  cmd_register_task("testoff", task_testoff_control, "停止自动化测试");
+  // 停止测试不排在其他命令之后，急停延迟与排队的命令数无关
+  cmd_register_urgent_task("testoff", task_testoff_control, "停止自动化测试");
+  cmd_register_task("teststat", task_teststat_control, "显示测试循环阶段耗时统计");
   // encoding命令已集成到Shell系统中
 
   // 创建UART1的Shell实例
@@ -10,12 +10,14 @@
 #include "i2cdev.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 static const char *TAG = "I2C_CONFIG";
 
 // ADS1115设备描述符
 static i2c_dev_t ads1115_dev = {0};
 static bool ads1115_initialized = false;
+static SemaphoreHandle_t ads1115_mutex = NULL;  // ADC访问互斥锁(多路复用器和模式为共享状态)
 
 esp_err_t i2c_master_init(void)
 {
@@ -45,6 +47,14 @@ esp_err_t ads1115_init(void)
         return ESP_OK;
     }
 
+    if (ads1115_mutex == NULL) {
+        ads1115_mutex = xSemaphoreCreateMutex();
+        if (ads1115_mutex == NULL) {
+            ESP_LOGE(TAG, "创建ADS1115互斥锁失败");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
     // 初始化ADS1115设备描述符
     esp_err_t ret = ads111x_init_desc(&ads1115_dev, ADS1115_I2C_ADDR, I2C_MASTER_NUM, 
                                       I2C_MASTER_SDA_IO, I2C_MASTER_SCL_IO);
@@ -111,6 +121,22 @@ void* ads1115_get_handle(void)
     return ads1115_initialized ? &ads1115_dev : NULL;
 }
 
+esp_err_t ads1115_lock(TickType_t timeout)
+{
+    if (!ads1115_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    return (xSemaphoreTake(ads1115_mutex, timeout) == pdTRUE) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void ads1115_unlock(void)
+{
+    if (ads1115_mutex != NULL) {
+        xSemaphoreGive(ads1115_mutex);
+    }
+}
+
 esp_err_t ads1115_read_voltage(uint8_t channel, float *voltage_v)
 {
     if (!ads1115_initialized) {
@@ -133,8 +159,15 @@ esp_err_t ads1115_read_voltage(uint8_t channel, float *voltage_v)
         default: return ESP_ERR_INVALID_ARG;
     }
     
+    // 高速捕获占用ADC时等待其释放
+    if (ads1115_lock(pdMS_TO_TICKS(I2C_MASTER_TIMEOUT_MS)) != ESP_OK) {
+        ESP_LOGW(TAG, "ADS1115被占用");
+        return ESP_ERR_TIMEOUT;
+    }
+    
     esp_err_t ret = ads111x_set_input_mux(&ads1115_dev, mux_config);
     if (ret != ESP_OK) {
+        ads1115_unlock();
         ESP_LOGE(TAG, "设置ADS1115通道%d失败: %s", channel, esp_err_to_name(ret));
         return ret;
     }
@@ -142,6 +175,7 @@ esp_err_t ads1115_read_voltage(uint8_t channel, float *voltage_v)
     // 启动转换
     ret = ads111x_start_conversion(&ads1115_dev);
     if (ret != ESP_OK) {
+        ads1115_unlock();
         ESP_LOGE(TAG, "启动ADS1115转换失败: %s", esp_err_to_name(ret));
         return ret;
     }
@@ -152,6 +186,7 @@ esp_err_t ads1115_read_voltage(uint8_t channel, float *voltage_v)
     // 读取原始值
     int16_t raw_value;
     ret = ads111x_get_value(&ads1115_dev, &raw_value);
+    ads1115_unlock();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "读取ADS1115值失败: %s", esp_err_to_name(ret));
         return ret;
@@ -228,6 +263,12 @@ esp_err_t ads1115_read_all_detailed(ads1115_channel_data_t channel_data[ADS1115_
         return ESP_ERR_INVALID_ARG;
     }
     
+    // 高速捕获占用ADC时等待其释放
+    if (ads1115_lock(pdMS_TO_TICKS(I2C_MASTER_TIMEOUT_MS)) != ESP_OK) {
+        ESP_LOGW(TAG, "ADS1115被占用");
+        return ESP_ERR_TIMEOUT;
+    }
+    
     for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT; ch++) {
         // 设置输入多路复用器
         ads111x_mux_t mux_config;
@@ -255,7 +296,7 @@ esp_err_t ads1115_read_all_detailed(ads1115_channel_data_t channel_data[ADS1115_
         }
         
         // 等待转换完成
-        vTaskDelay(pdMS_TO_TICKS(20));
+        vTaskDelay(pdMS_TO_TICKS(ADS1115_SCAN_CONVERSION_MS));
         
         // 读取原始值
         ret = ads111x_get_value(&ads1115_dev, &channel_data[ch].raw_value);
@@ -293,9 +334,10 @@ esp_err_t ads1115_read_all_detailed(ads1115_channel_data_t channel_data[ADS1115_
         }
         
         // 通道间延时
-        vTaskDelay(pdMS_TO_TICKS(50));
+        vTaskDelay(pdMS_TO_TICKS(ADS1115_SCAN_CHANNEL_GAP_MS));
     }
     
+    ads1115_unlock();
     return ESP_OK;
 }
 
@@ -346,3 +388,72 @@ esp_err_t ads1115_get_config_info(ads1115_config_info_t *config_info)
     
     return ESP_OK;
 }
+
+esp_err_t ads1115_continuous_start(uint8_t channel)
+{
+    if (!ads1115_initialized) {
+        ESP_LOGE(TAG, "ADS1115未初始化");
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    if (channel >= ADS1115_CHANNEL_COUNT) {
+        ESP_LOGE(TAG, "参数无效");
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    // 单端输入通道与多路复用器配置一一对应
+    esp_err_t ret = ads1115_continuous_select(channel);
+    if (ret == ESP_OK) {
+        ret = ads111x_set_data_rate(&ads1115_dev, ADS111X_DATA_RATE_860);
+    }
+    if (ret == ESP_OK) {
+        ret = ads111x_set_mode(&ads1115_dev, ADS111X_MODE_CONTINUOUS);
+    }
+    
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "ADS1115连续转换启动失败: %s", esp_err_to_name(ret));
+        ads1115_continuous_stop();
+    }
+    
+    return ret;
+}
+
+esp_err_t ads1115_continuous_select(uint8_t channel)
+{
+    if (channel >= ADS1115_CHANNEL_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    return ads111x_set_input_mux(&ads1115_dev, (ads111x_mux_t)(ADS111X_MUX_0_GND + channel));
+}
+
+esp_err_t ads1115_continuous_read(int16_t *raw_value)
+{
+    return ads111x_get_value(&ads1115_dev, raw_value);
+}
+
+esp_err_t ads1115_continuous_stop(void)
+{
+    if (!ads1115_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    // 恢复ads1115_init()中的单次转换配置
+    esp_err_t ret = ads111x_set_mode(&ads1115_dev, ADS111X_MODE_SINGLE_SHOT);
+    if (ret == ESP_OK) {
+        ret = ads111x_set_data_rate(&ads1115_dev, ADS111X_DATA_RATE_250);
+    }
+    
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "ADS1115恢复单次转换失败: %s", esp_err_to_name(ret));
+    }
+    
+    return ret;
+}
+
+float ads1115_raw_to_current_ma(int16_t raw_value)
+{
+    // 4.096V增益，单端模式满量程32768
+    float voltage_v = (float)raw_value * 4.096f / 32768.0f;
+    return (voltage_v / ADS1115_SHUNT_RESISTOR_OHMS) * 1000.0f;
+}
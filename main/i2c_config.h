@@ -11,6 +11,7 @@
 
 // #include "driver/i2c.h"  // 移除旧I2C驱动，使用i2cdev库
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,6 +46,10 @@ extern "C" {
 #define ADS1115_CHANNEL_COUNT       4               /*!< ADS1115通道数量 */
 #define ADS1115_MAX_VOLTAGE_V       4.096f          /*!< ADS1115最大测量电压(伏特) - ±4.096V增益 */
 #define ADS1115_MAX_CURRENT_MA      136.5f          /*!< 理论最大电流(毫安) - 4.096V/30Ω */
+#define ADS1115_CONTINUOUS_SPS      860             /*!< 连续转换模式采样率(SPS) */
+#define ADS1115_SCAN_CONVERSION_MS  20              /*!< 扫描时每个通道等待转换完成的时间(毫秒) */
+#define ADS1115_SCAN_CHANNEL_GAP_MS 50              /*!< 扫描时通道间延时(毫秒) */
+#define ADS1115_SCAN_MS             (ADS1115_CHANNEL_COUNT * (ADS1115_SCAN_CONVERSION_MS + ADS1115_SCAN_CHANNEL_GAP_MS)) /*!< ads1115_read_all_detailed扫描全部通道的标称耗时(毫秒) */
 
 /**
  * @brief 初始化I2C主机
@@ -85,6 +90,26 @@ esp_err_t ads1115_init(void);
  */
 void* ads1115_get_handle(void);
 
+/**
+ * @brief 获取ADS1115独占访问权
+ * 
+ * ADS1115的多路复用器、工作模式和采样率为共享状态。
+ * 单次读取函数内部自动加锁；使用连续转换函数的调用者需自行加锁，
+ * 持有期间其他读取会等待或超时。
+ * 
+ * @param timeout 最长等待时间(系统节拍)
+ * @return esp_err_t
+ *         - ESP_OK: 获取成功
+ *         - ESP_ERR_INVALID_STATE: ADS1115未初始化
+ *         - ESP_ERR_TIMEOUT: 等待超时
+ */
+esp_err_t ads1115_lock(TickType_t timeout);
+
+/**
+ * @brief 释放ADS1115独占访问权
+ */
+void ads1115_unlock(void);
+
 /**
  * @brief 读取指定通道的电流值
  * 
@@ -158,6 +183,64 @@ typedef struct {
 
 esp_err_t ads1115_get_config_info(ads1115_config_info_t *config_info);
 
+/**
+ * @brief 启动指定通道的连续转换
+ * 
+ * 切换到连续转换模式并使用最高采样率(860 SPS)，用于高速波形捕获。
+ * 调用前需通过ads1115_lock()获取访问权，
+ * 捕获结束后必须调用ads1115_continuous_stop()恢复单次转换配置。
+ * 
+ * @param channel 通道号 (0-3)
+ * @return esp_err_t
+ *         - ESP_OK: 启动成功
+ *         - ESP_ERR_INVALID_STATE: ADS1115未初始化
+ *         - ESP_ERR_INVALID_ARG: 参数无效
+ *         - ESP_FAIL: 配置失败
+ */
+esp_err_t ads1115_continuous_start(uint8_t channel);
+
+/**
+ * @brief 连续转换中切换通道
+ * 
+ * 切换后ADS1115重新开始转换，需等待一个转换周期才能读到新通道的结果
+ * 
+ * @param channel 通道号 (0-3)
+ * @return esp_err_t
+ *         - ESP_OK: 切换成功
+ *         - ESP_ERR_INVALID_ARG: 参数无效
+ *         - ESP_FAIL: 配置失败
+ */
+esp_err_t ads1115_continuous_select(uint8_t channel);
+
+/**
+ * @brief 读取连续转换的最新结果
+ * 
+ * 只读取转换寄存器，不等待转换完成，由调用者按采样率控制读取间隔
+ * 
+ * @param raw_value 输出的原始ADC值
+ * @return esp_err_t
+ *         - ESP_OK: 读取成功
+ *         - ESP_FAIL: 读取失败
+ */
+esp_err_t ads1115_continuous_read(int16_t *raw_value);
+
+/**
+ * @brief 停止连续转换，恢复单次转换模式和默认采样率
+ * 
+ * @return esp_err_t
+ *         - ESP_OK: 恢复成功
+ *         - ESP_FAIL: 配置失败
+ */
+esp_err_t ads1115_continuous_stop(void);
+
+/**
+ * @brief 将原始ADC值换算为电流
+ * 
+ * @param raw_value 原始ADC值
+ * @return 电流值(毫安)
+ */
+float ads1115_raw_to_current_ma(int16_t raw_value);
+
 #ifdef __cplusplus
 }
 #endif
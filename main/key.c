@@ -5,68 +5,172 @@
 
 #include "key.h"
 #include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include <string.h>
 
 static const char *TAG = "KEY_DRIVER";
 
+// 检测任务通知位
+#define KEY_NOTIFY_EDGE     (1 << 0)        // 中断记录了新边沿
+#define KEY_NOTIFY_SETTLED  (1 << 1)        // 防抖定时器到期
+#define KEY_NOTIFY_STOP     (1 << 2)        // 停止检测
+
+#define KEY_STOP_TIMEOUT_MS 100             // 等待检测任务退出的最长时间
+
+#define KEY_EDGE_QUEUE_MASK (KEY_EDGE_QUEUE_SIZE - 1)
+
+/* 中断记录的边沿 */
+typedef struct {
+    int64_t timestamp_us;                   // 边沿时间
+    int level;                              // 边沿后的电平
+} key_edge_t;
+
+/* 按键事件订阅者 */
+typedef struct {
+    key_event_callback_t callback;
+    void *arg;
+} key_subscriber_t;
+
 // 按键状态管理
 static key_state_t current_key_state = KEY_STATE_RELEASED;
-static key_state_t last_key_state = KEY_STATE_RELEASED;
-static key_event_callback_t event_callback = NULL;
+static key_subscriber_t subscribers[KEY_MAX_SUBSCRIBERS];
 static TaskHandle_t key_task_handle = NULL;
+static SemaphoreHandle_t key_task_exited = NULL;    // 检测任务退出时释放
 static bool detection_running = false;
 static SemaphoreHandle_t key_mutex = NULL;
+static esp_timer_handle_t debounce_timer = NULL;
+static key_stats_t key_stats;
+
+// 单生产者(中断)单消费者(检测任务)的无锁边沿队列
+static key_edge_t edge_queue[KEY_EDGE_QUEUE_SIZE];
+static uint32_t edge_head = 0;              // 只由中断写
+static uint32_t edge_tail = 0;              // 只由检测任务写
+
+/**
+ * @brief 按键GPIO双边沿中断
+ *
+ * 只记录边沿时间和电平，防抖和回调在检测任务中完成
+ */
+static void IRAM_ATTR key_gpio_isr(void *arg)
+{
+    uint32_t head = edge_head;
+    uint32_t tail = __atomic_load_n(&edge_tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail < KEY_EDGE_QUEUE_SIZE) {
+        edge_queue[head & KEY_EDGE_QUEUE_MASK].timestamp_us = esp_timer_get_time();
+        edge_queue[head & KEY_EDGE_QUEUE_MASK].level = gpio_get_level(KEY_GPIO);
+        __atomic_store_n(&edge_head, head + 1, __ATOMIC_RELEASE);
+    } else {
+        key_stats.edge_dropped++;
+    }
+
+    BaseType_t woken = pdFALSE;
+    if (key_task_handle != NULL) {
+        xTaskNotifyFromISR(key_task_handle, KEY_NOTIFY_EDGE, eSetBits, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+/**
+ * @brief 防抖定时器回调(esp_timer任务)
+ */
+static void key_debounce_timer_callback(void *arg)
+{
+    if (key_task_handle != NULL) {
+        xTaskNotify(key_task_handle, KEY_NOTIFY_SETTLED, eSetBits);
+    }
+}
+
+/**
+ * @brief 通知所有订阅者
+ *
+ * 复制订阅表后在锁外调用，回调中可以订阅/取消订阅
+ */
+static void key_dispatch(key_event_t event, int64_t timestamp_us)
+{
+    key_subscriber_t snapshot[KEY_MAX_SUBSCRIBERS];
+
+    if (xSemaphoreTake(key_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+        return;
+    }
+    memcpy(snapshot, subscribers, sizeof(snapshot));
+    xSemaphoreGive(key_mutex);
+
+    for (uint8_t i = 0; i < KEY_MAX_SUBSCRIBERS; i++) {
+        if (snapshot[i].callback != NULL) {
+            snapshot[i].callback(event, timestamp_us, snapshot[i].arg);
+        }
+    }
+}
 
 /**
  * @brief 按键检测任务
+ *
+ * 无边沿时阻塞。一串抖动的第一个边沿记为事件时间，
+ * 最后一个边沿之后KEY_DEBOUNCE_MS无变化再读取电平确认状态
  */
 static void key_detection_task(void *arg)
 {
     ESP_LOGI(TAG, "按键检测任务启动");
-    
-    uint32_t stable_count = 0;
-    const uint32_t debounce_count = KEY_DEBOUNCE_MS / 10; // 10ms检测间隔
-    
+
+    bool pending = false;
+    int64_t first_edge_us = 0;
+
     while (detection_running) {
-        // 读取GPIO电平
-        int gpio_level = gpio_get_level(KEY_GPIO);
-        key_state_t new_state = (gpio_level == KEY_PRESSED_LEVEL) ? KEY_STATE_PRESSED : KEY_STATE_RELEASED;
-        
-        if (xSemaphoreTake(key_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-            if (new_state == current_key_state) {
-                stable_count++;
-            } else {
-                stable_count = 0;
-                current_key_state = new_state;
-            }
-            
-            // 防抖处理：状态稳定足够长时间才认为是有效变化
-            if (stable_count >= debounce_count && current_key_state != last_key_state) {
-                uint32_t timestamp_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
-                
-                // 触发回调
-                if (event_callback != NULL) {
-                    key_event_t event = (current_key_state == KEY_STATE_PRESSED) ? 
-                                       KEY_EVENT_PRESSED : KEY_EVENT_RELEASED;
-                    event_callback(event, timestamp_ms);
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY);
+
+        if (bits & KEY_NOTIFY_STOP) {
+            break;
+        }
+
+        if (bits & KEY_NOTIFY_EDGE) {
+            uint32_t head = __atomic_load_n(&edge_head, __ATOMIC_ACQUIRE);
+            uint32_t tail = edge_tail;
+            bool received = tail != head;
+
+            for (; tail != head; tail++) {
+                if (!pending) {
+                    pending = true;
+                    first_edge_us = edge_queue[tail & KEY_EDGE_QUEUE_MASK].timestamp_us;
                 }
-                
-                last_key_state = current_key_state;
-                ESP_LOGI(TAG, "按键状态变化: %s (时间戳: %lu)", 
-                         current_key_state == KEY_STATE_PRESSED ? "按下" : "松开", 
-                         timestamp_ms);
+                key_stats.edge_count++;
             }
-            
-            xSemaphoreGive(key_mutex);
+            __atomic_store_n(&edge_tail, tail, __ATOMIC_RELEASE);
+
+            // 每次新边沿重新开始防抖计时
+            if (received) {
+                esp_timer_stop(debounce_timer);
+                esp_timer_start_once(debounce_timer, KEY_DEBOUNCE_MS * 1000);
+            }
+        }
+
+        if ((bits & KEY_NOTIFY_SETTLED) && pending) {
+            pending = false;
+            key_state_t new_state = (gpio_get_level(KEY_GPIO) == KEY_PRESSED_LEVEL) ?
+                                    KEY_STATE_PRESSED : KEY_STATE_RELEASED;
+
+            if (new_state == current_key_state) {
+                key_stats.bounce_count++;
+                continue;
+            }
+
+            current_key_state = new_state;
+            key_stats.event_count++;
+            key_dispatch(new_state == KEY_STATE_PRESSED ? KEY_EVENT_PRESSED : KEY_EVENT_RELEASED, first_edge_us);
+
+            ESP_LOGI(TAG, "按键状态变化: %s (时间戳: %lld us)",
+                     new_state == KEY_STATE_PRESSED ? "按下" : "松开", first_edge_us);
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(10)); // 10ms检测间隔
     }
-    
+
     ESP_LOGI(TAG, "按键检测任务结束");
     key_task_handle = NULL;
+    xSemaphoreGive(key_task_exited);
     vTaskDelete(NULL);
 }
 
@@ -78,16 +182,16 @@ esp_err_t key_init(void)
         ESP_LOGE(TAG, "创建按键互斥锁失败");
         return ESP_FAIL;
     }
-    
-    // 配置GPIO
+
+    // 配置GPIO，中断处理函数在启动检测时添加
     gpio_config_t io_conf = {
         .pin_bit_mask = (1ULL << KEY_GPIO),
         .mode = GPIO_MODE_INPUT,
         .pull_up_en = GPIO_PULLUP_ENABLE,   // 启用上拉，确保松开时为高电平
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE
+        .intr_type = GPIO_INTR_ANYEDGE
     };
-    
+
     esp_err_t ret = gpio_config(&io_conf);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "配置按键GPIO%d失败: %s", KEY_GPIO, esp_err_to_name(ret));
@@ -95,13 +199,36 @@ esp_err_t key_init(void)
         key_mutex = NULL;
         return ret;
     }
-    
+
+    // 防抖定时器
+    const esp_timer_create_args_t timer_args = {
+        .callback = key_debounce_timer_callback,
+        .name = "key_debounce",
+    };
+    ret = esp_timer_create(&timer_args, &debounce_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "创建防抖定时器失败: %s", esp_err_to_name(ret));
+        vSemaphoreDelete(key_mutex);
+        key_mutex = NULL;
+        return ret;
+    }
+
+    // GPIO中断服务可能已由其他模块安装
+    ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "安装GPIO中断服务失败: %s", esp_err_to_name(ret));
+        esp_timer_delete(debounce_timer);
+        debounce_timer = NULL;
+        vSemaphoreDelete(key_mutex);
+        key_mutex = NULL;
+        return ret;
+    }
+
     // 初始化状态
     int initial_level = gpio_get_level(KEY_GPIO);
     current_key_state = (initial_level == KEY_PRESSED_LEVEL) ? KEY_STATE_PRESSED : KEY_STATE_RELEASED;
-    last_key_state = current_key_state;
-    
-    ESP_LOGI(TAG, "按键驱动初始化成功 (GPIO%d, 初始状态: %s)", 
+
+    ESP_LOGI(TAG, "按键驱动初始化成功 (GPIO%d, 初始状态: %s)",
              KEY_GPIO, current_key_state == KEY_STATE_PRESSED ? "按下" : "松开");
     return ESP_OK;
 }
@@ -110,16 +237,25 @@ esp_err_t key_deinit(void)
 {
     // 停止检测
     key_stop_detection();
-    
+
+    if (debounce_timer != NULL) {
+        esp_timer_delete(debounce_timer);
+        debounce_timer = NULL;
+    }
+
     // 删除互斥锁
     if (key_mutex != NULL) {
         vSemaphoreDelete(key_mutex);
         key_mutex = NULL;
     }
-    
+    if (key_task_exited != NULL) {
+        vSemaphoreDelete(key_task_exited);
+        key_task_exited = NULL;
+    }
+
     // 重置GPIO
     gpio_reset_pin(KEY_GPIO);
-    
+
     ESP_LOGI(TAG, "按键驱动反初始化完成");
     return ESP_OK;
 }
@@ -129,26 +265,80 @@ esp_err_t key_get_state(key_state_t *state)
     if (state == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
-    
-    if (xSemaphoreTake(key_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
+
+    // 检测运行时返回防抖后的状态，否则直接读取电平
+    if (detection_running) {
         *state = current_key_state;
-        xSemaphoreGive(key_mutex);
-        return ESP_OK;
+    } else {
+        *state = (gpio_get_level(KEY_GPIO) == KEY_PRESSED_LEVEL) ? KEY_STATE_PRESSED : KEY_STATE_RELEASED;
     }
-    
-    return ESP_ERR_TIMEOUT;
+    return ESP_OK;
 }
 
-esp_err_t key_set_event_callback(key_event_callback_t callback)
+esp_err_t key_subscribe(key_event_callback_t callback, void *arg)
 {
-    if (xSemaphoreTake(key_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-        event_callback = callback;
-        xSemaphoreGive(key_mutex);
-        ESP_LOGI(TAG, "按键事件回调已%s", callback ? "设置" : "清除");
-        return ESP_OK;
+    if (callback == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (xSemaphoreTake(key_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    int free_slot = -1;
+    for (int i = 0; i < KEY_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].callback == callback && subscribers[i].arg == arg) {
+            xSemaphoreGive(key_mutex);
+            return ESP_OK;
+        }
+        if (subscribers[i].callback == NULL && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+
+    if (free_slot >= 0) {
+        subscribers[free_slot].callback = callback;
+        subscribers[free_slot].arg = arg;
+    }
+    xSemaphoreGive(key_mutex);
+
+    if (free_slot < 0) {
+        ESP_LOGW(TAG, "按键事件订阅者已满");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "按键事件订阅者已添加");
+    return ESP_OK;
+}
+
+esp_err_t key_unsubscribe(key_event_callback_t callback, void *arg)
+{
+    if (xSemaphoreTake(key_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    for (int i = 0; i < KEY_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].callback == callback && subscribers[i].arg == arg) {
+            subscribers[i].callback = NULL;
+            subscribers[i].arg = NULL;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    xSemaphoreGive(key_mutex);
+
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "按键事件订阅者已移除");
+    }
+    return ret;
+}
+
+void key_get_stats(key_stats_t *stats)
+{
+    if (stats != NULL) {
+        *stats = key_stats;
     }
-    
-    return ESP_ERR_TIMEOUT;
 }
 
 esp_err_t key_start_detection(void)
@@ -157,21 +347,41 @@ esp_err_t key_start_detection(void)
         ESP_LOGW(TAG, "按键检测已在运行");
         return ESP_OK;
     }
-    
+
     if (key_mutex == NULL) {
         ESP_LOGE(TAG, "按键驱动未初始化");
         return ESP_ERR_INVALID_STATE;
     }
-    
+
+    // 停止检测时等待任务退出的信号
+    if (key_task_exited == NULL) {
+        key_task_exited = xSemaphoreCreateBinary();
+        if (key_task_exited == NULL) {
+            ESP_LOGE(TAG, "创建按键信号量失败");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    xSemaphoreTake(key_task_exited, 0);
+
+    // 以当前电平为起始状态，清空残留边沿
+    current_key_state = (gpio_get_level(KEY_GPIO) == KEY_PRESSED_LEVEL) ? KEY_STATE_PRESSED : KEY_STATE_RELEASED;
+    edge_tail = edge_head;
     detection_running = true;
-    
+
     BaseType_t ret = xTaskCreate(key_detection_task, "key_detect", 4096, NULL, 6, &key_task_handle);
     if (ret != pdPASS) {
         detection_running = false;
         ESP_LOGE(TAG, "创建按键检测任务失败");
         return ESP_FAIL;
     }
-    
+
+    esp_err_t err = gpio_isr_handler_add(KEY_GPIO, key_gpio_isr, NULL);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "添加按键中断失败: %s", esp_err_to_name(err));
+        key_stop_detection();
+        return err;
+    }
+
     ESP_LOGI(TAG, "按键检测启动");
     return ESP_OK;
 }
@@ -182,14 +392,20 @@ esp_err_t key_stop_detection(void)
         ESP_LOGW(TAG, "按键检测未在运行");
         return ESP_OK;
     }
-    
+
+    gpio_isr_handler_remove(KEY_GPIO);
+    esp_timer_stop(debounce_timer);
     detection_running = false;
-    
-    // 等待任务结束
+
+    // 唤醒检测任务并等待其退出，任务退出即返回
     if (key_task_handle != NULL) {
-        vTaskDelay(pdMS_TO_TICKS(50)); // 等待任务自然结束
+        xTaskNotify(key_task_handle, KEY_NOTIFY_STOP, eSetBits);
+        if (xSemaphoreTake(key_task_exited, pdMS_TO_TICKS(KEY_STOP_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGW(TAG, "等待按键检测任务退出超时");
+            return ESP_ERR_TIMEOUT;
+        }
     }
-    
+
     ESP_LOGI(TAG, "按键检测停止");
     return ESP_OK;
 }
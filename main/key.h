@@ -5,7 +5,8 @@
  * 实现GPIO35按键检测功能：
  * - 按下：低电平
  * - 松开：高电平
- * - 状态变化检测和回调
+ * - 双边沿中断记录边沿时间(微秒)，单次定时器防抖
+ * - 状态变化通知多个订阅者
  */
 
 #ifndef KEY_H
@@ -25,6 +26,8 @@ extern "C" {
 #define KEY_PRESSED_LEVEL   0               /*!< 按键按下时的电平 */
 #define KEY_RELEASED_LEVEL  1               /*!< 按键松开时的电平 */
 #define KEY_DEBOUNCE_MS     50              /*!< 按键防抖时间(毫秒) */
+#define KEY_EDGE_QUEUE_SIZE 32              /*!< 中断边沿队列长度(2的幂) */
+#define KEY_MAX_SUBSCRIBERS 4               /*!< 最大订阅者数量 */
 
 /* 按键状态枚举 */
 typedef enum {
@@ -41,10 +44,21 @@ typedef enum {
 /**
  * @brief 按键事件回调函数类型
  * 
+ * 在按键检测任务中调用，时间戳为防抖前第一个边沿的esp_timer_get_time()
+ * 
  * @param event 按键事件类型
- * @param timestamp_ms 事件发生的时间戳(毫秒)
+ * @param timestamp_us 事件发生的时间戳(微秒)
+ * @param arg 订阅时传入的参数
  */
-typedef void (*key_event_callback_t)(key_event_t event, uint32_t timestamp_ms);
+typedef void (*key_event_callback_t)(key_event_t event, int64_t timestamp_us, void *arg);
+
+/* 按键检测统计 */
+typedef struct {
+    uint32_t edge_count;                    /*!< 中断记录的边沿数 */
+    uint32_t edge_dropped;                  /*!< 队列满丢弃的边沿数 */
+    uint32_t event_count;                   /*!< 防抖后的有效事件数 */
+    uint32_t bounce_count;                  /*!< 防抖后状态未变化的抖动次数 */
+} key_stats_t;
 
 /**
  * @brief 初始化按键驱动
@@ -75,19 +89,45 @@ esp_err_t key_deinit(void);
 esp_err_t key_get_state(key_state_t *state);
 
 /**
- * @brief 设置按键事件回调函数
+ * @brief 订阅按键事件
+ * 
+ * @param callback 回调函数
+ * @param arg 回调参数
+ * @return esp_err_t
+ *         - ESP_OK: 订阅成功(已订阅时也返回成功)
+ *         - ESP_ERR_INVALID_ARG: 回调为空
+ *         - ESP_ERR_NO_MEM: 订阅者已满
+ *         - ESP_ERR_TIMEOUT: 获取互斥锁超时
+ */
+esp_err_t key_subscribe(key_event_callback_t callback, void *arg);
+
+/**
+ * @brief 取消订阅按键事件
  * 
- * @param callback 回调函数指针，设为NULL则取消回调
+ * @param callback 回调函数
+ * @param arg 订阅时传入的参数
  * @return esp_err_t
- *         - ESP_OK: 设置成功
+ *         - ESP_OK: 取消成功
+ *         - ESP_ERR_NOT_FOUND: 未订阅
+ *         - ESP_ERR_TIMEOUT: 获取互斥锁超时
  */
-esp_err_t key_set_event_callback(key_event_callback_t callback);
+esp_err_t key_unsubscribe(key_event_callback_t callback, void *arg);
+
+/**
+ * @brief 获取按键检测统计
+ * 
+ * @param stats 输出的统计
+ */
+void key_get_stats(key_stats_t *stats);
 
 /**
  * @brief 启动按键检测任务
  * 
+ * 安装GPIO中断并创建检测任务，检测任务只在有边沿时运行
+ * 
  * @return esp_err_t
  *         - ESP_OK: 启动成功
+ *         - ESP_ERR_NO_MEM: 信号量创建失败
  *         - ESP_FAIL: 启动失败
  */
 esp_err_t key_start_detection(void);
@@ -95,8 +135,11 @@ esp_err_t key_start_detection(void);
 /**
  * @brief 停止按键检测任务
  * 
+ * 通知检测任务退出并等待其结束，任务退出后立即返回
+ * 
  * @return esp_err_t
  *         - ESP_OK: 停止成功
+ *         - ESP_ERR_TIMEOUT: 等待任务退出超时
  */
 esp_err_t key_stop_detection(void);
 
@@ -14,6 +14,25 @@
 
 static const char *TAG = "LED_CMD";
 
+/**
+ * @brief 逐次闪烁LED，每次之间检查后台作业是否被终止
+ *
+ * @return ESP_ERR_INVALID_STATE: 作业被kill终止
+ */
+static esp_err_t led_command_blink(led_num_t led_num, uint8_t times, uint32_t interval_ms)
+{
+    for (uint8_t i = 0; i < times; i++) {
+        esp_err_t ret = led_blink(led_num, 1, interval_ms);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (i < times - 1 && !shell_job_delay(interval_ms)) {  // 最后一次不延时
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    return ESP_OK;
+}
+
 void task_led_control(uint32_t channel_id, const char *params)
 {
     char response[1024];  // 增加缓冲区大小
@@ -167,18 +186,22 @@ void task_led_control(uint32_t channel_id, const char *params)
         if (is_all) {
             shell_snprintf(response, sizeof(response), "所有LED闪烁%d次，间隔%lums...\r\n", times, interval_ms);
             cmd_output(channel_id, (uint8_t *)response, strlen(response));
-            ret = led_blink(LED_ALL, times, interval_ms);
+            ret = led_command_blink(LED_ALL, times, interval_ms);
             if (ret == ESP_OK) {
                 shell_snprintf(response, sizeof(response), "所有LED闪烁完成\r\n");
+            } else if (ret == ESP_ERR_INVALID_STATE) {
+                shell_snprintf(response, sizeof(response), "LED闪烁已终止\r\n");
             } else {
                 shell_snprintf(response, sizeof(response), "错误: LED闪烁失败\r\n");
             }
         } else {
             shell_snprintf(response, sizeof(response), "LED%d闪烁%d次，间隔%lums...\r\n", led_num, times, interval_ms);
             cmd_output(channel_id, (uint8_t *)response, strlen(response));
-            ret = led_blink(led_num, times, interval_ms);
+            ret = led_command_blink(led_num, times, interval_ms);
             if (ret == ESP_OK) {
                 shell_snprintf(response, sizeof(response), "LED%d闪烁完成\r\n", led_num);
+            } else if (ret == ESP_ERR_INVALID_STATE) {
+                shell_snprintf(response, sizeof(response), "LED%d闪烁已终止\r\n", led_num);
             } else {
                 shell_snprintf(response, sizeof(response), "错误: LED%d闪烁失败\r\n", led_num);
             }
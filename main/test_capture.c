@@ -0,0 +1,244 @@
+/**
+ * @file test_capture.c
+ * @brief IO切换后的稳定过程捕获模块实现
+ */
+
+#include "test_capture.h"
+#include "test_scheduler.h"
+#include "i2c_config.h"
+#include "sd.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static const char *TAG = "TEST_CAPTURE";
+
+// 860 SPS对应的采样间隔(向上取整，避免重复读取同一次转换)
+#define TEST_CAPTURE_INTERVAL_US  ((1000000 + ADS1115_CONTINUOUS_SPS - 1) / ADS1115_CONTINUOUS_SPS)
+
+// 终值取最后1/8的样本平均
+#define TEST_CAPTURE_FINAL_DIVISOR 8
+
+static test_capture_config_t capture_config;
+static test_capture_stats_t capture_stats;
+static int16_t *capture_samples = NULL;
+static uint16_t capture_max_samples = 0;
+
+esp_err_t test_capture_begin(const test_capture_config_t *config)
+{
+    if (config == NULL || config->channel >= ADS1115_CHANNEL_COUNT ||
+        config->window_ms < TEST_CAPTURE_MIN_WINDOW_MS || config->window_ms > TEST_CAPTURE_MAX_WINDOW_MS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint16_t max_samples = config->window_ms * ADS1115_CONTINUOUS_SPS / 1000;
+    if (capture_samples == NULL || capture_max_samples != max_samples) {
+        int16_t *samples = realloc(capture_samples, max_samples * sizeof(int16_t));
+        if (samples == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        capture_samples = samples;
+        capture_max_samples = max_samples;
+    }
+
+    capture_config = *config;
+    memset(&capture_stats, 0, sizeof(capture_stats));
+
+    // 摘要文件不存在时写入表头
+    struct stat st;
+    if (sd_card_is_mounted() && stat(TEST_CAPTURE_SUMMARY_PATH, &st) != 0) {
+        FILE *file = fopen(TEST_CAPTURE_SUMMARY_PATH, "w");
+        if (file != NULL) {
+            fprintf(file, "时间戳(us),循环计数,步骤号,IO输出字,通道,样本数,采样间隔(us),峰值电流(mA),终值电流(mA),稳定时间(us),是否稳定\n");
+            fclose(file);
+        }
+    }
+
+    ESP_LOGI(TAG, "捕获已准备: 通道%d, 窗口%lums, %d个样本", config->channel, config->window_ms, max_samples);
+    return ESP_OK;
+}
+
+/**
+ * @brief 由波形计算峰值、终值和稳定时间
+ *
+ * 稳定时间为最后一个超出终值偏差带的样本之后的时刻
+ */
+static void test_capture_analyze(uint16_t count, uint32_t period_us, test_capture_result_t *result)
+{
+    uint16_t tail = count / TEST_CAPTURE_FINAL_DIVISOR;
+    if (tail == 0) {
+        tail = 1;
+    }
+
+    int32_t tail_sum = 0;
+    int16_t peak_raw = capture_samples[0];
+    for (uint16_t i = 0; i < count; i++) {
+        if (capture_samples[i] > peak_raw) {
+            peak_raw = capture_samples[i];
+        }
+        if (i >= count - tail) {
+            tail_sum += capture_samples[i];
+        }
+    }
+
+    // 原始值到电流为线性换算
+    float lsb_ma = ads1115_raw_to_current_ma(1);
+    float final_ma = (float)tail_sum / tail * lsb_ma;
+    float band_ma = fabsf(final_ma) * TEST_CAPTURE_SETTLE_BAND_PCT / 100.0f;
+    if (band_ma < TEST_CAPTURE_SETTLE_BAND_MIN_MA) {
+        band_ma = TEST_CAPTURE_SETTLE_BAND_MIN_MA;
+    }
+
+    // 从后往前找最后一个超出偏差带的样本
+    int32_t last_outside = -1;
+    for (int32_t i = count - 1; i >= 0; i--) {
+        if (fabsf(ads1115_raw_to_current_ma(capture_samples[i]) - final_ma) > band_ma) {
+            last_outside = i;
+            break;
+        }
+    }
+
+    result->sample_count = count;
+    result->sample_period_us = period_us;
+    result->peak_ma = ads1115_raw_to_current_ma(peak_raw);
+    result->final_ma = final_ma;
+    result->settle_us = (uint32_t)(last_outside + 1) * period_us;
+    result->settled = last_outside < (int32_t)(count - tail);
+}
+
+/**
+ * @brief 将波形和摘要写入SD卡
+ */
+static void test_capture_save(uint32_t cycle, uint16_t step, uint16_t output, int64_t start_us,
+                              const test_capture_result_t *result)
+{
+    if (!sd_card_is_mounted()) {
+        return;
+    }
+
+    FILE *file = fopen(TEST_CAPTURE_FILE_PATH, "ab");
+    if (file != NULL) {
+        test_capture_header_t header = {
+            .magic = TEST_CAPTURE_MAGIC,
+            .version = TEST_CAPTURE_VERSION,
+            .header_size = sizeof(test_capture_header_t),
+            .cycle = cycle,
+            .step = step,
+            .output = output,
+            .channel = capture_config.channel,
+            .sample_count = result->sample_count,
+            .sample_period_us = result->sample_period_us,
+            .timestamp_us = start_us,
+            .lsb_ma = ads1115_raw_to_current_ma(1),
+            .peak_ma = result->peak_ma,
+            .final_ma = result->final_ma,
+            .settle_us = result->settle_us,
+            .trigger_index = 0,
+            .trigger_source = TEST_CAPTURE_SOURCE_IO_STEP,
+        };
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(capture_samples, sizeof(int16_t), result->sample_count, file);
+        fclose(file);
+    }
+
+    file = fopen(TEST_CAPTURE_SUMMARY_PATH, "a");
+    if (file != NULL) {
+        fprintf(file, "%lld,%lu,%d,0x%04X,%d,%d,%lu,%.3f,%.3f,%lu,%s\n",
+                start_us, cycle, step, output, capture_config.channel,
+                result->sample_count, result->sample_period_us, result->peak_ma,
+                result->final_ma, result->settle_us, result->settled ? "是" : "否");
+        fclose(file);
+    }
+}
+
+esp_err_t test_capture_run(uint32_t cycle, uint16_t step, uint16_t output, test_capture_result_t *result)
+{
+    if (capture_samples == NULL || ads1115_get_handle() == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // 触发捕获正在占用ADC时放弃本次捕获
+    esp_err_t ret = ads1115_lock(0);
+    if (ret != ESP_OK) {
+        capture_stats.error_count++;
+        return ret;
+    }
+    
+    int64_t start_us = esp_timer_get_time();
+    ret = ads1115_continuous_start(capture_config.channel);
+    if (ret != ESP_OK) {
+        ads1115_unlock();
+        capture_stats.error_count++;
+        return ret;
+    }
+
+    // 采样间隔小于系统节拍，由esp_timer周期通知调用任务，等待期间让出CPU；
+    // 第一个节拍时第一次连续转换已完成，切换配置前的转换结果不会被读到
+    test_scheduler_t sampler = {0};
+    int64_t loop_start_us = esp_timer_get_time();
+    ret = test_scheduler_start_us(&sampler, xTaskGetCurrentTaskHandle(), TEST_CAPTURE_INTERVAL_US);
+    uint16_t count = 0;
+
+    while (ret == ESP_OK && count < capture_max_samples) {
+        test_scheduler_tick_t tick;
+        ret = test_scheduler_wait(&sampler, &tick, pdMS_TO_TICKS(100));
+        if (ret != ESP_OK) {
+            break;
+        }
+
+        ret = ads1115_continuous_read(&capture_samples[count]);
+        if (ret != ESP_OK) {
+            break;
+        }
+        count++;
+    }
+    int64_t end_us = esp_timer_get_time();
+    test_scheduler_stop(&sampler);
+
+    ads1115_continuous_stop();
+    ads1115_unlock();
+
+    if (ret != ESP_OK || count == 0) {
+        ESP_LOGW(TAG, "捕获失败: %s (已采样%d)", esp_err_to_name(ret), count);
+        capture_stats.error_count++;
+        return ret != ESP_OK ? ret : ESP_FAIL;
+    }
+
+    // I2C读取变慢时实际间隔会大于标称值，按实测平均间隔计算时间
+    uint32_t period_us = (uint32_t)((end_us - loop_start_us) / count);
+    if (period_us < TEST_CAPTURE_INTERVAL_US) {
+        period_us = TEST_CAPTURE_INTERVAL_US;
+    }
+
+    test_capture_analyze(count, period_us, result);
+    test_capture_save(cycle, step, output, start_us, result);
+
+    capture_stats.capture_count++;
+    if (!result->settled) {
+        capture_stats.unsettled_count++;
+    }
+    if (result->settle_us > capture_stats.max_settle_us) {
+        capture_stats.max_settle_us = result->settle_us;
+    }
+    if (capture_stats.capture_count == 1 || result->peak_ma > capture_stats.max_peak_ma) {
+        capture_stats.max_peak_ma = result->peak_ma;
+    }
+
+    return ESP_OK;
+}
+
+void test_capture_end(void)
+{
+    free(capture_samples);
+    capture_samples = NULL;
+    capture_max_samples = 0;
+}
+
+const test_capture_stats_t *test_capture_get_stats(void)
+{
+    return &capture_stats;
+}
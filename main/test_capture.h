@@ -0,0 +1,139 @@
+/**
+ * @file test_capture.h
+ * @brief IO切换后的稳定过程捕获模块头文件
+ *
+ * 每次TCA9535输出切换后，以ADS1115最高采样率(860 SPS，连续转换模式)
+ * 对指定通道采样一段时间窗口，计算峰值电流和稳定时间，
+ * 波形以二进制格式追加到SD卡，摘要写入CSV文件。
+ *
+ * 波形文件由若干条记录组成，每条记录为一个test_capture_header_t
+ * 加上sample_count个int16_t原始ADC值(小端)。触发捕获(test_trigger)
+ * 使用相同的记录格式，trigger_source/trigger_index标明触发源和触发点。
+ */
+
+#ifndef TEST_CAPTURE_H
+#define TEST_CAPTURE_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 捕获配置常量 */
+#define TEST_CAPTURE_FILE_PATH        "/sdcard/capture.bin"   /*!< 波形文件 */
+#define TEST_CAPTURE_SUMMARY_PATH     "/sdcard/settle.csv"    /*!< 稳定时间摘要文件 */
+#define TEST_CAPTURE_MAGIC            0x50414353              /*!< 记录标识 "SCAP" */
+#define TEST_CAPTURE_VERSION          2                       /*!< 记录格式版本(2: 增加触发字段) */
+#define TEST_CAPTURE_DEFAULT_WINDOW_MS 100                    /*!< 默认捕获窗口(毫秒) */
+#define TEST_CAPTURE_MIN_WINDOW_MS    5                       /*!< 最小捕获窗口(毫秒) */
+#define TEST_CAPTURE_MAX_WINDOW_MS    1000                    /*!< 最大捕获窗口(毫秒) */
+#define TEST_CAPTURE_SETTLE_BAND_PCT  2.0f                    /*!< 稳定判据：与终值偏差百分比 */
+#define TEST_CAPTURE_SETTLE_BAND_MIN_MA 0.2f                  /*!< 稳定判据：最小偏差带(毫安) */
+
+/* 捕获触发源 */
+typedef enum {
+    TEST_CAPTURE_SOURCE_IO_STEP = 0,                     /*!< TCA9535输出切换 */
+    TEST_CAPTURE_SOURCE_LEVEL,                           /*!< 电流越过阈值 */
+    TEST_CAPTURE_SOURCE_SLOPE,                           /*!< 电流变化率超过阈值 */
+    TEST_CAPTURE_SOURCE_KEY,                             /*!< 按键事件 */
+    TEST_CAPTURE_SOURCE_MANUAL,                          /*!< 手动触发 */
+} test_capture_source_t;
+
+/* 波形记录头(与样本一起写入文件) */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;                                      /*!< 记录标识 */
+    uint16_t version;                                    /*!< 格式版本 */
+    uint16_t header_size;                                /*!< 记录头长度 */
+    uint32_t cycle;                                      /*!< 测试循环计数 */
+    uint16_t step;                                       /*!< 步骤号(从1开始) */
+    uint16_t output;                                     /*!< 切换后的TCA9535输出字 */
+    uint8_t channel;                                     /*!< 捕获通道 */
+    uint8_t reserved;                                    /*!< 保留 */
+    uint16_t sample_count;                               /*!< 样本数 */
+    uint32_t sample_period_us;                           /*!< 实际平均采样间隔(微秒) */
+    int64_t timestamp_us;                                /*!< 捕获开始时间(微秒) */
+    float lsb_ma;                                        /*!< 每LSB对应电流(毫安) */
+    float peak_ma;                                       /*!< 峰值电流(毫安) */
+    float final_ma;                                      /*!< 终值电流(毫安) */
+    uint32_t settle_us;                                  /*!< 稳定时间(微秒) */
+    uint16_t trigger_index;                              /*!< 触发点对应的样本索引 */
+    uint8_t trigger_source;                              /*!< 触发源(test_capture_source_t) */
+    uint8_t reserved2;                                   /*!< 保留 */
+} test_capture_header_t;
+
+/* 捕获配置 */
+typedef struct {
+    bool enabled;                                        /*!< 是否启用捕获 */
+    uint8_t channel;                                     /*!< 捕获通道 */
+    uint32_t window_ms;                                  /*!< 捕获窗口(毫秒) */
+} test_capture_config_t;
+
+/* 单次捕获结果 */
+typedef struct {
+    uint16_t sample_count;                               /*!< 样本数 */
+    uint32_t sample_period_us;                           /*!< 实际平均采样间隔(微秒) */
+    float peak_ma;                                       /*!< 峰值电流(毫安) */
+    float final_ma;                                      /*!< 终值电流(毫安) */
+    uint32_t settle_us;                                  /*!< 稳定时间(微秒) */
+    bool settled;                                        /*!< 窗口内是否稳定 */
+} test_capture_result_t;
+
+/* 捕获统计 */
+typedef struct {
+    uint32_t capture_count;                              /*!< 捕获次数 */
+    uint32_t error_count;                                /*!< 失败次数 */
+    uint32_t unsettled_count;                            /*!< 窗口内未稳定次数 */
+    uint32_t max_settle_us;                              /*!< 最大稳定时间(微秒) */
+    float max_peak_ma;                                   /*!< 最大峰值电流(毫安) */
+} test_capture_stats_t;
+
+/**
+ * @brief 准备捕获
+ *
+ * 按窗口大小分配样本缓冲区并清空统计
+ *
+ * @param config 捕获配置
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 配置无效
+ *         - ESP_ERR_NO_MEM: 内存不足
+ */
+esp_err_t test_capture_begin(const test_capture_config_t *config);
+
+/**
+ * @brief 执行一次捕获
+ *
+ * 在IO切换后立即调用，阻塞一个捕获窗口的时间。
+ * 结束时ADS1115恢复为单次转换模式。
+ *
+ * @param cycle 测试循环计数
+ * @param step 步骤号(从1开始)
+ * @param output 切换后的输出字
+ * @param result 输出的捕获结果
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_STATE: 未准备或ADS1115不可用
+ *         - 其他: ADS1115读取失败
+ */
+esp_err_t test_capture_run(uint32_t cycle, uint16_t step, uint16_t output, test_capture_result_t *result);
+
+/**
+ * @brief 结束捕获，释放样本缓冲区
+ */
+void test_capture_end(void);
+
+/**
+ * @brief 获取捕获统计
+ *
+ * @return 统计指针
+ */
+const test_capture_stats_t *test_capture_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_CAPTURE_H */
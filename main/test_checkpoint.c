@@ -0,0 +1,207 @@
+/**
+ * @file test_checkpoint.c
+ * @brief 测试会话检查点模块实现
+ */
+
+#include "test_checkpoint.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char *TAG = "TEST_CKPT";
+
+/* 检查点文件头，后接test_checkpoint_t、计划步骤和限值统计 */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;                                      // 文件标识
+    uint16_t version;                                    // 格式版本
+    uint16_t header_size;                                // 文件头长度
+    uint32_t payload_size;                               // 文件头之后的数据长度
+    uint32_t crc32;                                      // 数据的CRC32
+} test_checkpoint_header_t;
+
+static void test_checkpoint_path(char *path, size_t size, uint8_t session, uint32_t sequence)
+{
+    snprintf(path, size, TEST_CHECKPOINT_PATH_FORMAT, session, (sequence & 1) ? 'b' : 'a');
+}
+
+esp_err_t test_checkpoint_save(uint8_t session, test_checkpoint_t *ckpt,
+                               const test_plan_t *plan, const test_limits_t *limits)
+{
+    ckpt->sequence++;
+    ckpt->step_count = plan->step_count;
+    ckpt->repeat = plan->repeat;
+    strncpy(ckpt->plan_name, plan->name, sizeof(ckpt->plan_name) - 1);
+    ckpt->plan_name[sizeof(ckpt->plan_name) - 1] = '\0';
+    ckpt->fail_count = limits->fail_count;
+    ckpt->error_count = limits->error_count;
+
+    size_t steps_size = sizeof(test_step_t) * plan->step_count;
+    size_t stats_size = sizeof(test_limit_stat_t) * plan->step_count * ADS1115_CHANNEL_COUNT;
+    if (limits->stats == NULL || limits->step_count != plan->step_count) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    test_checkpoint_header_t header = {
+        .magic = TEST_CHECKPOINT_MAGIC,
+        .version = TEST_CHECKPOINT_VERSION,
+        .header_size = sizeof(test_checkpoint_header_t),
+        .payload_size = sizeof(test_checkpoint_t) + steps_size + stats_size,
+    };
+    header.crc32 = esp_rom_crc32_le(0, (const uint8_t *)ckpt, sizeof(test_checkpoint_t));
+    header.crc32 = esp_rom_crc32_le(header.crc32, (const uint8_t *)plan->steps, steps_size);
+    header.crc32 = esp_rom_crc32_le(header.crc32, (const uint8_t *)limits->stats, stats_size);
+
+    // 与上一个检查点交替写入，写入中掉电时上一个仍然有效
+    char path[32];
+    test_checkpoint_path(path, sizeof(path), session, ckpt->sequence);
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        ESP_LOGE(TAG, "无法打开检查点文件: %s", path);
+        return ESP_FAIL;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(ckpt, sizeof(test_checkpoint_t), 1, file) == 1 &&
+              fwrite(plan->steps, 1, steps_size, file) == steps_size &&
+              fwrite(limits->stats, 1, stats_size, file) == stats_size;
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    fclose(file);
+
+    if (!ok) {
+        ESP_LOGE(TAG, "检查点写入失败: %s", path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief 读取并校验一个检查点文件
+ *
+ * 成功时steps和stats为新分配的数组，由调用者释放
+ */
+static esp_err_t test_checkpoint_read(const char *path, test_checkpoint_t *ckpt,
+                                      test_step_t **steps, test_limit_stat_t **stats)
+{
+    *steps = NULL;
+    *stats = NULL;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    test_checkpoint_header_t header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == TEST_CHECKPOINT_MAGIC &&
+                 header.version == TEST_CHECKPOINT_VERSION && header.header_size == sizeof(header) &&
+                 fread(ckpt, sizeof(test_checkpoint_t), 1, file) == 1 &&
+                 ckpt->step_count > 0 && ckpt->step_count <= TEST_PLAN_MAX_STEPS;
+
+    size_t steps_size = valid ? sizeof(test_step_t) * ckpt->step_count : 0;
+    size_t stats_size = valid ? sizeof(test_limit_stat_t) * ckpt->step_count * ADS1115_CHANNEL_COUNT : 0;
+    valid = valid && header.payload_size == sizeof(test_checkpoint_t) + steps_size + stats_size;
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (valid) {
+        *steps = malloc(steps_size);
+        *stats = malloc(stats_size);
+        if (*steps == NULL || *stats == NULL) {
+            ret = ESP_ERR_NO_MEM;
+        } else if (fread(*steps, 1, steps_size, file) == steps_size &&
+                   fread(*stats, 1, stats_size, file) == stats_size) {
+            uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)ckpt, sizeof(test_checkpoint_t));
+            crc = esp_rom_crc32_le(crc, (const uint8_t *)*steps, steps_size);
+            crc = esp_rom_crc32_le(crc, (const uint8_t *)*stats, stats_size);
+            if (crc == header.crc32) {
+                ckpt->plan_name[sizeof(ckpt->plan_name) - 1] = '\0';
+                ckpt->log_path[sizeof(ckpt->log_path) - 1] = '\0';
+                ret = ESP_OK;
+            } else {
+                ESP_LOGW(TAG, "检查点校验失败: %s", path);
+            }
+        }
+    }
+    fclose(file);
+
+    if (ret != ESP_OK) {
+        free(*steps);
+        free(*stats);
+        *steps = NULL;
+        *stats = NULL;
+    }
+    return ret;
+}
+
+esp_err_t test_checkpoint_load(uint8_t session, test_checkpoint_t *ckpt,
+                               test_plan_t *plan, test_limits_t *limits)
+{
+    test_checkpoint_t best = {0};
+    test_step_t *best_steps = NULL;
+    test_limit_stat_t *best_stats = NULL;
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    // 两个槽中取有效且序号最大的
+    for (uint32_t slot = 0; slot < 2; slot++) {
+        char path[32];
+        test_checkpoint_t candidate;
+        test_step_t *steps;
+        test_limit_stat_t *stats;
+        test_checkpoint_path(path, sizeof(path), session, slot);
+
+        esp_err_t err = test_checkpoint_read(path, &candidate, &steps, &stats);
+        if (err == ESP_ERR_NO_MEM) {
+            ret = err;
+        }
+        if (err != ESP_OK) {
+            continue;
+        }
+
+        if (best_steps == NULL || candidate.sequence > best.sequence) {
+            free(best_steps);
+            free(best_stats);
+            best = candidate;
+            best_steps = steps;
+            best_stats = stats;
+        } else {
+            free(steps);
+            free(stats);
+        }
+    }
+
+    if (best_steps == NULL) {
+        return ret;
+    }
+
+    if (test_limits_init(limits, best.step_count) != ESP_OK) {
+        free(best_steps);
+        free(best_stats);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(limits->stats, best_stats, sizeof(test_limit_stat_t) * best.step_count * ADS1115_CHANNEL_COUNT);
+    limits->fail_count = best.fail_count;
+    limits->error_count = best.error_count;
+    free(best_stats);
+
+    test_plan_free(plan);
+    plan->steps = best_steps;
+    plan->step_count = best.step_count;
+    plan->repeat = best.repeat;
+    strncpy(plan->name, best.plan_name, sizeof(plan->name) - 1);
+    plan->name[sizeof(plan->name) - 1] = '\0';
+
+    *ckpt = best;
+    ESP_LOGI(TAG, "会话%d加载检查点#%lu (循环%lu, 步骤%d)", session, best.sequence,
+             best.status.cycle_count, best.step_index + 1);
+    return ESP_OK;
+}
+
+void test_checkpoint_clear(uint8_t session)
+{
+    for (uint32_t slot = 0; slot < 2; slot++) {
+        char path[32];
+        test_checkpoint_path(path, sizeof(path), session, slot);
+        remove(path);
+    }
+}
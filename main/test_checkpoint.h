@@ -0,0 +1,101 @@
+/**
+ * @file test_checkpoint.h
+ * @brief 测试会话检查点模块头文件
+ *
+ * 测试运行中定期把会话的执行位置(步骤、图案、驻留)、计数和限值统计
+ * 连同测试计划写入SD卡，板子复位后可从最近的检查点继续测试，
+ * 并追加到同一个测试日志。
+ *
+ * 每个会话两个检查点文件交替写入，文件带序号和CRC32校验，
+ * 写入过程中掉电只会损坏正在写的那个，加载时取有效且序号最大的一个。
+ */
+
+#ifndef TEST_CHECKPOINT_H
+#define TEST_CHECKPOINT_H
+
+#include "esp_err.h"
+#include "test_commands.h"
+#include "test_plan.h"
+#include "test_limits.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 检查点配置常量 */
+#define TEST_CHECKPOINT_PATH_FORMAT   "/sdcard/ckpt%d%c.bin"  /*!< 检查点文件(会话号, 槽a/b) */
+#define TEST_CHECKPOINT_MAGIC         0x54504B43              /*!< 文件标识 "CKPT" */
+#define TEST_CHECKPOINT_VERSION       1                       /*!< 文件格式版本 */
+#define TEST_CHECKPOINT_DEFAULT_S     10                      /*!< 默认检查点间隔(秒) */
+#define TEST_CHECKPOINT_MAX_S         3600                    /*!< 最大检查点间隔(秒) */
+
+/* 检查点内容 */
+typedef struct {
+    uint32_t sequence;                                   /*!< 检查点序号 */
+    test_status_t status;                                /*!< 会话状态和计数 */
+    uint32_t elapsed_ms;                                 /*!< 已运行时间(毫秒) */
+    uint16_t step_index;                                 /*!< 当前步骤(从0开始) */
+    uint8_t samples_left;                                /*!< 当前图案剩余采样次数 */
+    uint32_t pattern_index;                              /*!< 当前图案序号(从0开始) */
+    uint32_t dwell_left;                                 /*!< 剩余驻留周期数 */
+    uint32_t period_ms;                                  /*!< 循环周期(毫秒) */
+    uint16_t io_mask;                                    /*!< 会话的IO掩码 */
+    uint8_t led_mask;                                    /*!< 会话的LED掩码 */
+    uint32_t fail_count;                                 /*!< 超限样本总数 */
+    uint32_t error_count;                                /*!< 读取失败总数 */
+    uint32_t log_size;                                   /*!< 检查点时日志文件已写入的长度(字节) */
+    char log_path[32];                                   /*!< 测试日志文件 */
+    char plan_name[TEST_PLAN_NAME_LEN];                  /*!< 测试计划名称 */
+    uint16_t step_count;                                 /*!< 计划步骤数 */
+    uint32_t repeat;                                     /*!< 计划重复次数 */
+} test_checkpoint_t;
+
+/**
+ * @brief 写入检查点
+ *
+ * 计划步骤和限值统计随检查点一起保存，与上一次写入的文件交替
+ *
+ * @param session 会话编号
+ * @param ckpt 检查点内容(sequence自动递增，plan_name/step_count/repeat取自plan)
+ * @param plan 测试计划
+ * @param limits 限值统计
+ * @return esp_err_t
+ *         - ESP_OK: 写入成功
+ *         - ESP_FAIL: 文件写入失败
+ */
+esp_err_t test_checkpoint_save(uint8_t session, test_checkpoint_t *ckpt,
+                               const test_plan_t *plan, const test_limits_t *limits);
+
+/**
+ * @brief 加载会话最近的有效检查点
+ *
+ * 成功时替换plan的步骤并按计划重新分配limits
+ *
+ * @param session 会话编号
+ * @param ckpt 输出的检查点内容
+ * @param plan 输出的测试计划
+ * @param limits 输出的限值统计
+ * @return esp_err_t
+ *         - ESP_OK: 加载成功
+ *         - ESP_ERR_NOT_FOUND: 没有有效的检查点
+ *         - ESP_ERR_NO_MEM: 内存不足
+ */
+esp_err_t test_checkpoint_load(uint8_t session, test_checkpoint_t *ckpt,
+                               test_plan_t *plan, test_limits_t *limits);
+
+/**
+ * @brief 删除会话的检查点
+ *
+ * 测试正常结束后调用，避免恢复已结束的测试
+ *
+ * @param session 会话编号
+ */
+void test_checkpoint_clear(uint8_t session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_CHECKPOINT_H */
@@ -4,6 +4,17 @@
  */
 
 #include "test_commands.h"
+#include "test_scheduler.h"
+#include "test_plan.h"
+#include "test_limits.h"
+#include "test_console.h"
+#include "test_phase.h"
+#include "test_capture.h"
+#include "test_trigger.h"
+#include "test_event.h"
+#include "test_pattern.h"
+#include "test_checkpoint.h"
+#include "uart_driver.h"
 #include "led.h"
 #include "i2c_config.h"
 #include "tca9535.h"
@@ -15,30 +26,293 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
-#include "freertos/semphr.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <sys/stat.h>
 
 static const char *TAG = "TEST_CMD";
 
-// 全局测试状态
-static test_status_t g_test_status = {0};
-static TaskHandle_t test_task_handle = NULL;
-static SemaphoreHandle_t test_mutex = NULL;
-static uint32_t test_channel_id = 0; // 保存Shell通道ID用于打印
+// 终端最多列出的不合格项数
+#define TEST_VERDICT_MAX_LISTED 8
+
+// 每个会话对应一个日志流
+_Static_assert(TEST_MAX_SESSIONS <= TEST_EVENT_MAX_STREAMS, "每个测试会话需要一个日志流");
+
+/* 测试会话：每个Shell通道一个，各自独立的计划、状态、日志和终端输出 */
+typedef struct {
+    uint8_t id;                                          // 会话编号(从1开始)，0为空闲
+    uint32_t channels[TEST_SESSION_MAX_VIEWERS];         // 输出通道，[0]为所属通道，其余为观察者，0为空
+    test_console_t consoles[TEST_SESSION_MAX_VIEWERS];   // 各输出通道的终端输出级(运行中有效)
+    test_status_t status;
+    TaskHandle_t task_handle;
+    SemaphoreHandle_t mutex;
+    SemaphoreHandle_t stopped;                           // 测试任务收尾完成后释放
+    volatile bool active;                                // 占用夹具：从预留到测试任务退出，停止中仍为true
+    SemaphoreHandle_t control;                           // 启动和停止互斥，testoff不会插入到启动过程中
+    uint32_t period_ms;                                  // 测试循环周期
+    test_scheduler_t scheduler;
+    test_plan_t plan;                                    // 当前测试计划(运行中只读)
+    bool plan_completed;                                 // 计划按repeat次数执行完毕
+    test_limits_t limits;                                // 逐步骤限值统计
+    test_phase_stats_t phase_stats;                      // 测试循环阶段耗时统计
+    test_console_config_t console_config;
+    test_capture_config_t capture_config;
+    test_trigger_config_t trigger_config;
+    uint16_t io_mask;                                    // 本会话控制的TCA9535引脚
+    uint8_t led_mask;                                    // 本会话控制的LED
+    char log_path[32];                                   // 测试日志文件
+    uint32_t checkpoint_s;                               // 检查点间隔(秒)，0为关闭
+    uint32_t checkpoint_count;                           // 本次运行写入的检查点数
+    uint32_t checkpoint_errors;                          // 检查点写入失败次数
+    test_checkpoint_t checkpoint;                        // 最近的检查点(恢复时为加载的检查点)
+    bool resumed;                                        // 本次运行从检查点恢复
+} test_session_t;
+
+static test_session_t sessions[TEST_MAX_SESSIONS];
+
+// 会话表和共享夹具(TCA9535输出字)的互斥锁
+static SemaphoreHandle_t fixture_mutex = NULL;
+// TCA9535当前输出字，各会话只改写自己掩码内的引脚
+static uint16_t fixture_output = 0;
+
+static const test_capture_config_t default_capture_config = {
+    .enabled = false,
+    .channel = 0,
+    .window_ms = TEST_CAPTURE_DEFAULT_WINDOW_MS,
+};
+static const test_trigger_config_t default_trigger_config = {
+    .enabled = false,
+    .auto_rearm = true,
+    .channel_mask = 0x0F,
+    .source_mask = TEST_TRIGGER_SRC(TEST_CAPTURE_SOURCE_IO_STEP) | TEST_TRIGGER_SRC(TEST_CAPTURE_SOURCE_KEY) |
+                   TEST_TRIGGER_SRC(TEST_CAPTURE_SOURCE_MANUAL),
+    .pre_samples = TEST_TRIGGER_DEFAULT_PRE,
+    .post_samples = TEST_TRIGGER_DEFAULT_POST,
+    .level_ma = 100.0f,
+    .slope_ma = 20.0f,
+};
+static const test_console_config_t default_console_config = {
+    .mode = TEST_CONSOLE_MODE_ALL,
+    .every_n = TEST_CONSOLE_DEFAULT_EVERY,
+    .change_ma = TEST_CONSOLE_DEFAULT_CHANGE,
+};
 
 // TCA9535句柄获取函数（在main中实现）
 extern tca9535_handle_t get_tca9535_handle(void);
 
+/**
+ * @brief 查找通道所属的会话
+ *
+ * @param create 没有时是否分配一个空闲会话
+ * @return 会话指针，没有或会话已满时返回NULL
+ */
+static test_session_t *test_session_get(uint32_t channel_id, bool create)
+{
+    test_session_t *s = NULL;
+    test_session_t *free_slot = NULL;
+    
+    xSemaphoreTake(fixture_mutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < TEST_MAX_SESSIONS; i++) {
+        if (sessions[i].id != 0 && sessions[i].channels[0] == channel_id) {
+            s = &sessions[i];
+            break;
+        }
+        if (sessions[i].id == 0 && free_slot == NULL) {
+            free_slot = &sessions[i];
+        }
+    }
+    
+    bool created = false;
+    if (s == NULL && create && free_slot != NULL) {
+        s = free_slot;
+        SemaphoreHandle_t mutex = s->mutex;
+        SemaphoreHandle_t stopped = s->stopped;
+        SemaphoreHandle_t control = s->control;
+        memset(s, 0, sizeof(test_session_t));
+        s->mutex = mutex;
+        s->stopped = stopped;
+        s->control = control;
+        s->id = (uint8_t)(s - sessions) + 1;
+        s->channels[0] = channel_id;
+        created = true;
+    }
+    xSemaphoreGive(fixture_mutex);
+    
+    if (!created) {
+        return s;
+    }
+    
+    s->period_ms = TEST_CYCLE_INTERVAL_MS;
+    s->status.period_ms = s->period_ms;
+    s->console_config = default_console_config;
+    s->capture_config = default_capture_config;
+    s->trigger_config = default_trigger_config;
+    s->io_mask = 0xFFFF;
+    s->led_mask = (1 << TEST_LED_COUNT) - 1;
+    s->checkpoint_s = TEST_CHECKPOINT_DEFAULT_S;
+    if (s->id == 1) {
+        strncpy(s->log_path, TEST_LOG_FILE_PATH, sizeof(s->log_path) - 1);
+    } else {
+        snprintf(s->log_path, sizeof(s->log_path), TEST_SESSION_LOG_FORMAT, s->id);
+    }
+    
+    // 加载测试计划：SD卡上存在计划文件时优先使用，否则使用内置默认计划
+    if (test_plan_load_default(&s->plan) != ESP_OK) {
+        ESP_LOGE(TAG, "加载内置测试计划失败");
+        s->id = 0;
+        return NULL;
+    }
+    
+    struct stat st;
+    if (sd_card_is_mounted() && stat(TEST_PLAN_DEFAULT_PATH, &st) == 0) {
+        char error[128];
+        if (test_plan_load_file(&s->plan, TEST_PLAN_DEFAULT_PATH, error, sizeof(error)) != ESP_OK) {
+            ESP_LOGW(TAG, "测试计划文件无效(%s)，使用内置默认计划", error);
+        }
+    }
+    
+    ESP_LOGI(TAG, "通道%lu创建测试会话%d", channel_id, s->id);
+    return s;
+}
+
+/**
+ * @brief 按编号查找已分配的会话
+ */
+static test_session_t *test_session_by_id(int id)
+{
+    if (id < 1 || id > TEST_MAX_SESSIONS || sessions[id - 1].id == 0) {
+        return NULL;
+    }
+    return &sessions[id - 1];
+}
+
+/**
+ * @brief 除指定会话外是否还有会话在运行
+ */
+static bool test_other_running(const test_session_t *s)
+{
+    for (uint8_t i = 0; i < TEST_MAX_SESSIONS; i++) {
+        if (&sessions[i] != s && sessions[i].id != 0 && sessions[i].status.running) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 检查会话能否与占用夹具的会话共用夹具，可以则标记为运行中
+ *
+ * 各会话的IO/LED掩码不能重叠；稳定捕获和触发捕获需要独占ADC，
+ * 同一时刻只能有一个会话开启。已停止但测试任务尚未退出的会话仍占用夹具
+ *
+ * @param reason 冲突时的说明
+ * @return 冲突的会话，NULL表示已标记为运行中
+ */
+static const test_session_t *test_session_reserve(test_session_t *s, char *reason, size_t reason_len)
+{
+    const test_session_t *conflict = NULL;
+    
+    xSemaphoreTake(fixture_mutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < TEST_MAX_SESSIONS && conflict == NULL; i++) {
+        const test_session_t *other = &sessions[i];
+        if (other == s || other->id == 0 || !other->active) {
+            continue;
+        }
+        
+        conflict = other;
+        if (other->io_mask & s->io_mask) {
+            snprintf(reason, reason_len, "IO引脚0x%04X", other->io_mask & s->io_mask);
+        } else if (other->led_mask & s->led_mask) {
+            snprintf(reason, reason_len, "LED掩码0x%X", other->led_mask & s->led_mask);
+        } else if ((other->capture_config.enabled || other->trigger_config.enabled) &&
+                   (s->capture_config.enabled || s->trigger_config.enabled)) {
+            snprintf(reason, reason_len, "稳定/触发捕获(独占ADC)");
+        } else {
+            conflict = NULL;
+        }
+    }
+    
+    if (conflict == NULL) {
+        s->status.running = true;
+        s->active = true;
+    }
+    xSemaphoreGive(fixture_mutex);
+    
+    return conflict;
+}
+
+/**
+ * @brief 向会话的所有输出通道发送消息
+ */
+static void test_session_broadcast(const test_session_t *s, const char *message)
+{
+    for (uint8_t i = 0; i < TEST_SESSION_MAX_VIEWERS; i++) {
+        if (s->channels[i] != 0) {
+            cmd_output(s->channels[i], (uint8_t *)message, strlen(message));
+        }
+    }
+}
+
+/**
+ * @brief 以会话当前状态构造事件
+ */
+static test_event_t test_event_make(const test_session_t *s, test_event_type_t type, int64_t timestamp_us)
+{
+    test_event_t event = {
+        .timestamp_us = timestamp_us,
+        .cycle = s->status.cycle_count,
+        .step = s->status.current_step + 1,
+        .output = s->status.current_output,
+        .led_mask = s->status.current_led_mask,
+        .type = type,
+        .stream = s->id - 1,
+    };
+    return event;
+}
+
+/**
+ * @brief 投递错误事件
+ */
+static void test_post_error(const test_session_t *s, const char *source, esp_err_t code)
+{
+    test_event_t event = test_event_make(s, TEST_EVENT_ERROR, esp_timer_get_time());
+    event.error.code = code;
+    strncpy(event.error.source, source, sizeof(event.error.source) - 1);
+    test_event_post(&event);
+}
+
+/**
+ * @brief 投递采样事件
+ *
+ * 时间戳取节拍唤醒时刻，记录采样时生效的输出
+ */
+static void test_post_sample(const test_session_t *s, const ads1115_channel_data_t *channel_data,
+                             const test_scheduler_tick_t *tick)
+{
+    test_event_t event = test_event_make(s, TEST_EVENT_SAMPLE, tick->timestamp_us);
+    event.sample.lateness_us = tick->lateness_us;
+    event.sample.missed = tick->missed;
+    for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT; ch++) {
+        if (channel_data[ch].status == ESP_OK) {
+            event.sample.raw[ch] = channel_data[ch].raw_value;
+            event.sample.valid_mask |= 1 << ch;
+        }
+    }
+    test_event_post(&event);
+}
+
 /**
  * @brief 按键事件回调函数
+ *
+ * 每个运行中的会话各订阅一次，arg为会话
  */
-static void key_event_handler(key_event_t event, uint32_t timestamp_ms)
+static void key_event_handler(key_event_t event, int64_t timestamp_us, void *arg)
 {
-    if (!g_test_status.running || test_channel_id == 0) {
-        return; // 测试未运行或没有Shell通道，忽略按键事件
+    test_session_t *s = (test_session_t *)arg;
+    if (!s->status.running) {
+        return; // 测试未运行，忽略按键事件
     }
     
     // 使用静态缓冲区减少栈使用，并添加互斥保护
@@ -54,293 +328,1419 @@ static void key_event_handler(key_event_t event, uint32_t timestamp_ms)
         }
     }
     
+    // 按下事件可作为触发捕获的触发源，只由开启触发捕获的会话触发
+    if (event == KEY_EVENT_PRESSED && s->trigger_config.enabled) {
+        test_trigger_fire(TEST_CAPTURE_SOURCE_KEY);
+    }
+    
     // 确定事件字符串
     const char *event_str = (event == KEY_EVENT_PRESSED) ? "按下" : "松开";
     
     // 获取互斥锁
     if (xSemaphoreTake(output_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        // 在Shell中打印按键事件
-        shell_snprintf(output, sizeof(output), "\r\n>>> 按键%s (时间戳: %lu ms) <<<\r\n", event_str, timestamp_ms);
-        cmd_output(test_channel_id, (uint8_t *)output, strlen(output));
+        // 在会话的所有Shell通道中打印按键事件
+        shell_snprintf(output, sizeof(output), "\r\n>>> 按键%s (时间戳: %.3f ms) <<<\r\n", event_str, timestamp_us / 1000.0);
+        test_session_broadcast(s, output);
         
         xSemaphoreGive(output_mutex);
     }
     
-    // 记录到日志文件
-    if (sd_card_is_mounted()) {
-        FILE *file = fopen(TEST_LOG_FILE_PATH, "a");
-        if (file != NULL) {
-            fprintf(file, "KEY_EVENT,%lu,%s,,,,,,,,,,,\n", timestamp_ms, event_str);
-            fclose(file);
+    // 以边沿时间投递到事件总线，由日志任务按时间顺序写入
+    test_event_t key_event = test_event_make(s, TEST_EVENT_KEY, timestamp_us);
+    key_event.key.pressed = event == KEY_EVENT_PRESSED;
+    test_event_post(&key_event);
+    
+    ESP_LOGI(TAG, "会话%d按键%s事件已处理 (时间戳: %lld us)", s->id, event_str, timestamp_us);
+}
+
+/**
+ * @brief 写入会话的TCA9535输出
+ *
+ * 只改写会话掩码内的引脚，其余引脚保持其他会话的输出
+ */
+static esp_err_t test_write_output(const test_session_t *s, tca9535_handle_t tca_handle, uint16_t output)
+{
+    xSemaphoreTake(fixture_mutex, portMAX_DELAY);
+    uint16_t word = (fixture_output & ~s->io_mask) | (output & s->io_mask);
+    tca9535_register_t output_reg = {.word = word};
+    esp_err_t ret = tca9535_write_output(tca_handle, &output_reg);
+    if (ret == ESP_OK) {
+        fixture_output = word;
+    }
+    xSemaphoreGive(fixture_mutex);
+    return ret;
+}
+
+/**
+ * @brief 应用测试步骤的IO输出和LED状态
+ *
+ * 与当前状态相同的输出跳过，减少每步的I2C/GPIO操作；
+ * 只改写会话掩码内的IO引脚和LED
+ *
+ * @param output TCA9535输出字(固定输出或当前图案)
+ * @return true: TCA9535输出已切换
+ */
+static bool test_apply_step(test_session_t *s, const test_step_t *step, uint16_t output, bool force)
+{
+    output &= s->io_mask;
+    uint8_t led_mask = step->led_mask & s->led_mask;
+    bool output_changed = false;
+    bool led_changed = force || led_mask != s->status.current_led_mask;
+    int64_t step_us = esp_timer_get_time();
+    tca9535_handle_t tca_handle = get_tca9535_handle();
+    if (tca_handle != NULL && (force || output != s->status.current_output)) {
+        int64_t start_us = esp_timer_get_time();
+        esp_err_t ret = test_write_output(s, tca_handle, output);
+        output_changed = ret == ESP_OK;
+        test_phase_end(&s->phase_stats, TEST_PHASE_TCA, start_us);
+        
+        if (ret != ESP_OK) {
+            test_post_error(s, "TCA9535", ret);
+        }
+        
+        // 输出切换作为触发捕获的触发源
+        if (output_changed && s->trigger_config.enabled) {
+            test_trigger_set_context(s->status.cycle_count, s->status.current_step + 1, output);
+            test_trigger_fire(TEST_CAPTURE_SOURCE_IO_STEP);
+        }
+    }
+    
+    if (led_changed) {
+        int64_t start_us = esp_timer_get_time();
+        for (uint8_t i = 0; i < TEST_LED_COUNT; i++) {
+            if (s->led_mask & (1 << i)) {
+                led_set_state((led_num_t)(LED_1 + i), (led_mask & (1 << i)) ? LED_ON : LED_OFF);
+            }
         }
+        test_phase_end(&s->phase_stats, TEST_PHASE_LED, start_us);
     }
     
-    ESP_LOGI(TAG, "按键%s事件已处理 (时间戳: %lu)", event_str, timestamp_ms);
+    s->status.current_output = output;
+    s->status.current_led_mask = led_mask;
+    
+    if (output_changed || led_changed) {
+        test_event_t event = test_event_make(s, TEST_EVENT_STEP, step_us);
+        test_event_post(&event);
+    }
+    
+    return output_changed;
 }
 
 /**
- * @brief 写入测试数据到SD卡
+ * @brief IO切换后捕获稳定过程，并在终端输出摘要
  */
-static esp_err_t write_test_data_to_sd(const ads1115_channel_data_t *channel_data)
+static void test_capture_step(test_session_t *s, uint16_t step_index)
 {
-    if (!sd_card_is_mounted()) {
-        ESP_LOGE(TAG, "SD卡未挂载");
-        return ESP_ERR_INVALID_STATE;
-    }
+    int64_t start_us = esp_timer_get_time();
+    test_capture_result_t result;
+    esp_err_t ret = test_capture_run(s->status.cycle_count, step_index + 1,
+                                     s->status.current_output, &result);
+    test_phase_end(&s->phase_stats, TEST_PHASE_CAPTURE, start_us);
     
-    FILE *file = fopen(TEST_LOG_FILE_PATH, "a");
-    if (file == NULL) {
-        ESP_LOGE(TAG, "无法打开测试日志文件");
-        return ESP_ERR_INVALID_STATE;
+    if (ret != ESP_OK || s->console_config.mode == TEST_CONSOLE_MODE_OFF ||
+        s->console_config.mode == TEST_CONSOLE_MODE_STATUS) {
+        return;
     }
     
-    // 获取当前时间戳
-    uint32_t timestamp_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    char output[160];
+    shell_snprintf(output, sizeof(output), "[%lu] 步骤%d 捕获CH%d: 峰值%.2fmA 终值%.2fmA 稳定%s%luus (%d点/%luus)\r\n",
+                   s->status.cycle_count, step_index + 1, s->capture_config.channel,
+                   result.peak_ma, result.final_ma, result.settled ? "" : ">",
+                   result.settle_us, result.sample_count, result.sample_period_us);
+    for (uint8_t i = 0; i < TEST_SESSION_MAX_VIEWERS; i++) {
+        if (s->consoles[i].channel_id != 0) {
+            test_console_write(&s->consoles[i], output, strlen(output));
+        }
+    }
+}
+
+/**
+ * @brief 执行一次采样：读取ADS1115，投递到日志并打印到会话的Shell终端
+ */
+static void test_sample_step(test_session_t *s, const test_step_t *step, const test_scheduler_tick_t *tick)
+{
+    ads1115_channel_data_t channel_data[ADS1115_CHANNEL_COUNT];
+    bool adc_ok = false;
     
-    // 写入时间戳、循环计数、IO状态、LED状态
-    // 显示实际拉低的IO和点亮的LED（因为在写入时已经切换到下一个了）
-    uint8_t actual_io = (g_test_status.current_io == 0) ? 8 : g_test_status.current_io; // 显示1-8
-    uint8_t actual_led = (g_test_status.current_led == 1) ? 4 : g_test_status.current_led - 1;
+    bool in_window[ADS1115_CHANNEL_COUNT];
+    uint16_t step_index = s->status.current_step;
     
-    fprintf(file, "%lu,%lu,%d,%d,", 
-            timestamp_ms, g_test_status.cycle_count, 
-            actual_io, actual_led);
+    if (ads1115_get_handle() != NULL) {
+        // 触发捕获运行时ADC由捕获任务独占，直接取其最新样本
+        int64_t start_us = esp_timer_get_time();
+        esp_err_t ret;
+        if (test_trigger_is_running()) {
+            ret = test_trigger_get_latest(channel_data);
+        } else {
+            ret = ads1115_read_all_detailed(channel_data);
+        }
+        adc_ok = ret == ESP_OK;
+        test_phase_end(&s->phase_stats, TEST_PHASE_ADC, start_us);
+        
+        // 日志由日志任务写入，这里只投递事件
+        if (adc_ok) {
+            test_post_sample(s, channel_data, tick);
+        } else {
+            test_post_error(s, "ADS1115", ret);
+        }
+    }
     
-    // 写入4个通道的电压和电流数据，包含单位
+    // 在线累计统计并与步骤电流窗口比较
     for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT; ch++) {
-        if (channel_data[ch].status == ESP_OK) {
-            fprintf(file, "%.4fV,%.2fmA", channel_data[ch].voltage_v, channel_data[ch].current_ma);
+        if (adc_ok && channel_data[ch].status == ESP_OK) {
+            in_window[ch] = test_limits_add(&s->limits, step, step_index, ch, channel_data[ch].current_ma);
         } else {
-            fprintf(file, "ERROR,ERROR");
+            test_limits_add_error(&s->limits, step, step_index, ch);
+            in_window[ch] = false;
+        }
+    }
+    
+    // 每个输出通道各自按输出模式筛选和限速，采样行只格式化一次
+    int64_t start_us = 0;
+    bool status_line = s->console_config.mode == TEST_CONSOLE_MODE_STATUS;
+    char output[256];
+    size_t line_len = 0;
+    
+    for (uint8_t i = 0; i < TEST_SESSION_MAX_VIEWERS; i++) {
+        test_console_t *console = &s->consoles[i];
+        if (console->channel_id == 0 ||
+            !test_console_should_emit(console, step_index, adc_ok ? channel_data : NULL)) {
+            continue;
+        }
+        
+        if (line_len == 0) {
+            // 每次采样只输出一行，状态行模式用回车覆盖上一行
+            start_us = esp_timer_get_time();
+            // 图案步骤显示图案序号
+            char pattern_data[32] = "";
+            if (s->status.pattern_count > 1) {
+                snprintf(pattern_data, sizeof(pattern_data), " 图案%lu/%lu",
+                         s->status.pattern_index + 1, s->status.pattern_count);
+            }
+            shell_snprintf(output, sizeof(output), "%s[%lu] 步骤%d/%d%s IO:0x%04X LED:0x%X |",
+                           status_line ? "\r" : "", s->status.cycle_count,
+                           step_index + 1, s->plan.step_count, pattern_data,
+                           s->status.current_output, s->status.current_led_mask);
+            
+            // 超出步骤电流窗口的通道标记为超限
+            for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT; ch++) {
+                char ch_data[32];
+                if (!adc_ok) {
+                    snprintf(ch_data, sizeof(ch_data), " CH%d:--", ch);
+                } else if (channel_data[ch].status == ESP_OK) {
+                    snprintf(ch_data, sizeof(ch_data), " CH%d:%.2fmA%s", ch, channel_data[ch].current_ma,
+                             in_window[ch] ? "" : "!");
+                } else {
+                    snprintf(ch_data, sizeof(ch_data), " CH%d:ERR", ch);
+                }
+                strncat(output, ch_data, sizeof(output) - strlen(output) - 1);
+            }
+            line_len = strlen(output);
         }
-        if (ch < ADS1115_CHANNEL_COUNT - 1) {
-            fprintf(file, ",");
+        
+        // 行尾的丢弃计数属于各自的输出通道
+        output[line_len] = '\0';
+        if (status_line) {
+            char tail[48];
+            snprintf(tail, sizeof(tail), " | F:%lu D:%lu   ", s->limits.fail_count, console->dropped_lines);
+            strncat(output, tail, sizeof(output) - strlen(output) - 1);
+        } else {
+            strncat(output, "\r\n", sizeof(output) - strlen(output) - 1);
         }
+        
+        test_console_write(console, output, strlen(output));
     }
-    fprintf(file, "\n");
     
+    if (line_len > 0) {
+        test_phase_end(&s->phase_stats, TEST_PHASE_CONSOLE, start_us);
+    }
+}
+
+/**
+ * @brief 各触发源的触发次数之和
+ */
+static uint32_t test_sum_trigger_count(void)
+{
+    const test_trigger_stats_t *trig = test_trigger_get_stats();
+    uint32_t total = 0;
+    for (size_t i = 0; i < sizeof(trig->trigger_count) / sizeof(trig->trigger_count[0]); i++) {
+        total += trig->trigger_count[i];
+    }
+    return total;
+}
+
+/**
+ * @brief 写入测试会话结束标记到日志文件
+ */
+static void test_write_session_footer(test_session_t *s)
+{
+    if (!sd_card_is_mounted()) {
+        return;
+    }
+    
+    FILE *file = fopen(s->log_path, "a");
+    if (file == NULL) {
+        return;
+    }
+    
+    uint32_t end_time_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    uint32_t duration_ms = end_time_ms - s->status.start_time_ms;
+    fprintf(file, "\n=== 测试会话结束 ===\n");
+    fprintf(file, "会话: %d (通道%lu, IO掩码0x%04X, LED掩码0x%X)\n", s->id, s->channels[0], s->io_mask, s->led_mask);
+    fprintf(file, "测试计划: %s (%d个步骤, 完成%lu轮%s)\n", s->plan.name, s->plan.step_count,
+            s->status.plan_loops, s->plan_completed ? ", 已执行完毕" : "");
+    fprintf(file, "总循环次数: %lu\n", s->status.cycle_count);
+    fprintf(file, "测试时长: %lu ms (%.1f秒)\n", duration_ms, duration_ms / 1000.0f);
+    fprintf(file, "循环周期: %lu ms, 超时循环: %lu, 丢失节拍: %lu, 最大调度延迟: %ld us\n",
+            s->status.period_ms, s->status.overrun_count,
+            s->status.missed_ticks, s->status.max_lateness_us);
+    const test_event_stats_t *events = test_event_get_stats(s->id - 1);
+    fprintf(file, "事件日志: 写入%lu, 丢弃%lu, 重排%lu, 超出重排窗口%lu, 重排缓冲最大占用%lu\n",
+            events->written, events->dropped, events->reordered, events->late, events->max_pending);
+    test_limits_write_report(&s->limits, &s->plan, file);
+    test_phase_write_report(&s->phase_stats, file);
+    if (s->capture_config.enabled) {
+        const test_capture_stats_t *cap = test_capture_get_stats();
+        fprintf(file, "稳定捕获: CH%d 窗口%lums, 捕获%lu次, 失败%lu次, 未稳定%lu次, 最大稳定时间%lu us, 最大峰值%.3f mA (波形: %s)\n",
+                s->capture_config.channel, s->capture_config.window_ms, cap->capture_count,
+                cap->error_count, cap->unsettled_count, cap->max_settle_us, cap->max_peak_ma,
+                TEST_CAPTURE_FILE_PATH);
+    }
+    if (s->trigger_config.enabled) {
+        const test_trigger_stats_t *trig = test_trigger_get_stats();
+        fprintf(file, "触发捕获: 通道掩码0x%X, 样本%lu (每通道间隔%lu us), 丢失节拍%lu, 读取失败%lu, "
+                "触发 io:%lu level:%lu slope:%lu key:%lu manual:%lu, 保存%lu次, 保存失败%lu次 (波形: %s)\n",
+                s->trigger_config.channel_mask, trig->sample_count, trig->sample_period_us,
+                trig->missed_ticks, trig->read_errors,
+                trig->trigger_count[TEST_CAPTURE_SOURCE_IO_STEP], trig->trigger_count[TEST_CAPTURE_SOURCE_LEVEL],
+                trig->trigger_count[TEST_CAPTURE_SOURCE_SLOPE], trig->trigger_count[TEST_CAPTURE_SOURCE_KEY],
+                trig->trigger_count[TEST_CAPTURE_SOURCE_MANUAL], trig->saved_count, trig->save_errors,
+                TEST_CAPTURE_FILE_PATH);
+    }
+    fprintf(file, "测试结论: %s (超限样本: %lu, 读取失败: %lu)\n",
+            test_limits_verdict_str(test_limits_verdict(&s->limits, &s->plan)),
+            s->limits.fail_count, s->limits.error_count);
+    fprintf(file, "===================\n\n");
     fclose(file);
-    return ESP_OK;
+}
+
+/**
+ * @brief 输出测试结论和超限的步骤通道到Shell终端
+ */
+static void test_output_verdict(const test_session_t *s, uint32_t channel_id)
+{
+    char output[160];
+    test_verdict_t verdict = test_limits_verdict(&s->limits, &s->plan);
+    
+    shell_snprintf(output, sizeof(output), "测试结论: %s (超限样本: %lu, 读取失败: %lu)\r\n",
+                   test_limits_verdict_str(verdict), s->limits.fail_count, s->limits.error_count);
+    cmd_output(channel_id, (uint8_t *)output, strlen(output));
+    
+    if (verdict != TEST_VERDICT_FAIL) {
+        return;
+    }
+    
+    // 只列出不合格项，完整统计见日志文件
+    uint16_t listed = 0;
+    for (uint16_t i = 0; i < s->plan.step_count && i < s->limits.step_count; i++) {
+        const test_step_t *step = &s->plan.steps[i];
+        for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT; ch++) {
+            const test_limit_stat_t *stat = test_limits_get(&s->limits, i, ch);
+            if (!(step->limit_mask & (1 << ch)) || (stat->fail_count == 0 && stat->error_count == 0)) {
+                continue;
+            }
+            if (listed++ >= TEST_VERDICT_MAX_LISTED) {
+                shell_snprintf(output, sizeof(output), "  ... 更多不合格项见 %s\r\n", s->log_path);
+                cmd_output(channel_id, (uint8_t *)output, strlen(output));
+                return;
+            }
+            shell_snprintf(output, sizeof(output),
+                           "  步骤%d CH%d: %.2f~%.2fmA 均值%.2f 标准差%.2f 窗口[%.2f,%.2f] 超限%lu/%lu 失败%lu\r\n",
+                           i + 1, ch, stat->min_ma, stat->max_ma, stat->mean_ma, test_limits_stddev(stat),
+                           step->min_ma[ch], step->max_ma[ch], stat->fail_count, stat->count, stat->error_count);
+            cmd_output(channel_id, (uint8_t *)output, strlen(output));
+        }
+    }
+}
+
+/**
+ * @brief 写入会话检查点
+ *
+ * 记录本节拍处理完后的执行位置，恢复时从下一个节拍继续
+ */
+static void test_save_checkpoint(test_session_t *s, uint16_t step_index, const test_pattern_iter_t *pattern,
+                                 uint32_t dwell_left, uint8_t samples_left)
+{
+    int64_t start_us = esp_timer_get_time();
+    test_checkpoint_t *ckpt = &s->checkpoint;
+    ckpt->status = s->status;
+    ckpt->elapsed_ms = xTaskGetTickCount() * portTICK_PERIOD_MS - s->status.start_time_ms;
+    ckpt->step_index = step_index;
+    ckpt->pattern_index = pattern->index;
+    ckpt->dwell_left = dwell_left;
+    ckpt->samples_left = samples_left;
+    ckpt->period_ms = s->status.period_ms;
+    ckpt->io_mask = s->io_mask;
+    ckpt->led_mask = s->led_mask;
+    strncpy(ckpt->log_path, s->log_path, sizeof(ckpt->log_path) - 1);
+
+    // 日志由日志任务定期刷新，文件长度只是检查点时已落盘的部分
+    struct stat st;
+    ckpt->log_size = stat(s->log_path, &st) == 0 ? (uint32_t)st.st_size : 0;
+
+    if (test_checkpoint_save(s->id, ckpt, &s->plan, &s->limits) == ESP_OK) {
+        s->checkpoint_count++;
+    } else {
+        s->checkpoint_errors++;
+        test_post_error(s, "CHECKPOINT", ESP_FAIL);
+    }
+    test_phase_end(&s->phase_stats, TEST_PHASE_SD, start_us);
 }
 
 /**
  * @brief 测试任务主循环
+ *
+ * 按测试计划逐拍执行：步骤开始时切换输出，驻留指定周期数后
+ * 每个周期采样一次，采样完成后在同一节拍切换到下一图案或下一步骤。
+ * 带图案的步骤由迭代器逐个计算输出，每个图案各自驻留和采样。
+ * 每个运行中的会话一个任务，arg为会话。
+ * 从检查点恢复时，从检查点记录的步骤、图案和剩余驻留/采样次数继续
  */
 static void test_task_main(void *arg)
 {
-    ESP_LOGI(TAG, "测试任务启动 - 终端将持续打印测试数据");
+    test_session_t *s = (test_session_t *)arg;
+    ESP_LOGI(TAG, "会话%d测试任务启动 - 计划: %s (%d个步骤)", s->id, s->plan.name, s->plan.step_count);
     
-    while (g_test_status.running) {
-        if (xSemaphoreTake(test_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-            g_test_status.cycle_count++;
-            
-            // 1. 读取ADS1115数据
-            ads1115_channel_data_t channel_data[ADS1115_CHANNEL_COUNT];
-            if (ads1115_get_handle() != NULL) {
-                if (ads1115_read_all_detailed(channel_data) == ESP_OK) {
-                    // 写入数据到SD卡
-                    write_test_data_to_sd(channel_data);
-                }
+    const test_step_t *steps = s->plan.steps;
+    const uint16_t step_count = s->plan.step_count;
+    const uint32_t period_ms = s->status.period_ms;
+    
+    // 进入第一个步骤(或检查点的步骤)，图案只在会话的引脚上展开
+    uint16_t step_index = s->resumed ? s->checkpoint.step_index : 0;
+    test_pattern_iter_t pattern;
+    test_pattern_begin(&pattern, steps[step_index].pattern, steps[step_index].pattern_mask & s->io_mask,
+                       steps[step_index].output);
+    if (s->resumed) {
+        // 图案由迭代器逐个计算，推进到检查点记录的图案
+        while (pattern.index < s->checkpoint.pattern_index && test_pattern_next(&pattern)) {
+        }
+    }
+    s->status.current_step = step_index;
+    s->status.pattern_index = pattern.index;
+    s->status.pattern_count = pattern.count;
+    if (test_apply_step(s, &steps[step_index], pattern.output, true) && s->capture_config.enabled) {
+        test_capture_step(s, step_index);
+    }
+    uint32_t dwell_left = test_plan_dwell_ticks(&steps[step_index], period_ms);
+    uint8_t samples_left = steps[step_index].samples;
+    if (s->resumed) {
+        dwell_left = s->checkpoint.dwell_left;
+        samples_left = s->checkpoint.samples_left;
+    }
+    int64_t checkpoint_us = esp_timer_get_time();
+    
+    // 由周期定时器驱动循环，周期不受本循环耗时影响
+    if (test_scheduler_start(&s->scheduler, xTaskGetCurrentTaskHandle(), period_ms) != ESP_OK) {
+        ESP_LOGE(TAG, "调度器启动失败，测试任务退出");
+        s->status.running = false;
+    }
+    
+    while (s->status.running) {
+        // 等待下一个节拍
+        test_scheduler_tick_t tick;
+        if (test_scheduler_wait(&s->scheduler, &tick, pdMS_TO_TICKS(period_ms + 100)) != ESP_OK) {
+            continue;
+        }
+        
+        if (tick.missed > 0) {
+            s->status.overrun_count++;
+            s->status.missed_ticks += tick.missed;
+            ESP_LOGW(TAG, "会话%d测试循环超时，丢失 %lu 个节拍", s->id, tick.missed);
+        }
+        s->status.last_lateness_us = tick.lateness_us;
+        if (tick.lateness_us > s->status.max_lateness_us) {
+            s->status.max_lateness_us = tick.lateness_us;
+        }
+        
+        if (xSemaphoreTake(s->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+            continue;
+        }
+        s->status.cycle_count++;
+        
+        if (dwell_left > 0) {
+            dwell_left--;
+        }
+        
+        if (dwell_left == 0) {
+            const test_step_t *step = &steps[step_index];
+            if (samples_left > 0) {
+                test_sample_step(s, step, &tick);
+                samples_left--;
             }
             
-            // 2. 控制TCA9535 IO (循环拉低0-7)
-            tca9535_handle_t tca_handle = get_tca9535_handle();
-            if (tca_handle != NULL) {
-                // 先将所有IO设为高电平
-                tca9535_register_t output_reg = {.word = 0xFFFF};
-                tca9535_write_output(tca_handle, &output_reg);
-                
-                // 拉低当前IO
-                if (g_test_status.current_io < 8) {
-                    output_reg.ports.port0.byte = 0xFF & ~(1 << g_test_status.current_io);
-                    output_reg.ports.port1.byte = 0xFF; // 保持P1口全高
-                    tca9535_write_output(tca_handle, &output_reg);
+            // 采样完成，切换到下一图案，图案全部完成后切换到下一步骤
+            if (samples_left == 0 && !test_pattern_next(&pattern)) {
+                if (++step_index >= step_count) {
+                    step_index = 0;
+                    s->status.plan_loops++;
+                    if (s->plan.repeat > 0 && s->status.plan_loops >= s->plan.repeat) {
+                        s->plan_completed = true;
+                        s->status.running = false;
+                    }
                 }
                 
-                // 切换到下一个IO
-                g_test_status.current_io = (g_test_status.current_io + 1) % TEST_IO_COUNT;
+                if (s->status.running) {
+                    step = &steps[step_index];
+                    s->status.current_step = step_index;
+                    test_pattern_begin(&pattern, step->pattern, step->pattern_mask & s->io_mask, step->output);
+                    s->status.pattern_count = pattern.count;
+                }
             }
             
-            // 3. 控制LED循环点亮
-            // 先关闭所有LED
-            led_set_all_state(LED_OFF);
-            // 点亮当前LED
-            led_set_state((led_num_t)g_test_status.current_led, LED_ON);
-            // 切换到下一个LED
-            g_test_status.current_led = (g_test_status.current_led % TEST_LED_COUNT) + 1;
-            
-            // 4. 持续打印测试数据到Shell终端
-            if (test_channel_id > 0) {
-                char output[512];
-                uint8_t display_io = (g_test_status.current_io == 0) ? 8 : g_test_status.current_io; // 显示1-8
-                uint8_t display_led = (g_test_status.current_led == 1) ? 4 : g_test_status.current_led - 1; // 显示实际点亮的LED
-                
-                            shell_snprintf(output, sizeof(output), "\r\n=== 测试循环 %lu ===\r\n", g_test_status.cycle_count);
-            cmd_output(test_channel_id, (uint8_t *)output, strlen(output));
-
-            shell_snprintf(output, sizeof(output), "当前拉低IO: %d | 当前点亮LED: %d\r\n", display_io, display_led);
-            cmd_output(test_channel_id, (uint8_t *)output, strlen(output));
-                
-                                // 打印ADS1115数据到Shell终端
-                if (ads1115_get_handle() != NULL) {
-                    shell_snprintf(output, sizeof(output), "ADS1115数据: ");
-                    for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT; ch++) {
-                        char ch_data[64];
-                        if (channel_data[ch].status == ESP_OK) {
-                            snprintf(ch_data, sizeof(ch_data), "CH%d:%.4fV,%.2fmA ",
-                                   ch, channel_data[ch].voltage_v, channel_data[ch].current_ma);
-                        } else {
-                            snprintf(ch_data, sizeof(ch_data), "CH%d:ERROR ", ch);
-                        }
-                        strncat(output, ch_data, sizeof(output) - strlen(output) - 1);
-                    }
-                    strncat(output, "\r\n", sizeof(output) - strlen(output) - 1);
-                    cmd_output(test_channel_id, (uint8_t *)output, strlen(output));
-                } else {
-                    shell_snprintf(output, sizeof(output), "ADS1115: 未连接\r\n");
-                    cmd_output(test_channel_id, (uint8_t *)output, strlen(output));
+            if (samples_left == 0 && s->status.running) {
+                s->status.pattern_index = pattern.index;
+                if (test_apply_step(s, step, pattern.output, false) && s->capture_config.enabled) {
+                    test_capture_step(s, step_index);
                 }
-                
-                snprintf(output, sizeof(output), "==================\r\n");
-                cmd_output(test_channel_id, (uint8_t *)output, strlen(output));
+                dwell_left = test_plan_dwell_ticks(step, period_ms);
+                samples_left = step->samples;
             }
-            
-            xSemaphoreGive(test_mutex);
         }
         
-        // 等待指定间隔
-        vTaskDelay(pdMS_TO_TICKS(TEST_CYCLE_INTERVAL_MS));
+        // 循环耗时从节拍唤醒开始计算
+        test_phase_end(&s->phase_stats, TEST_PHASE_CYCLE, tick.timestamp_us);
+        
+        // 定期写入检查点，复位后可从这里继续
+        if (s->checkpoint_s > 0 && s->status.running &&
+            tick.timestamp_us - checkpoint_us >= s->checkpoint_s * 1000000LL) {
+            test_save_checkpoint(s, step_index, &pattern, dwell_left, samples_left);
+            checkpoint_us = tick.timestamp_us;
+        }
+        xSemaphoreGive(s->mutex);
+    }
+    
+    test_scheduler_stop(&s->scheduler);
+    if (s->trigger_config.enabled) {
+        test_trigger_stop();
+    }
+    if (s->capture_config.enabled) {
+        test_capture_end();
+    }
+    
+    xSemaphoreTake(s->mutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < TEST_SESSION_MAX_VIEWERS; i++) {
+        test_console_end(&s->consoles[i]);
     }
+    xSemaphoreGive(s->mutex);
     
-    // 测试结束，关闭所有LED和IO
-    led_set_all_state(LED_OFF);
+    // 测试结束，只关闭本会话的LED和IO，其他会话继续运行
+    for (uint8_t i = 0; i < TEST_LED_COUNT; i++) {
+        if (s->led_mask & (1 << i)) {
+            led_set_state((led_num_t)(LED_1 + i), LED_OFF);
+        }
+    }
     tca9535_handle_t tca_handle = get_tca9535_handle();
     if (tca_handle != NULL) {
-        tca9535_register_t output_reg = {0};
-        tca9535_write_output(tca_handle, &output_reg);
+        test_write_output(s, tca_handle, 0);
+    }
+    
+    // 写出所有事件后再追加结束标记，测试正常结束后不再需要检查点
+    test_event_close(s->id - 1);
+    test_write_session_footer(s);
+    test_checkpoint_clear(s->id);
+    
+    // 计划自行执行完毕时通知会话的所有终端并取消按键订阅
+    if (s->plan_completed) {
+        key_unsubscribe(key_event_handler, s);
+        if (!test_other_running(s)) {
+            key_stop_detection();
+        }
+        
+        char output[256];
+        shell_snprintf(output, sizeof(output),
+                       "\r\n=== 会话%d测试计划执行完毕 ===\r\n"
+                       "完成 %lu 轮, 总循环次数: %lu\r\n",
+                       s->id, s->status.plan_loops, s->status.cycle_count);
+        test_session_broadcast(s, output);
+        for (uint8_t i = 0; i < TEST_SESSION_MAX_VIEWERS; i++) {
+            if (s->channels[i] != 0) {
+                test_output_verdict(s, s->channels[i]);
+            }
+        }
+        shell_snprintf(output, sizeof(output), "==================\r\n");
+        test_session_broadcast(s, output);
     }
     
-    ESP_LOGI(TAG, "测试任务结束");
-    test_task_handle = NULL;
+    ESP_LOGI(TAG, "会话%d测试任务结束", s->id);
+    s->task_handle = NULL;
+    s->active = false;
+    xSemaphoreGive(s->stopped);
     vTaskDelete(NULL);
 }
 
 esp_err_t test_module_init(void)
 {
-    test_mutex = xSemaphoreCreateMutex();
-    if (test_mutex == NULL) {
-        ESP_LOGE(TAG, "创建测试互斥锁失败");
+    fixture_mutex = xSemaphoreCreateMutex();
+    if (fixture_mutex == NULL) {
+        ESP_LOGE(TAG, "创建夹具互斥锁失败");
         return ESP_FAIL;
     }
     
-    // 初始化测试状态
-    memset(&g_test_status, 0, sizeof(test_status_t));
-    g_test_status.current_led = 1;  // 从LED1开始
+    // 会话在通道第一次使用test命令时分配，互斥锁预先创建
+    for (uint8_t i = 0; i < TEST_MAX_SESSIONS; i++) {
+        memset(&sessions[i], 0, sizeof(test_session_t));
+        sessions[i].mutex = xSemaphoreCreateMutex();
+        sessions[i].stopped = xSemaphoreCreateBinary();
+        sessions[i].control = xSemaphoreCreateMutex();
+        if (sessions[i].mutex == NULL || sessions[i].stopped == NULL || sessions[i].control == NULL) {
+            ESP_LOGE(TAG, "创建测试互斥锁失败");
+            return ESP_FAIL;
+        }
+    }
     
-    ESP_LOGI(TAG, "测试模块初始化成功");
+    ESP_LOGI(TAG, "测试模块初始化成功 (最多%d个会话)", TEST_MAX_SESSIONS);
     return ESP_OK;
 }
 
-const test_status_t* test_get_status(void)
+const test_status_t* test_get_status(uint8_t session)
 {
-    return &g_test_status;
+    const test_session_t *s = test_session_by_id(session);
+    return s != NULL ? &s->status : NULL;
+}
+
+/**
+ * @brief 循环周期短于一次ADC扫描时追加提示
+ *
+ * 采样节拍要完成一次ads1115_read_all_detailed扫描，有实测值时按本会话ADC阶段的
+ * 平均耗时，否则按标称耗时比较；启用触发捕获时采样取捕获任务的最新样本，不需要扫描
+ */
+static void test_append_period_warning(const test_session_t *s, char *buffer, size_t size)
+{
+    if (s->trigger_config.enabled) {
+        return;
+    }
+
+    test_phase_stat_t adc;
+    test_phase_get(&s->phase_stats, TEST_PHASE_ADC, &adc);
+    uint32_t scan_ms = adc.count > 0 ? (uint32_t)((adc.total_us / adc.count + 999) / 1000) : ADS1115_SCAN_MS;
+    if (s->period_ms < scan_ms) {
+        snprintf(buffer, size, "警告: 循环周期小于一次ADC扫描的%s耗时(%lums)，采样节拍会超时并丢失后续节拍\r\n",
+                 adc.count > 0 ? "实测" : "标称", scan_ms);
+    }
+}
+
+/* 启动测试的准备进度，失败时按进度倒序撤销 */
+typedef enum {
+    TEST_START_RESERVED = 0,                             // 已预留夹具
+    TEST_START_CAPTURE,                                  // 已分配稳定捕获缓冲区
+    TEST_START_TRIGGER,                                  // 已布防触发捕获
+    TEST_START_EVENT,                                    // 已打开日志流
+    TEST_START_CONSOLE,                                  // 已开始终端输出并订阅按键
+} test_start_stage_t;
+
+/**
+ * @brief 启动失败时撤销已完成的准备步骤，释放夹具预留
+ *
+ * @param stage 已完成的最后一步
+ */
+static void test_session_unwind(test_session_t *s, test_start_stage_t stage)
+{
+    switch (stage) {
+        case TEST_START_CONSOLE:
+            key_unsubscribe(key_event_handler, s);
+            if (!test_other_running(s)) {
+                key_stop_detection();
+            }
+            xSemaphoreTake(s->mutex, portMAX_DELAY);
+            for (uint8_t i = 0; i < TEST_SESSION_MAX_VIEWERS; i++) {
+                test_console_end(&s->consoles[i]);
+            }
+            xSemaphoreGive(s->mutex);
+            /* fall through */
+        case TEST_START_EVENT:
+            test_event_close(s->id - 1);
+            /* fall through */
+        case TEST_START_TRIGGER:
+            if (s->trigger_config.enabled) {
+                test_trigger_stop();
+            }
+            /* fall through */
+        case TEST_START_CAPTURE:
+            if (s->capture_config.enabled) {
+                test_capture_end();
+            }
+            /* fall through */
+        case TEST_START_RESERVED:
+            s->status.running = false;
+            s->active = false;
+            break;
+    }
+}
+
+/**
+ * @brief 启动会话的测试，调用者持有会话的control锁
+ *
+ * @param resume true: 从已加载到会话的检查点继续，计数和限值统计保持检查点的值
+ */
+static void test_session_start_locked(test_session_t *s, uint32_t channel_id, bool resume)
+{
+    char response[1024];
+    
+    if (s->status.running) {
+        shell_snprintf(response, sizeof(response), "测试已在运行中，使用 'testoff' 停止测试\r\n");
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+        return;
+    }
+    
+    // 上次停止超时的测试任务可能仍在驱动引脚，退出前不能重新启动
+    if (s->active) {
+        shell_snprintf(response, sizeof(response), "错误: 会话%d的测试任务正在停止，使用 'testoff' 等待其结束\r\n", s->id);
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+        return;
+    }
+    
+    // 检查必要的组件是否可用
+    if (!sd_card_is_mounted()) {
+        shell_snprintf(response, sizeof(response), "错误: SD卡未挂载，无法记录日志\r\n");
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+        return;
+    }
+    
+    if (ads1115_get_handle() == NULL) {
+        shell_snprintf(response, sizeof(response), "警告: ADS1115未连接，将跳过数据记录\r\n");
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+    }
+    
+    if (get_tca9535_handle() == NULL) {
+        shell_snprintf(response, sizeof(response), "警告: TCA9535未连接，将跳过IO控制\r\n");
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+    }
+    
+    // 与运行中的会话共用夹具时，各自只控制自己的引脚和LED
+    char reason[48];
+    const test_session_t *conflict = test_session_reserve(s, reason, sizeof(reason));
+    if (conflict != NULL) {
+        shell_snprintf(response, sizeof(response), "错误: %s已被会话%d(通道%lu)占用，使用 'test pins' 划分夹具\r\n",
+                       reason, conflict->id, conflict->channels[0]);
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+        return;
+    }
+    
+    // 按计划步骤数准备限值统计，恢复时沿用检查点的统计
+    if (!resume && test_limits_init(&s->limits, s->plan.step_count) != ESP_OK) {
+        test_session_unwind(s, TEST_START_RESERVED);
+        shell_snprintf(response, sizeof(response), "错误: 内存不足，无法分配限值统计\r\n");
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+        return;
+    }
+    
+    // 按捕获窗口分配波形缓冲区
+    if (s->capture_config.enabled && test_capture_begin(&s->capture_config) != ESP_OK) {
+        test_session_unwind(s, TEST_START_RESERVED);
+        shell_snprintf(response, sizeof(response), "错误: 无法分配稳定捕获缓冲区\r\n");
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+        return;
+    }
+    
+    // 触发捕获在测试任务之前布防，第一步的IO切换即可触发
+    if (s->trigger_config.enabled && ads1115_get_handle() != NULL) {
+        const test_step_t *step = &s->plan.steps[resume ? s->checkpoint.step_index : 0];
+        test_pattern_iter_t first;
+        test_pattern_begin(&first, step->pattern, step->pattern_mask & s->io_mask, step->output);
+        test_trigger_set_context(0, (step - s->plan.steps) + 1, first.output & s->io_mask);
+        esp_err_t trig_ret = test_trigger_start(&s->trigger_config);
+        if (trig_ret != ESP_OK) {
+            test_session_unwind(s, TEST_START_CAPTURE);
+            shell_snprintf(response, sizeof(response), "错误: 触发捕获启动失败: %s\r\n", esp_err_to_name(trig_ret));
+            cmd_output(channel_id, (uint8_t *)response, strlen(response));
+            return;
+        }
+    }
+    
+    // 检查是否已存在日志文件，如果存在则添加分界线
+    struct stat st;
+    if (resume && stat(s->log_path, &st) == 0) {
+        // 复位前的日志没有结束标记，检查点之后到复位之前的循环会重新执行
+        FILE *file = fopen(s->log_path, "a");
+        if (file != NULL) {
+            fprintf(file, "\n=== 从检查点恢复 ===\n");
+            fprintf(file, "会话: %d (通道%lu, IO掩码0x%04X, LED掩码0x%X)\n", s->id, channel_id, s->io_mask, s->led_mask);
+            fprintf(file, "检查点#%lu: 循环%lu, 步骤%d, 图案%lu, 已运行%lu ms\n", s->checkpoint.sequence,
+                    s->checkpoint.status.cycle_count, s->checkpoint.step_index + 1,
+                    s->checkpoint.pattern_index + 1, s->checkpoint.elapsed_ms);
+            fprintf(file, "检查点时日志长度%lu字节, 复位前%ld字节，其间记录的循环%lu之后的数据将重新测试\n",
+                    s->checkpoint.log_size, (long)st.st_size, s->checkpoint.status.cycle_count);
+            fprintf(file, TEST_EVENT_CSV_HEADER);
+            fclose(file);
+        }
+    } else if (stat(s->log_path, &st) == 0) {
+        FILE *file = fopen(s->log_path, "a");
+        if (file != NULL) {
+            fprintf(file, "\n=== 新测试会话开始 ===\n");
+            fprintf(file, "会话: %d (通道%lu, IO掩码0x%04X, LED掩码0x%X)\n", s->id, channel_id, s->io_mask, s->led_mask);
+            fprintf(file, "测试计划: %s (%d个步骤)\n", s->plan.name, s->plan.step_count);
+            fprintf(file, TEST_EVENT_CSV_HEADER);
+            fclose(file);
+        }
+    } else {
+        // 创建新文件并写入表头
+        FILE *file = fopen(s->log_path, "w");
+        if (file != NULL) {
+            fprintf(file, "=== ESP32模拟板测试日志 ===\n");
+            fprintf(file, "会话: %d (通道%lu, IO掩码0x%04X, LED掩码0x%X)\n", s->id, channel_id, s->io_mask, s->led_mask);
+            fprintf(file, "测试计划: %s (%d个步骤)\n", s->plan.name, s->plan.step_count);
+            fprintf(file, TEST_EVENT_CSV_HEADER);
+            fclose(file);
+        }
+    }
+    
+    // 日志文件此后只由日志任务写入，直到测试任务退出
+    if (test_event_open(s->id - 1, s->log_path, &s->phase_stats) != ESP_OK) {
+        test_session_unwind(s, TEST_START_TRIGGER);
+        shell_snprintf(response, sizeof(response), "错误: 无法打开日志流\r\n");
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+        return;
+    }
+    
+    // 启动测试，阶段耗时统计由所有会话共用，只在没有其他会话运行时清空
+    if (resume) {
+        // 计数从检查点继续，测试时长包含复位前的部分
+        s->status = s->checkpoint.status;
+        s->status.running = true;
+        s->status.start_time_ms = xTaskGetTickCount() * portTICK_PERIOD_MS - s->checkpoint.elapsed_ms;
+        s->status.period_ms = s->period_ms;
+    } else {
+        s->status.cycle_count = 0;
+        s->status.current_step = 0;
+        s->status.plan_loops = 0;
+        s->status.start_time_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        s->status.period_ms = s->period_ms;
+        s->status.overrun_count = 0;
+        s->status.missed_ticks = 0;
+        s->status.last_lateness_us = 0;
+        s->status.max_lateness_us = 0;
+        
+        // 删除上一次测试遗留的检查点，序号从头开始
+        memset(&s->checkpoint, 0, sizeof(s->checkpoint));
+        test_checkpoint_clear(s->id);
+    }
+    s->checkpoint_count = 0;
+    s->checkpoint_errors = 0;
+    s->resumed = resume;
+    test_phase_reset(&s->phase_stats);
+    s->plan_completed = false;
+    
+    // 所属通道和观察者各自一个终端输出级
+    xSemaphoreTake(s->mutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < TEST_SESSION_MAX_VIEWERS; i++) {
+        if (s->channels[i] != 0) {
+            test_console_begin(&s->consoles[i], &s->console_config, s->channels[i], UART_BAUD_RATE);
+        }
+    }
+    xSemaphoreGive(s->mutex);
+    
+    // 订阅按键事件并启动按键检测，按键由所有会话共用
+    key_subscribe(key_event_handler, s);
+    if (!test_other_running(s)) {
+        key_start_detection();
+    }
+    
+    // 创建测试任务，清除上次运行留下的结束信号
+    xSemaphoreTake(s->stopped, 0);
+    char task_name[16];
+    snprintf(task_name, sizeof(task_name), "test_task%d", s->id);
+    BaseType_t ret = xTaskCreate(test_task_main, task_name, 4096, s, 5, &s->task_handle);
+    if (ret == pdPASS) {
+        shell_snprintf(response, sizeof(response),
+                "=== 自动化测试启动 (会话%d) ===\r\n"
+                "测试计划: %s (%d个步骤, 重复: %lu轮, 0为无限)\r\n"
+                "功能:\r\n"
+                "- ADS1115数据记录到SD卡 (%s)\r\n"
+                "- 按计划切换TCA9535 IO(掩码0x%04X)和LED(掩码0x%X)\r\n"
+                "- 循环周期: %lums (定时器驱动)\r\n"
+                "- 终端输出模式: %s (限速，超出带宽时丢弃)\r\n"
+                "- 按键检测(GPIO35)和事件记录\r\n"
+                "\r\n"
+                "使用 'testoff' 停止测试\r\n"
+                "Shell将开始持续显示测试数据...\r\n"
+                "========================\r\n",
+                s->id, s->plan.name, s->plan.step_count, s->plan.repeat, s->log_path,
+                s->io_mask, s->led_mask, s->period_ms,
+                test_console_mode_str(s->console_config.mode));
+        size_t len = strlen(response);
+        test_append_period_warning(s, response + len, sizeof(response) - len);
+        ESP_LOGI(TAG, "会话%d自动化测试启动成功 - 终端将持续打印数据", s->id);
+    } else {
+        test_session_unwind(s, TEST_START_CONSOLE);
+        shell_snprintf(response, sizeof(response), "错误: 无法创建测试任务\r\n");
+        ESP_LOGE(TAG, "创建测试任务失败");
+    }
+    
+    cmd_output(channel_id, (uint8_t *)response, strlen(response));
+}
+
+/**
+ * @brief 启动会话的测试
+ *
+ * testoff是紧急命令，在Shell控制任务中与普通命令并行执行；
+ * 启动和停止持有同一把锁，停止不会落在预留会话和创建测试任务之间
+ */
+static void test_session_start(test_session_t *s, uint32_t channel_id, bool resume)
+{
+    xSemaphoreTake(s->control, portMAX_DELAY);
+    test_session_start_locked(s, channel_id, resume);
+    xSemaphoreGive(s->control);
+}
+
+/**
+ * @brief 添加/移除会话的观察者通道
+ *
+ * 观察者接收会话的采样行、按键事件和测试结论，运行中添加立即生效
+ */
+static void test_session_watch(test_session_t *s, uint32_t channel_id, bool watch)
+{
+    xSemaphoreTake(s->mutex, portMAX_DELAY);
+    for (uint8_t i = 1; i < TEST_SESSION_MAX_VIEWERS; i++) {
+        if (!watch && s->channels[i] == channel_id) {
+            test_console_end(&s->consoles[i]);
+            s->channels[i] = 0;
+        } else if (watch && s->channels[i] == 0) {
+            s->channels[i] = channel_id;
+            if (s->status.running) {
+                test_console_begin(&s->consoles[i], &s->console_config, channel_id, UART_BAUD_RATE);
+            }
+            break;
+        }
+    }
+    xSemaphoreGive(s->mutex);
+}
+
+/**
+ * @brief 通道是否为会话的观察者
+ */
+static bool test_session_is_viewer(const test_session_t *s, uint32_t channel_id)
+{
+    for (uint8_t i = 1; i < TEST_SESSION_MAX_VIEWERS; i++) {
+        if (s->channels[i] == channel_id) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void task_test_control(uint32_t channel_id, const char *params)
 {
-    char response[512];
+    char response[1024];
+    
+    // 每个通道操作自己的会话，第一次使用时分配
+    test_session_t *s = test_session_get(channel_id, true);
+    if (s == NULL) {
+        shell_snprintf(response, sizeof(response), "错误: 测试会话已满(最多%d个)\r\n", TEST_MAX_SESSIONS);
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+        return;
+    }
     
     // test命令直接开始测试，无需参数
     if (strlen(params) == 0) {
-        if (g_test_status.running) {
-            shell_snprintf(response, sizeof(response), "测试已在运行中，使用 'testoff' 停止测试\r\n");
+        test_session_start(s, channel_id, false);
+        return;
+    } else if (strncmp(params, "period", 6) == 0 && (params[6] == '\0' || params[6] == ' ')) {
+        // 设置循环周期
+        const char *value = params + 6;
+        while (*value == ' ') value++; // 跳过空格
+        
+        if (strlen(value) == 0) {
+            shell_snprintf(response, sizeof(response), "当前循环周期: %lums\r\n", s->period_ms);
+        } else if (s->active) {
+            shell_snprintf(response, sizeof(response), "错误: 测试运行中，请先使用 'testoff' 停止测试\r\n");
+        } else {
+            int period_ms = atoi(value);
+            if (period_ms >= TEST_CYCLE_MIN_INTERVAL_MS && period_ms <= TEST_CYCLE_MAX_INTERVAL_MS) {
+                s->period_ms = (uint32_t)period_ms;
+                shell_snprintf(response, sizeof(response), "循环周期已设置为 %lums\r\n", s->period_ms);
+                size_t len = strlen(response);
+                test_append_period_warning(s, response + len, sizeof(response) - len);
+            } else {
+                shell_snprintf(response, sizeof(response), "错误: 无效的循环周期 '%s'，范围 %d-%d ms\r\n",
+                        value, TEST_CYCLE_MIN_INTERVAL_MS, TEST_CYCLE_MAX_INTERVAL_MS);
+            }
+        }
+    } else if (strncmp(params, "plan", 4) == 0 && (params[4] == '\0' || params[4] == ' ')) {
+        // 查看/加载测试计划
+        const char *arg = params + 4;
+        while (*arg == ' ') arg++; // 跳过空格
+        
+        if (strlen(arg) == 0) {
+            shell_snprintf(response, sizeof(response), "=== 测试计划: %s ===\r\n重复: %lu轮(0为无限), 步骤数: %d, 每轮输出: %lu\r\n",
+                    s->plan.name, s->plan.repeat, s->plan.step_count, test_plan_output_count(&s->plan));
             cmd_output(channel_id, (uint8_t *)response, strlen(response));
-            return;
+            
+            for (uint16_t i = 0; i < s->plan.step_count; i++) {
+                const test_step_t *step = &s->plan.steps[i];
+                int len = shell_snprintf(response, sizeof(response), "%3d: out=0x%04X led=0x%X dwell=%lu samples=%d",
+                        i + 1, step->output, step->led_mask, step->dwell_ms, step->samples);
+                if (step->pattern != TEST_PATTERN_NONE && len > 0 && len < (int)sizeof(response)) {
+                    len += snprintf(response + len, sizeof(response) - len, " pattern=%s mask=0x%04X(%lu个)",
+                            test_pattern_name(step->pattern), step->pattern_mask,
+                            test_pattern_count(step->pattern, step->pattern_mask));
+                }
+                for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT && len > 0 && len < (int)sizeof(response); ch++) {
+                    if (step->limit_mask & (1 << ch)) {
+                        len += snprintf(response + len, sizeof(response) - len, " ch%d=%.2f:%.2f",
+                                ch, step->min_ma[ch], step->max_ma[ch]);
+                    }
+                }
+                strncat(response, "\r\n", sizeof(response) - strlen(response) - 1);
+                cmd_output(channel_id, (uint8_t *)response, strlen(response));
+            }
+            shell_snprintf(response, sizeof(response), "==================\r\n");
+        } else if (s->active) {
+            shell_snprintf(response, sizeof(response), "错误: 测试运行中，请先使用 'testoff' 停止测试\r\n");
+        } else if (strcmp(arg, "default") == 0) {
+            if (test_plan_load_default(&s->plan) == ESP_OK) {
+                shell_snprintf(response, sizeof(response), "已切换到内置默认计划 (%d个步骤)\r\n", s->plan.step_count);
+            } else {
+                shell_snprintf(response, sizeof(response), "错误: 内存不足\r\n");
+            }
+        } else if (strncmp(arg, "load", 4) == 0 && (arg[4] == '\0' || arg[4] == ' ')) {
+            const char *path = arg + 4;
+            while (*path == ' ') path++; // 跳过空格
+            if (strlen(path) == 0) {
+                path = TEST_PLAN_DEFAULT_PATH;
+            }
+            
+            char error[128];
+            if (!sd_card_is_mounted()) {
+                shell_snprintf(response, sizeof(response), "错误: SD卡未挂载\r\n");
+            } else if (test_plan_load_file(&s->plan, path, error, sizeof(error)) == ESP_OK) {
+                shell_snprintf(response, sizeof(response), "测试计划加载成功: %s (%d个步骤, 重复%lu轮)\r\n",
+                        s->plan.name, s->plan.step_count, s->plan.repeat);
+            } else {
+                shell_snprintf(response, sizeof(response), "错误: 测试计划加载失败: %s\r\n", error);
+            }
+        } else if (strncmp(arg, "pattern", 7) == 0 && arg[7] == ' ') {
+            // 不依赖SD卡文件，直接生成单步骤图案计划
+            char name[16] = {0};
+            unsigned int mask = 0xFFFF;
+            unsigned int dwell_ms = 0;
+            test_pattern_type_t type;
+            int argc = sscanf(arg + 8, "%15s %x %u", name, &mask, &dwell_ms);
+            
+            if (argc < 1 || test_pattern_parse(name, &type) != ESP_OK || type == TEST_PATTERN_NONE) {
+                shell_snprintf(response, sizeof(response), "错误: 未知图案 '%s' (walk1/walk0/gray/pairs)\r\n", name);
+            } else if (mask == 0 || mask > 0xFFFF) {
+                shell_snprintf(response, sizeof(response), "错误: 无效的引脚掩码\r\n");
+            } else {
+                esp_err_t ret = test_plan_load_pattern(&s->plan, type, (uint16_t)mask, dwell_ms);
+                if (ret == ESP_OK) {
+                    shell_snprintf(response, sizeof(response), "已生成图案计划: %s (%lu个输出, 每个驻留%ums)\r\n",
+                            s->plan.name, test_plan_output_count(&s->plan), dwell_ms);
+                } else if (ret == ESP_ERR_INVALID_ARG) {
+                    shell_snprintf(response, sizeof(response), "错误: 掩码引脚数不足以构成%s图案\r\n", name);
+                } else {
+                    shell_snprintf(response, sizeof(response), "错误: 内存不足\r\n");
+                }
+            }
+        } else {
+            shell_snprintf(response, sizeof(response), "用法: test plan [load [文件]|default|pattern <walk1|walk0|gray|pairs> [掩码] [驻留ms]]\r\n");
         }
+    } else if (strncmp(params, "checkpoint", 10) == 0 && (params[10] == '\0' || params[10] == ' ')) {
+        // 查看/设置检查点间隔
+        const char *value = params + 10;
+        while (*value == ' ') value++; // 跳过空格
         
-        // 检查必要的组件是否可用
-        if (!sd_card_is_mounted()) {
-            shell_snprintf(response, sizeof(response), "错误: SD卡未挂载，无法记录日志\r\n");
+        if (strlen(value) == 0) {
+            char interval[16];
+            if (s->checkpoint_s > 0) {
+                snprintf(interval, sizeof(interval), "每%lu秒", s->checkpoint_s);
+            } else {
+                snprintf(interval, sizeof(interval), "关闭");
+            }
+            shell_snprintf(response, sizeof(response), "检查点: %s, 已写入%lu次, 失败%lu次\r\n",
+                    interval, s->checkpoint_count, s->checkpoint_errors);
+        } else if (s->active) {
+            shell_snprintf(response, sizeof(response), "错误: 测试运行中，请先使用 'testoff' 停止测试\r\n");
+        } else if (strcmp(value, "off") == 0) {
+            s->checkpoint_s = 0;
+            shell_snprintf(response, sizeof(response), "检查点已关闭\r\n");
+        } else {
+            int seconds = atoi(value);
+            if (seconds >= 1 && seconds <= TEST_CHECKPOINT_MAX_S) {
+                s->checkpoint_s = (uint32_t)seconds;
+                shell_snprintf(response, sizeof(response), "检查点间隔已设置为 %d秒\r\n", seconds);
+            } else {
+                shell_snprintf(response, sizeof(response), "错误: 检查点间隔范围1-%d秒，或off\r\n", TEST_CHECKPOINT_MAX_S);
+            }
+        }
+    } else if (strncmp(params, "resume", 6) == 0 && (params[6] == '\0' || params[6] == ' ')) {
+        // 从检查点继续测试，默认本会话的检查点
+        int from = params[6] == ' ' ? atoi(params + 7) : s->id;
+        esp_err_t ret;
+        
+        if (s->status.running) {
+            shell_snprintf(response, sizeof(response), "测试已在运行中，使用 'testoff' 停止测试\r\n");
+        } else if (s->active) {
+            // 退出中的测试任务仍在读取计划和限值统计，不能重新加载
+            shell_snprintf(response, sizeof(response), "错误: 会话%d的测试任务正在停止，使用 'testoff' 等待其结束\r\n", s->id);
+        } else if (!sd_card_is_mounted()) {
+            shell_snprintf(response, sizeof(response), "错误: SD卡未挂载\r\n");
+        } else if (from < 1 || from > TEST_MAX_SESSIONS) {
+            shell_snprintf(response, sizeof(response), "用法: test resume [会话号1-%d]\r\n", TEST_MAX_SESSIONS);
+        } else if ((ret = test_checkpoint_load(from, &s->checkpoint, &s->plan, &s->limits)) != ESP_OK) {
+            shell_snprintf(response, sizeof(response), "错误: %s\r\n",
+                    ret == ESP_ERR_NO_MEM ? "内存不足" : "没有可恢复的检查点");
+        } else {
+            // 恢复检查点时的周期、夹具划分和日志文件
+            s->period_ms = s->checkpoint.period_ms;
+            s->io_mask = s->checkpoint.io_mask;
+            s->led_mask = s->checkpoint.led_mask;
+            strncpy(s->log_path, s->checkpoint.log_path, sizeof(s->log_path) - 1);
+            
+            shell_snprintf(response, sizeof(response), "从检查点#%lu恢复: 循环%lu, 步骤%d/%d, 已完成%lu轮\r\n",
+                    s->checkpoint.sequence, s->checkpoint.status.cycle_count,
+                    s->checkpoint.step_index + 1, s->plan.step_count, s->checkpoint.status.plan_loops);
             cmd_output(channel_id, (uint8_t *)response, strlen(response));
+            
+            test_session_start(s, channel_id, true);
+            
+            // 此后的检查点写入本会话
+            if (s->status.running && from != s->id) {
+                test_checkpoint_clear(from);
+            }
             return;
         }
+    } else if (strncmp(params, "pins", 4) == 0 && (params[4] == '\0' || params[4] == ' ')) {
+        // 查看/设置会话控制的IO引脚和LED，多个会话共用夹具时各自一部分
+        unsigned int io_mask = s->io_mask;
+        unsigned int led_mask = s->led_mask;
+        int argc = sscanf(params + 4, "%x %x", &io_mask, &led_mask);
         
-        if (ads1115_get_handle() == NULL) {
-            shell_snprintf(response, sizeof(response), "警告: ADS1115未连接，将跳过数据记录\r\n");
-            cmd_output(channel_id, (uint8_t *)response, strlen(response));
+        if (argc <= 0) {
+            shell_snprintf(response, sizeof(response), "会话%d: IO掩码0x%04X, LED掩码0x%X\r\n",
+                    s->id, s->io_mask, s->led_mask);
+        } else if (s->active) {
+            shell_snprintf(response, sizeof(response), "错误: 测试运行中，请先使用 'testoff' 停止测试\r\n");
+        } else if (io_mask > 0xFFFF || led_mask >= (1 << TEST_LED_COUNT)) {
+            shell_snprintf(response, sizeof(response), "错误: IO掩码范围0-0xFFFF，LED掩码范围0-0x%X\r\n",
+                    (1 << TEST_LED_COUNT) - 1);
+        } else {
+            s->io_mask = (uint16_t)io_mask;
+            s->led_mask = (uint8_t)led_mask;
+            shell_snprintf(response, sizeof(response), "会话%d已设置为 IO掩码0x%04X, LED掩码0x%X\r\n",
+                    s->id, s->io_mask, s->led_mask);
         }
+    } else if (strncmp(params, "console", 7) == 0 && (params[7] == '\0' || params[7] == ' ')) {
+        // 查看/设置终端输出模式
+        char mode_name[16] = {0};
+        char value[16] = {0};
+        int argc = sscanf(params + 7, "%15s %15s", mode_name, value);
+        test_console_mode_t mode;
         
-        if (get_tca9535_handle() == NULL) {
-            shell_snprintf(response, sizeof(response), "警告: TCA9535未连接，将跳过IO控制\r\n");
-            cmd_output(channel_id, (uint8_t *)response, strlen(response));
+        if (argc <= 0) {
+            const test_console_t *console = &s->consoles[0];
+            shell_snprintf(response, sizeof(response),
+                    "终端输出模式: %s (every=%lu, change=%.2fmA)\r\n"
+                    "输出: %lu行/%lu字节, 模式过滤: %lu, 限速丢弃: %lu\r\n",
+                    test_console_mode_str(s->console_config.mode),
+                    s->console_config.every_n, s->console_config.change_ma,
+                    console->printed_lines, console->printed_bytes,
+                    console->filtered_lines, console->dropped_lines);
+        } else if (test_console_parse_mode(mode_name, &mode) != ESP_OK) {
+            shell_snprintf(response, sizeof(response), "错误: 未知输出模式 '%s' (all/every/change/status/off)\r\n", mode_name);
+        } else {
+            test_console_config_t config = s->console_config;
+            bool valid = true;
+            config.mode = mode;
+            if (mode == TEST_CONSOLE_MODE_EVERY && argc == 2) {
+                int every_n = atoi(value);
+                valid = every_n > 0;
+                config.every_n = (uint32_t)every_n;
+            } else if (mode == TEST_CONSOLE_MODE_CHANGE && argc == 2) {
+                config.change_ma = strtof(value, NULL);
+                valid = config.change_ma > 0.0f;
+            }
+            
+            if (!valid) {
+                shell_snprintf(response, sizeof(response), "错误: 无效的参数 '%s'\r\n", value);
+            } else {
+                // 运行中切换模式立即生效，统计保持不变
+                if (xSemaphoreTake(s->mutex, pdMS_TO_TICKS(1000)) == pdTRUE) {
+                    s->console_config = config;
+                    for (uint8_t i = 0; i < TEST_SESSION_MAX_VIEWERS; i++) {
+                        s->consoles[i].config = config;
+                    }
+                    xSemaphoreGive(s->mutex);
+                }
+                shell_snprintf(response, sizeof(response), "终端输出模式已设置为 %s\r\n", test_console_mode_str(config.mode));
+            }
+        }
+    } else if (strncmp(params, "capture", 7) == 0 && (params[7] == '\0' || params[7] == ' ')) {
+        // 查看/设置IO切换后的稳定过程捕获
+        char onoff[8] = {0};
+        int channel = s->capture_config.channel;
+        int window_ms = (int)s->capture_config.window_ms;
+        int argc = sscanf(params + 7, "%7s %d %d", onoff, &channel, &window_ms);
+        
+        if (argc <= 0) {
+            const test_capture_stats_t *cap = test_capture_get_stats();
+            shell_snprintf(response, sizeof(response),
+                    "稳定捕获: %s, 通道CH%d, 窗口%lums (%dSPS连续转换)\r\n"
+                    "捕获%lu次, 失败%lu次, 未稳定%lu次, 最大稳定时间%luus, 最大峰值%.2fmA\r\n",
+                    s->capture_config.enabled ? "开启" : "关闭", s->capture_config.channel,
+                    s->capture_config.window_ms, ADS1115_CONTINUOUS_SPS,
+                    cap->capture_count, cap->error_count, cap->unsettled_count,
+                    cap->max_settle_us, cap->max_peak_ma);
+        } else if (s->active) {
+            shell_snprintf(response, sizeof(response), "错误: 测试运行中，请先使用 'testoff' 停止测试\r\n");
+        } else if (strcmp(onoff, "off") == 0) {
+            s->capture_config.enabled = false;
+            shell_snprintf(response, sizeof(response), "稳定捕获已关闭\r\n");
+        } else if (strcmp(onoff, "on") != 0) {
+            shell_snprintf(response, sizeof(response), "用法: test capture [on [通道] [窗口毫秒]|off]\r\n");
+        } else if (s->trigger_config.enabled) {
+            shell_snprintf(response, sizeof(response), "错误: 触发捕获已开启，两者都需独占ADC，请先 'test trigger off'\r\n");
+        } else if (channel < 0 || channel >= ADS1115_CHANNEL_COUNT ||
+                   window_ms < TEST_CAPTURE_MIN_WINDOW_MS || window_ms > TEST_CAPTURE_MAX_WINDOW_MS) {
+            shell_snprintf(response, sizeof(response), "错误: 通道范围0-%d，窗口范围%d-%dms\r\n",
+                    ADS1115_CHANNEL_COUNT - 1, TEST_CAPTURE_MIN_WINDOW_MS, TEST_CAPTURE_MAX_WINDOW_MS);
+        } else {
+            s->capture_config.enabled = true;
+            s->capture_config.channel = (uint8_t)channel;
+            s->capture_config.window_ms = (uint32_t)window_ms;
+            shell_snprintf(response, sizeof(response),
+                    "稳定捕获已开启: CH%d, 窗口%dms\r\n"
+                    "每次IO切换后捕获，捕获期间测试循环暂停，窗口应小于循环周期\r\n",
+                    channel, window_ms);
         }
+    } else if (strncmp(params, "trigger", 7) == 0 && (params[7] == '\0' || params[7] == ' ')) {
+        // 查看/设置触发捕获
+        const char *arg = params + 7;
+        while (*arg == ' ') arg++; // 跳过空格
         
-        // 检查是否已存在日志文件，如果存在则添加分界线
-        struct stat st;
-        if (stat(TEST_LOG_FILE_PATH, &st) == 0) {
-            FILE *file = fopen(TEST_LOG_FILE_PATH, "a");
-            if (file != NULL) {
-                fprintf(file, "\n=== 新测试会话开始 ===\n");
-                fprintf(file, "时间戳(ms),循环计数,拉低IO号(1-8),点亮LED号(1-4),CH0电压(V),CH0电流(mA),CH1电压(V),CH1电流(mA),CH2电压(V),CH2电流(mA),CH3电压(V),CH3电流(mA)\n");
-                fclose(file);
+        if (strlen(arg) == 0) {
+            const test_trigger_stats_t *trig = test_trigger_get_stats();
+            shell_snprintf(response, sizeof(response),
+                    "触发捕获: %s%s, 通道掩码0x%X, 触发源掩码0x%X, 自动重新布防: %s\r\n"
+                    "触发前%d点, 触发后%d点, 电平%.2fmA, 斜率%.2fmA\r\n"
+                    "样本%lu, 丢失节拍%lu, 读取失败%lu, 保存%lu次, 保存失败%lu次\r\n",
+                    s->trigger_config.enabled ? "开启" : "关闭",
+                    test_trigger_is_running() ? "(运行中)" : "",
+                    s->trigger_config.channel_mask, s->trigger_config.source_mask,
+                    s->trigger_config.auto_rearm ? "是" : "否",
+                    s->trigger_config.pre_samples, s->trigger_config.post_samples,
+                    s->trigger_config.level_ma, s->trigger_config.slope_ma,
+                    trig->sample_count, trig->missed_ticks, trig->read_errors,
+                    trig->saved_count, trig->save_errors);
+        } else if (strcmp(arg, "fire") == 0) {
+            // 手动触发只在运行中有效
+            if (test_trigger_is_running()) {
+                test_trigger_fire(TEST_CAPTURE_SOURCE_MANUAL);
+                shell_snprintf(response, sizeof(response), "已手动触发\r\n");
+            } else {
+                shell_snprintf(response, sizeof(response), "错误: 触发捕获未运行\r\n");
+            }
+        } else if (s->active) {
+            shell_snprintf(response, sizeof(response), "错误: 测试运行中，请先使用 'testoff' 停止测试\r\n");
+        } else if (strcmp(arg, "off") == 0) {
+            s->trigger_config.enabled = false;
+            shell_snprintf(response, sizeof(response), "触发捕获已关闭\r\n");
+        } else if (strcmp(arg, "on") == 0) {
+            if (s->capture_config.enabled) {
+                shell_snprintf(response, sizeof(response), "错误: 稳定捕获已开启，两者都需独占ADC，请先 'test capture off'\r\n");
+            } else {
+                s->trigger_config.enabled = true;
+                shell_snprintf(response, sizeof(response),
+                        "触发捕获已开启: 测试期间由捕获任务连续采样，测试循环使用其最新样本\r\n");
+            }
+        } else if (strncmp(arg, "set", 3) == 0 && arg[3] == ' ') {
+            // 逐项解析key=value，全部有效才生效
+            test_trigger_config_t config = s->trigger_config;
+            char buffer[128];
+            char *saveptr;
+            const char *bad = NULL;
+            strncpy(buffer, arg + 4, sizeof(buffer) - 1);
+            buffer[sizeof(buffer) - 1] = '\0';
+            
+            for (char *item = strtok_r(buffer, " ", &saveptr); item != NULL && bad == NULL;
+                 item = strtok_r(NULL, " ", &saveptr)) {
+                char *value = strchr(item, '=');
+                if (value == NULL) {
+                    bad = item;
+                    break;
+                }
+                *value++ = '\0';
+                
+                if (strcmp(item, "ch") == 0) {
+                    config.channel_mask = (uint8_t)strtoul(value, NULL, 16);
+                } else if (strcmp(item, "src") == 0) {
+                    if (test_trigger_parse_sources(value, &config.source_mask) != ESP_OK) {
+                        bad = value;
+                    }
+                } else if (strcmp(item, "level") == 0) {
+                    config.level_ma = strtof(value, NULL);
+                } else if (strcmp(item, "slope") == 0) {
+                    config.slope_ma = strtof(value, NULL);
+                } else if (strcmp(item, "pre") == 0) {
+                    config.pre_samples = (uint16_t)atoi(value);
+                } else if (strcmp(item, "post") == 0) {
+                    config.post_samples = (uint16_t)atoi(value);
+                } else if (strcmp(item, "rearm") == 0) {
+                    config.auto_rearm = atoi(value) != 0;
+                } else {
+                    bad = item;
+                }
+            }
+            
+            if (bad != NULL) {
+                shell_snprintf(response, sizeof(response), "错误: 无效的参数 '%s'\r\n", bad);
+            } else if ((config.channel_mask & 0x0F) == 0 || config.source_mask == 0 || config.post_samples == 0 ||
+                       config.pre_samples + config.post_samples > TEST_TRIGGER_DEPTH || config.slope_ma <= 0.0f) {
+                shell_snprintf(response, sizeof(response),
+                        "错误: 通道/触发源不能为空，触发后点数>0，触发前后点数之和不超过%d，斜率>0\r\n",
+                        TEST_TRIGGER_DEPTH);
+            } else {
+                config.channel_mask &= 0x0F;
+                s->trigger_config = config;
+                shell_snprintf(response, sizeof(response), "触发捕获参数已更新\r\n");
             }
         } else {
-            // 创建新文件并写入表头
-            FILE *file = fopen(TEST_LOG_FILE_PATH, "w");
-            if (file != NULL) {
-                fprintf(file, "=== ESP32模拟板测试日志 ===\n");
-                fprintf(file, "时间戳(ms),循环计数,拉低IO号(1-8),点亮LED号(1-4),CH0电压(V),CH0电流(mA),CH1电压(V),CH1电流(mA),CH2电压(V),CH2电流(mA),CH3电压(V),CH3电流(mA)\n");
-                fclose(file);
+            shell_snprintf(response, sizeof(response),
+                    "用法: test trigger [on|off|fire|set ch=<掩码> src=<level,slope,key,io,manual> "
+                    "level=<mA> slope=<mA> pre=<点数> post=<点数> rearm=<0|1>]\r\n");
+        }
+    } else if (strncmp(params, "watch", 5) == 0 && (params[5] == '\0' || params[5] == ' ')) {
+        // 观察其他通道的会话
+        test_session_t *target = test_session_by_id(atoi(params + 5));
+        if (target == NULL) {
+            shell_snprintf(response, sizeof(response), "用法: test watch <会话号>，使用 'test sessions' 查看会话\r\n");
+        } else if (target == s) {
+            shell_snprintf(response, sizeof(response), "错误: 不能观察自己的会话\r\n");
+        } else if (test_session_is_viewer(target, channel_id)) {
+            shell_snprintf(response, sizeof(response), "已在观察会话%d\r\n", target->id);
+        } else {
+            test_session_watch(target, channel_id, true);
+            if (test_session_is_viewer(target, channel_id)) {
+                shell_snprintf(response, sizeof(response), "开始观察会话%d (通道%lu)，使用 'test unwatch' 停止\r\n",
+                        target->id, target->channels[0]);
+            } else {
+                shell_snprintf(response, sizeof(response), "错误: 会话%d观察者已满(最多%d个)\r\n",
+                        target->id, TEST_SESSION_MAX_VIEWERS - 1);
             }
         }
+    } else if (strcmp(params, "unwatch") == 0) {
+        for (uint8_t i = 0; i < TEST_MAX_SESSIONS; i++) {
+            if (sessions[i].id != 0 && test_session_is_viewer(&sessions[i], channel_id)) {
+                test_session_watch(&sessions[i], channel_id, false);
+            }
+        }
+        shell_snprintf(response, sizeof(response), "已停止观察其他会话\r\n");
+    } else if (strcmp(params, "sessions") == 0) {
+        // 列出所有会话
+        shell_snprintf(response, sizeof(response), "=== 测试会话 ===\r\n");
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
         
-        // 启动测试
-        g_test_status.running = true;
-        g_test_status.cycle_count = 0;
-        g_test_status.current_io = 0;
-        g_test_status.current_led = 1;
-        g_test_status.start_time_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
-        test_channel_id = channel_id; // 保存Shell通道ID
-        
-        // 设置按键事件回调并启动按键检测
-        key_set_event_callback(key_event_handler);
-        key_start_detection();
+        for (uint8_t i = 0; i < TEST_MAX_SESSIONS; i++) {
+            const test_session_t *session = &sessions[i];
+            if (session->id == 0) {
+                continue;
+            }
+            uint8_t viewers = 0;
+            for (uint8_t v = 1; v < TEST_SESSION_MAX_VIEWERS; v++) {
+                viewers += session->channels[v] != 0;
+            }
+            shell_snprintf(response, sizeof(response),
+                    "%s会话%d: 通道%lu %s, 计划%s, 循环%lu, IO掩码0x%04X, LED掩码0x%X, 观察者%d, 日志%s\r\n",
+                    session == s ? "*" : " ", session->id, session->channels[0],
+                    session->status.running ? "运行中" : (session->active ? "停止中" : "未运行"), session->plan.name,
+                    session->status.cycle_count, session->io_mask, session->led_mask, viewers,
+                    session->log_path);
+            cmd_output(channel_id, (uint8_t *)response, strlen(response));
+        }
+        shell_snprintf(response, sizeof(response), "==================\r\n");
+    } else if (strncmp(params, "status", 6) == 0 && (params[6] == '\0' || params[6] == ' ')) {
+        // 显示测试状态和调度统计，可指定其他通道的会话
+        const test_session_t *target = s;
+        if (params[6] == ' ') {
+            target = test_session_by_id(atoi(params + 7));
+        }
         
-        // 创建测试任务
-        BaseType_t ret = xTaskCreate(test_task_main, "test_task", 4096, NULL, 5, &test_task_handle);
-        if (ret == pdPASS) {
-            shell_snprintf(response, sizeof(response), 
-                    "=== 自动化测试启动 ===\r\n"
-                    "功能:\r\n"
-                    "- ADS1115数据记录到SD卡\r\n"
-                    "- TCA9535 IO1-8循环拉低\r\n"
-                    "- LED1-4循环点亮\r\n"
-                    "- 循环间隔: %dms\r\n"
-                    "- Shell终端持续打印测试数据\r\n"
-                    "- 按键检测(GPIO35)和事件记录\r\n"
-                    "\r\n"
-                    "使用 'testoff' 停止测试\r\n"
-                    "Shell将开始持续显示测试数据...\r\n"
-                    "========================\r\n", TEST_CYCLE_INTERVAL_MS);
-            ESP_LOGI(TAG, "自动化测试启动成功 - 终端将持续打印数据");
+        if (target == NULL) {
+            shell_snprintf(response, sizeof(response), "错误: 会话不存在，使用 'test sessions' 查看会话\r\n");
         } else {
-            g_test_status.running = false;
-            shell_snprintf(response, sizeof(response), "错误: 无法创建测试任务\r\n");
-            ESP_LOGE(TAG, "创建测试任务失败");
+            const test_event_stats_t *events = test_event_get_stats(target->id - 1);
+            key_stats_t keys;
+            key_get_stats(&keys);
+            shell_snprintf(response, sizeof(response),
+                    "=== 测试状态 (会话%d, 通道%lu) ===\r\n"
+                    "运行状态: %s\r\n"
+                    "循环周期: %lums\r\n"
+                    "夹具: IO掩码0x%04X, LED掩码0x%X\r\n"
+                    "测试计划: %s (步骤 %d/%d, 图案 %lu/%lu, 已完成%lu轮)\r\n"
+                    "循环计数: %lu\r\n"
+                    "超时循环: %lu (丢失节拍: %lu)\r\n"
+                    "调度延迟: 最近 %ldus, 最大 %ldus\r\n"
+                    "限值判定: %s (超限样本: %lu, 读取失败: %lu)\r\n"
+                    "终端输出: %s, %lu行 (过滤: %lu, 丢弃: %lu)\r\n"
+                    "触发捕获: %s (触发%lu次, 保存%lu次)\r\n"
+                    "事件日志: 写入%lu, 丢弃%lu, 重排%lu\r\n"
+                    "按键(各会话共用): 事件%lu, 边沿%lu (丢弃%lu), 抖动%lu\r\n"
+                    "检查点: %lu次 (失败%lu)%s\r\n"
+                    "==================\r\n",
+                    target->id, target->channels[0],
+                    target->status.running ? "运行中" : (target->active ? "停止中" : "未运行"),
+                    target->status.running ? target->status.period_ms : target->period_ms,
+                    target->io_mask, target->led_mask,
+                    target->plan.name, target->status.current_step + 1, target->plan.step_count,
+                    target->status.pattern_index + 1, target->status.pattern_count > 0 ? target->status.pattern_count : 1,
+                    target->status.plan_loops,
+                    target->status.cycle_count,
+                    target->status.overrun_count, target->status.missed_ticks,
+                    target->status.last_lateness_us, target->status.max_lateness_us,
+                    test_limits_verdict_str(test_limits_verdict(&target->limits, &target->plan)),
+                    target->limits.fail_count, target->limits.error_count,
+                    test_console_mode_str(target->console_config.mode), target->consoles[0].printed_lines,
+                    target->consoles[0].filtered_lines, target->consoles[0].dropped_lines,
+                    target->trigger_config.enabled ? (test_trigger_is_running() ? "运行中" : "开启") : "关闭",
+                    test_sum_trigger_count(), test_trigger_get_stats()->saved_count,
+                    events->written, events->dropped, events->reordered,
+                    keys.event_count, keys.edge_count, keys.edge_dropped, keys.bounce_count,
+                    target->checkpoint_count, target->checkpoint_errors,
+                    target->resumed ? ", 本次从检查点恢复" : "");
         }
     } else {
-        shell_snprintf(response, sizeof(response), 
+        // 用法说明较长，分段输出
+        shell_snprintf(response, sizeof(response),
                 "test命令用法:\r\n"
-                "test      - 开始自动化测试\r\n"
-                "testoff   - 停止自动化测试\r\n"
+                "test               - 开始自动化测试\r\n"
+                "test period [毫秒] - 查看/设置循环周期(%d-%dms)\r\n"
+                "test status [会话] - 显示测试状态\r\n"
+                "test plan          - 显示当前测试计划\r\n"
+                "test plan load [文件] - 从SD卡加载计划(默认%s)\r\n"
+                "test plan default  - 使用内置默认计划\r\n"
+                "test plan pattern <walk1|walk0|gray|pairs> [掩码] [驻留ms] - 16引脚图案计划\r\n"
+                "test console [all|every <N>|change <mA>|status|off] - 终端输出模式\r\n"
+                "test capture [on [通道] [窗口ms]|off] - IO切换后稳定过程捕获\r\n"
+                "test trigger [on|off|fire|set k=v..] - 触发前/后波形捕获\r\n",
+                TEST_CYCLE_MIN_INTERVAL_MS, TEST_CYCLE_MAX_INTERVAL_MS, TEST_PLAN_DEFAULT_PATH);
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+        
+        shell_snprintf(response, sizeof(response),
+                "test pins [IO掩码] [LED掩码] - 本会话控制的夹具引脚\r\n"
+                "test checkpoint [秒|off] - 检查点间隔\r\n"
+                "test resume [会话] - 复位后从检查点继续测试\r\n"
+                "test sessions      - 列出所有会话\r\n"
+                "test watch <会话>  - 观察其他通道的会话\r\n"
+                "test unwatch       - 停止观察\r\n"
+                "testoff [会话]     - 停止自动化测试\r\n"
                 "\r\n"
                 "测试功能:\r\n"
-                "- ADS1115数据记录到SD卡\r\n"
-                "- TCA9535 IO1-8循环拉低\r\n"
-                "- LED1-4循环点亮\r\n"
-                "- 循环间隔: %dms\r\n"
-                "- Shell终端持续打印测试数据\r\n"
-                "- 按键检测(GPIO35)和事件记录\r\n", TEST_CYCLE_INTERVAL_MS);
+                "- 每个Shell通道一个会话(本通道: 会话%d)，掩码不重叠时可同时运行\r\n"
+                "- 按计划切换TCA9535 IO和LED(默认IO1-8/LED1-4循环)\r\n"
+                "- ADS1115数据记录到SD卡(%s)\r\n"
+                "- 循环周期: %lums\r\n"
+                "- Shell终端按输出模式限速打印\r\n"
+                "- 按键检测(GPIO35)和事件记录\r\n",
+                s->id, s->log_path, s->period_ms);
     }
     
     cmd_output(channel_id, (uint8_t *)response, strlen(response));
@@ -350,48 +1750,188 @@ void task_testoff_control(uint32_t channel_id, const char *params)
 {
     char response[512];
     
-    if (!g_test_status.running) {
+    // 默认停止本通道的会话，也可指定会话号
+    test_session_t *s;
+    if (strlen(params) > 0) {
+        s = test_session_by_id(atoi(params));
+    } else {
+        s = test_session_get(channel_id, false);
+    }
+    
+    // 等待正在进行的启动完成，再判断是否在运行
+    if (s != NULL) {
+        xSemaphoreTake(s->control, portMAX_DELAY);
+    }
+    if (s == NULL || !s->active) {
+        if (s != NULL) {
+            xSemaphoreGive(s->control);
+        }
         shell_snprintf(response, sizeof(response), "测试未在运行\r\n");
         cmd_output(channel_id, (uint8_t *)response, strlen(response));
         return;
     }
     
-    // 停止测试
-    g_test_status.running = false;
-    test_channel_id = 0; // 清除Shell通道ID
-    
-    // 停止按键检测
-    key_stop_detection();
-    key_set_event_callback(NULL);
-    
-    // 等待测试任务结束
-    if (test_task_handle != NULL) {
-        vTaskDelay(pdMS_TO_TICKS(600)); // 等待超过一个循环周期
+    // 停止测试，通知测试任务立即结束当前的节拍等待；上次停止超时时只再等待一次
+    int64_t stop_us = esp_timer_get_time();
+    if (s->status.running) {
+        s->status.running = false;
+        test_scheduler_request_stop(&s->scheduler);
+        
+        // 取消按键订阅，没有其他会话运行时停止按键检测
+        key_unsubscribe(key_event_handler, s);
+        if (!test_other_running(s)) {
+            key_stop_detection();
+        }
     }
     
-    // 写入结束标记到日志文件
-    if (sd_card_is_mounted()) {
-        FILE *file = fopen(TEST_LOG_FILE_PATH, "a");
-        if (file != NULL) {
-            uint32_t end_time_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
-            uint32_t duration_ms = end_time_ms - g_test_status.start_time_ms;
-            fprintf(file, "\n=== 测试会话结束 ===\n");
-            fprintf(file, "总循环次数: %lu\n", g_test_status.cycle_count);
-            fprintf(file, "测试时长: %lu ms (%.1f秒)\n", duration_ms, duration_ms / 1000.0f);
-            fprintf(file, "===================\n\n");
-            fclose(file);
-        }
+    // 等待测试任务关闭日志、写入结束标记后退出；超时则会话保持停止中，
+    // 测试任务退出前不能再启动，也不输出统计
+    if (xSemaphoreTake(s->stopped, pdMS_TO_TICKS(TEST_STOP_TIMEOUT_MS)) != pdTRUE) {
+        xSemaphoreGive(s->control);
+        shell_snprintf(response, sizeof(response),
+                       "错误: 等待会话%d测试任务结束超时(%dms)，会话保持停止中，可再次执行 'testoff' 等待\r\n",
+                       s->id, TEST_STOP_TIMEOUT_MS);
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+        ESP_LOGE(TAG, "会话%d测试任务停止超时", s->id);
+        return;
     }
+    uint32_t stop_latency_ms = (uint32_t)((esp_timer_get_time() - stop_us) / 1000);
+    xSemaphoreGive(s->control);
     
-    shell_snprintf(response, sizeof(response), 
-            "=== 测试已停止 ===\r\n"
+
+    shell_snprintf(response, sizeof(response),
+            "=== 测试已停止 (会话%d) ===\r\n"
             "总循环次数: %lu\r\n"
             "测试时长: %.1f秒\r\n"
-            "Shell终端打印已停止\r\n"
-            "==================\r\n",
-            g_test_status.cycle_count,
-            (xTaskGetTickCount() * portTICK_PERIOD_MS - g_test_status.start_time_ms) / 1000.0f);
+            "超时循环: %lu (丢失节拍: %lu)\r\n"
+            "最大调度延迟: %ldus\r\n"
+            "终端输出: %lu行 (过滤: %lu, 限速丢弃: %lu)\r\n"
+            "停止耗时: %lums\r\n",
+            s->id, s->status.cycle_count,
+            (xTaskGetTickCount() * portTICK_PERIOD_MS - s->status.start_time_ms) / 1000.0f,
+            s->status.overrun_count, s->status.missed_ticks,
+            s->status.max_lateness_us, s->consoles[0].printed_lines,
+            s->consoles[0].filtered_lines, s->consoles[0].dropped_lines, stop_latency_ms);
     cmd_output(channel_id, (uint8_t *)response, strlen(response));
     
-    ESP_LOGI(TAG, "自动化测试停止 - Shell终端打印已停止");
-}
\ No newline at end of file
+    if (s->capture_config.enabled) {
+        shell_snprintf(response, sizeof(response), "稳定捕获: %lu次, 最大稳定时间%luus, 最大峰值%.2fmA\r\n",
+                test_capture_get_stats()->capture_count, test_capture_get_stats()->max_settle_us,
+                test_capture_get_stats()->max_peak_ma);
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+    }
+    if (s->trigger_config.enabled) {
+        shell_snprintf(response, sizeof(response), "触发捕获: 触发%lu次, 保存%lu次\r\n",
+                test_sum_trigger_count(), test_trigger_get_stats()->saved_count);
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+    }
+    
+    // 限值判定结论
+    test_output_verdict(s, channel_id);
+    shell_snprintf(response, sizeof(response), "==================\r\n");
+    cmd_output(channel_id, (uint8_t *)response, strlen(response));
+    
+    // 通知会话的其他终端
+    for (uint8_t i = 0; i < TEST_SESSION_MAX_VIEWERS; i++) {
+        if (s->channels[i] != 0 && s->channels[i] != channel_id) {
+            shell_snprintf(response, sizeof(response), "\r\n=== 会话%d已由通道%lu停止 ===\r\n", s->id, channel_id);
+            cmd_output(s->channels[i], (uint8_t *)response, strlen(response));
+            test_output_verdict(s, s->channels[i]);
+        }
+    }
+    
+    ESP_LOGI(TAG, "会话%d自动化测试停止 - Shell终端打印已停止", s->id);
+}
+
+void task_teststat_control(uint32_t channel_id, const char *params)
+{
+    char response[256];
+    char arg[16] = {0};
+    char key[16] = {0};
+    char id[8] = {0};
+    int argc = sscanf(params, "%15s %15s %7s", arg, key, id);
+    
+    // 会话号在命令末尾，省略时为本通道的会话
+    const char *session_arg = NULL;
+    bool valid = true;
+    if (argc > 0 && atoi(arg) > 0) {
+        session_arg = arg;
+    } else if (argc > 0 && strcmp(arg, "hist") == 0) {
+        session_arg = argc >= 3 ? id : NULL;
+    } else if (argc > 0 && strcmp(arg, "reset") == 0) {
+        session_arg = argc >= 2 ? key : NULL;
+    } else if (argc > 0) {
+        valid = false;
+    }
+    
+    test_session_t *s = NULL;
+    if (valid) {
+        s = (session_arg != NULL) ? test_session_by_id(atoi(session_arg)) : test_session_get(channel_id, false);
+    }
+    
+    test_phase_stat_t stat;
+    if (!valid) {
+        shell_snprintf(response, sizeof(response),
+                "teststat命令用法:\r\n"
+                "teststat [会话]                - 显示各阶段耗时统计\r\n"
+                "teststat hist <阶段> [会话]    - 显示阶段耗时直方图(adc/tca/led/sd/console/capture/cycle)\r\n"
+                "teststat reset [会话]          - 清空统计\r\n"
+                "省略会话时为本通道的会话\r\n");
+    } else if (s == NULL) {
+        shell_snprintf(response, sizeof(response), "错误: 会话不存在，使用 'test sessions' 查看会话\r\n");
+    } else if (argc <= 0 || session_arg == arg) {
+        // 各阶段耗时汇总
+        shell_snprintf(response, sizeof(response),
+                "=== 会话%d 测试循环阶段耗时 (%s) ===\r\n"
+                "%-10s %8s %8s %8s %8s\r\n",
+                s->id, s->status.running ? "运行中" : "已停止", "阶段", "次数", "最小us", "平均us", "最大us");
+        cmd_output(channel_id, (uint8_t *)response, strlen(response));
+        
+        for (int i = 0; i < TEST_PHASE_COUNT; i++) {
+            test_phase_get(&s->phase_stats, (test_phase_t)i, &stat);
+            shell_snprintf(response, sizeof(response), "%-10s %8lu %8lu %8lu %8lu\r\n",
+                    test_phase_name((test_phase_t)i), stat.count, stat.min_us,
+                    stat.count > 0 ? (uint32_t)(stat.total_us / stat.count) : 0, stat.max_us);
+            cmd_output(channel_id, (uint8_t *)response, strlen(response));
+        }
+        
+        shell_snprintf(response, sizeof(response), "==================\r\n");
+    } else if (strcmp(arg, "hist") == 0) {
+        // 单个阶段的耗时直方图
+        test_phase_t phase;
+        if (argc < 2 || test_phase_parse(key, &phase) != ESP_OK) {
+            shell_snprintf(response, sizeof(response), "用法: teststat hist <adc|tca|led|sd|console|capture|cycle> [会话]\r\n");
+        } else {
+            test_phase_get(&s->phase_stats, phase, &stat);
+            shell_snprintf(response, sizeof(response), "=== 会话%d %s 耗时直方图 (共%lu次) ===\r\n",
+                    s->id, test_phase_name(phase), stat.count);
+            cmd_output(channel_id, (uint8_t *)response, strlen(response));
+            
+            for (uint8_t b = 0; b < TEST_PHASE_HIST_BUCKETS; b++) {
+                if (stat.hist[b] == 0) {
+                    continue;
+                }
+                uint32_t limit = test_phase_bucket_limit(b);
+                uint32_t percent = stat.hist[b] * 100 / stat.count;
+                char bar[52];
+                memset(bar, '#', percent / 2);
+                bar[percent / 2] = '\0';
+                if (limit > 0) {
+                    snprintf(response, sizeof(response), "  <%8luus %8lu %3lu%% %s\r\n", limit, stat.hist[b], percent, bar);
+                } else {
+                    snprintf(response, sizeof(response), " >=%8luus %8lu %3lu%% %s\r\n",
+                            1UL << (TEST_PHASE_HIST_BUCKETS - 2), stat.hist[b], percent, bar);
+                }
+                cmd_output(channel_id, (uint8_t *)response, strlen(response));
+            }
+            
+            shell_snprintf(response, sizeof(response), "==================\r\n");
+        }
+    } else {
+        // 记录和清空都在阶段统计的临界区内，测试运行中也可直接清空
+        test_phase_reset(&s->phase_stats);
+        shell_snprintf(response, sizeof(response), "会话%d阶段耗时统计已清空\r\n", s->id);
+    }
+    
+    cmd_output(channel_id, (uint8_t *)response, strlen(response));
+}
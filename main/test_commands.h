@@ -3,10 +3,16 @@
  * @brief 测试命令模块头文件
  * 
  * 实现自动化测试功能，包括：
- * - ADS1115数据记录到SD卡
- * - TCA9535 IO循环控制
- * - LED循环点亮
+ * - 按测试计划(SD卡脚本或内置默认计划)逐步执行
+ * - ADS1115采样、步骤切换、按键和错误按时间顺序记录到SD卡
+ * - 按步骤电流窗口在线判定合格/不合格
+ * - TCA9535 IO输出控制
+ * - LED点亮控制
  * - 测试日志查看和控制
+ *
+ * 每个Shell通道一个测试会话，各自有独立的状态、计划、日志文件和
+ * 终端输出，其他通道可作为观察者订阅会话的输出。多个会话共用一套
+ * 夹具时按IO/LED掩码划分，掩码不重叠的会话可同时运行。
  */
 
 #ifndef TEST_COMMANDS_H
@@ -21,27 +27,50 @@ extern "C" {
 #endif
 
 /* 测试配置常量 */
-#define TEST_LOG_FILE_PATH      "/sdcard/testlog.txt"    /*!< 测试日志文件路径 */
-#define TEST_CYCLE_INTERVAL_MS  500                      /*!< 测试循环间隔(毫秒) */
-#define TEST_IO_COUNT           8                        /*!< TCA9535 IO数量(显示为1-8) */
+#define TEST_LOG_FILE_PATH      "/sdcard/testlog.txt"    /*!< 测试日志文件路径(会话1) */
+#define TEST_SESSION_LOG_FORMAT "/sdcard/testlog%d.txt"  /*!< 其他会话的日志文件路径 */
+#define TEST_MAX_SESSIONS       4                        /*!< 最大测试会话数(与Shell实例数一致) */
+#define TEST_SESSION_MAX_VIEWERS 4                       /*!< 每个会话的输出通道数(含所属通道) */
+#define TEST_CYCLE_INTERVAL_MS  500                      /*!< 默认测试循环周期(毫秒) */
+#define TEST_CYCLE_MIN_INTERVAL_MS 2                     /*!< 最小测试循环周期(毫秒)，只有驻留节拍和触发捕获取样能跟上，采样节拍的ADC扫描约需ADS1115_SCAN_MS */
+#define TEST_CYCLE_MAX_INTERVAL_MS 60000                 /*!< 最大测试循环周期(毫秒) */
 #define TEST_LED_COUNT          4                        /*!< LED数量(1-4) */
+#define TEST_STOP_TIMEOUT_MS    2000                     /*!< testoff等待测试任务结束的最长时间(毫秒) */
 
 /* 测试状态结构体 */
 typedef struct {
     bool running;                                        /*!< 测试是否正在运行 */
     uint32_t cycle_count;                               /*!< 循环计数 */
-    uint8_t current_io;                                 /*!< 当前拉高的IO号(内部0-7，显示1-8) */
-    uint8_t current_led;                                /*!< 当前点亮的LED号(1-4) */
+    uint16_t current_step;                              /*!< 当前执行的计划步骤(从0开始) */
+    uint16_t current_output;                            /*!< 当前TCA9535输出字 */
+    uint8_t current_led_mask;                           /*!< 当前LED掩码(bit0=LED1) */
+    uint32_t pattern_index;                             /*!< 当前步骤内的图案序号(从0开始) */
+    uint32_t pattern_count;                             /*!< 当前步骤的图案总数 */
+    uint32_t plan_loops;                                /*!< 已完成的计划轮数 */
     uint32_t start_time_ms;                             /*!< 测试开始时间(毫秒) */
+    uint32_t period_ms;                                 /*!< 循环周期(毫秒) */
+    uint32_t overrun_count;                             /*!< 超时循环次数(循环耗时超过周期) */
+    uint32_t missed_ticks;                              /*!< 因超时丢失的节拍总数 */
+    int32_t last_lateness_us;                           /*!< 最近一次调度延迟(微秒) */
+    int32_t max_lateness_us;                            /*!< 最大调度延迟(微秒) */
 } test_status_t;
 
 /**
  * @brief 测试命令处理函数
  * 
  * 支持的命令：
- * - test start    - 开始自动化测试
- * - test stop     - 停止自动化测试
- * - test status   - 显示测试状态
+ * - test                 - 开始自动化测试
+ * - test period <毫秒>   - 设置测试循环周期
+ * - test status [会话]   - 显示测试状态
+ * - test plan [load <文件>|default|pattern <图案> [掩码] [驻留]] - 查看/加载测试计划
+ * - test console [模式] - 设置终端输出模式(all/every/change/status/off)
+ * - test capture [on [通道] [窗口]|off] - IO切换后的稳定过程捕获
+ * - test trigger [on|off|fire|set ...] - 触发前/后波形捕获
+ * - test pins [IO掩码] [LED掩码] - 本会话控制的夹具引脚
+ * - test checkpoint [秒|off] - 检查点间隔
+ * - test resume [会话]   - 复位后从检查点继续测试
+ * - test sessions        - 列出所有会话
+ * - test watch <会话>|unwatch - 观察/停止观察其他通道的会话
  * 
  * @param channel_id 通道ID
  * @param params 命令参数
@@ -51,7 +80,7 @@ void task_test_control(uint32_t channel_id, const char *params);
 /**
  * @brief testoff命令处理函数
  * 
- * 停止自动化测试
+ * 停止本通道的测试会话，testoff <会话> 停止指定会话
  * 
  * @param channel_id 通道ID
  * @param params 命令参数
@@ -59,11 +88,28 @@ void task_test_control(uint32_t channel_id, const char *params);
 void task_testoff_control(uint32_t channel_id, const char *params);
 
 /**
- * @brief 获取当前测试状态
+ * @brief teststat命令处理函数
  * 
- * @return 指向测试状态结构体的指针
+ * 显示测试循环各阶段(ADC扫描、TCA9535、LED、SD写入、终端输出)的耗时统计，
+ * 每个会话单独统计，省略会话时为本通道的会话
+ * 
+ * 支持的命令：
+ * - teststat [会话]               - 显示各阶段最小/平均/最大耗时
+ * - teststat hist <阶段> [会话]   - 显示阶段耗时直方图
+ * - teststat reset [会话]         - 清空统计
+ * 
+ * @param channel_id 通道ID
+ * @param params 命令参数
+ */
+void task_teststat_control(uint32_t channel_id, const char *params);
+
+/**
+ * @brief 获取测试会话的状态
+ * 
+ * @param session 会话编号(从1开始)
+ * @return 指向测试状态结构体的指针，会话不存在时返回NULL
  */
-const test_status_t* test_get_status(void);
+const test_status_t* test_get_status(uint8_t session);
 
 /**
  * @brief 初始化测试模块
@@ -0,0 +1,139 @@
+/**
+ * @file test_console.c
+ * @brief 测试终端输出模块实现
+ */
+
+#include "test_console.h"
+#include "shell.h"
+#include "esp_timer.h"
+#include <math.h>
+#include <string.h>
+
+static const char *mode_names[] = {
+    [TEST_CONSOLE_MODE_ALL]    = "all",
+    [TEST_CONSOLE_MODE_EVERY]  = "every",
+    [TEST_CONSOLE_MODE_CHANGE] = "change",
+    [TEST_CONSOLE_MODE_STATUS] = "status",
+    [TEST_CONSOLE_MODE_OFF]    = "off",
+};
+
+void test_console_begin(test_console_t *console, const test_console_config_t *config,
+                        uint32_t channel_id, uint32_t baud_rate)
+{
+    memset(console, 0, sizeof(test_console_t));
+    console->config = *config;
+    console->channel_id = channel_id;
+
+    // 每字节10位(起始位+8数据位+停止位)，测试输出只占用部分带宽
+    console->bytes_per_sec = baud_rate / 10 * TEST_CONSOLE_LINK_SHARE_PCT / 100;
+    console->tokens = TEST_CONSOLE_BURST_BYTES;
+    console->last_refill_us = esp_timer_get_time();
+}
+
+bool test_console_should_emit(test_console_t *console, uint16_t step_index,
+                              const ads1115_channel_data_t *channel_data)
+{
+    bool emit = false;
+    console->sample_count++;
+
+    switch (console->config.mode) {
+        case TEST_CONSOLE_MODE_ALL:
+        case TEST_CONSOLE_MODE_STATUS:
+            emit = true;
+            break;
+
+        case TEST_CONSOLE_MODE_EVERY:
+            emit = console->config.every_n <= 1 ||
+                   (console->sample_count % console->config.every_n) == 1;
+            break;
+
+        case TEST_CONSOLE_MODE_CHANGE:
+            // 与上次输出的值比较，缓慢漂移累计超过阈值后也会输出
+            if (!console->last_valid || step_index != console->last_step || channel_data == NULL) {
+                emit = true;
+                break;
+            }
+            for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT; ch++) {
+                if (channel_data[ch].status != ESP_OK ||
+                    fabsf(channel_data[ch].current_ma - console->last_ma[ch]) >= console->config.change_ma) {
+                    emit = true;
+                    break;
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    if (!emit) {
+        console->filtered_lines++;
+        return false;
+    }
+
+    console->last_step = step_index;
+    console->last_valid = channel_data != NULL;
+    if (channel_data != NULL) {
+        for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT; ch++) {
+            console->last_ma[ch] = channel_data[ch].current_ma;
+        }
+    }
+
+    return true;
+}
+
+bool test_console_write(test_console_t *console, const char *line, size_t len)
+{
+    if (console->channel_id == 0) {
+        return false;
+    }
+
+    // 按经过的时间补充令牌
+    int64_t now_us = esp_timer_get_time();
+    uint64_t refill = (uint64_t)(now_us - console->last_refill_us) * console->bytes_per_sec / 1000000;
+    if (refill > 0) {
+        uint64_t tokens = console->tokens + refill;
+        console->tokens = (tokens > TEST_CONSOLE_BURST_BYTES) ? TEST_CONSOLE_BURST_BYTES : (uint32_t)tokens;
+        console->last_refill_us = now_us;
+    }
+
+    if (len > console->tokens) {
+        console->dropped_lines++;
+        return false;
+    }
+
+    console->tokens -= len;
+    console->printed_lines++;
+    console->printed_bytes += len;
+    cmd_output(console->channel_id, (const uint8_t *)line, len);
+
+    return true;
+}
+
+void test_console_end(test_console_t *console)
+{
+    if (console->config.mode == TEST_CONSOLE_MODE_STATUS && console->printed_lines > 0 && console->channel_id != 0) {
+        cmd_output(console->channel_id, (const uint8_t *)"\r\n", 2);
+    }
+    console->channel_id = 0;
+}
+
+esp_err_t test_console_parse_mode(const char *name, test_console_mode_t *mode)
+{
+    for (size_t i = 0; i < sizeof(mode_names) / sizeof(mode_names[0]); i++) {
+        if (strcmp(name, mode_names[i]) == 0) {
+            *mode = (test_console_mode_t)i;
+            return ESP_OK;
+        }
+    }
+
+    return ESP_ERR_NOT_FOUND;
+}
+
+const char *test_console_mode_str(test_console_mode_t mode)
+{
+    if ((size_t)mode < sizeof(mode_names) / sizeof(mode_names[0])) {
+        return mode_names[mode];
+    }
+    return "unknown";
+}
@@ -0,0 +1,132 @@
+/**
+ * @file test_console.h
+ * @brief 测试终端输出模块头文件
+ *
+ * 测试运行时的Shell终端输出级：
+ * - 多种输出模式：每次采样、每N次采样、变化超过阈值时、单行刷新状态
+ * - 按UART波特率限速(令牌桶)，超出预算的行直接丢弃并计数，不阻塞测试任务
+ */
+
+#ifndef TEST_CONSOLE_H
+#define TEST_CONSOLE_H
+
+#include "esp_err.h"
+#include "i2c_config.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 终端输出配置常量 */
+#define TEST_CONSOLE_LINK_SHARE_PCT   50                 /*!< 测试输出可占用的链路带宽百分比 */
+#define TEST_CONSOLE_BURST_BYTES      512                /*!< 令牌桶容量(允许的突发字节数) */
+#define TEST_CONSOLE_DEFAULT_EVERY    10                 /*!< 默认每N次采样输出一次 */
+#define TEST_CONSOLE_DEFAULT_CHANGE   1.0f               /*!< 默认变化阈值(毫安) */
+
+/* 终端输出模式 */
+typedef enum {
+    TEST_CONSOLE_MODE_ALL = 0,                           /*!< 每次采样输出一行 */
+    TEST_CONSOLE_MODE_EVERY,                             /*!< 每N次采样输出一行 */
+    TEST_CONSOLE_MODE_CHANGE,                            /*!< 步骤切换或电流变化超过阈值时输出 */
+    TEST_CONSOLE_MODE_STATUS,                            /*!< 单行刷新的状态行 */
+    TEST_CONSOLE_MODE_OFF,                               /*!< 不输出 */
+} test_console_mode_t;
+
+/* 终端输出配置 */
+typedef struct {
+    test_console_mode_t mode;                            /*!< 输出模式 */
+    uint32_t every_n;                                    /*!< EVERY模式的采样间隔 */
+    float change_ma;                                     /*!< CHANGE模式的电流变化阈值(毫安) */
+} test_console_config_t;
+
+/* 终端输出级 */
+typedef struct {
+    test_console_config_t config;                        /*!< 输出配置 */
+    uint32_t channel_id;                                 /*!< Shell通道ID */
+    uint32_t bytes_per_sec;                              /*!< 允许的输出速率(字节/秒) */
+    uint32_t tokens;                                     /*!< 当前可用字节数 */
+    int64_t last_refill_us;                              /*!< 上次补充令牌的时间 */
+    bool last_valid;                                     /*!< 是否已有上次输出的数据 */
+    uint16_t last_step;                                  /*!< 上次输出时的步骤 */
+    float last_ma[ADS1115_CHANNEL_COUNT];                /*!< 上次输出时的电流 */
+    uint32_t sample_count;                               /*!< 提交的采样次数 */
+    uint32_t printed_lines;                              /*!< 已输出行数 */
+    uint32_t filtered_lines;                             /*!< 被输出模式过滤的行数 */
+    uint32_t dropped_lines;                              /*!< 因超出带宽预算丢弃的行数 */
+    uint32_t printed_bytes;                              /*!< 已输出字节数 */
+} test_console_t;
+
+/**
+ * @brief 开始一次测试的终端输出
+ *
+ * 清空统计并按波特率计算输出预算
+ *
+ * @param console 终端输出级
+ * @param config 输出配置
+ * @param channel_id Shell通道ID
+ * @param baud_rate 链路波特率
+ */
+void test_console_begin(test_console_t *console, const test_console_config_t *config,
+                        uint32_t channel_id, uint32_t baud_rate);
+
+/**
+ * @brief 判断本次采样是否需要输出
+ *
+ * 仅按输出模式判断，不消耗带宽预算
+ *
+ * @param console 终端输出级
+ * @param step_index 当前步骤
+ * @param channel_data 采样数据(为NULL表示读取失败)
+ * @return true: 需要输出
+ */
+bool test_console_should_emit(test_console_t *console, uint16_t step_index,
+                              const ads1115_channel_data_t *channel_data);
+
+/**
+ * @brief 在带宽预算内输出一行
+ *
+ * 预算不足时丢弃并计数，不会阻塞等待链路
+ *
+ * @param console 终端输出级
+ * @param line 行内容
+ * @param len 长度
+ * @return true: 已输出, false: 已丢弃
+ */
+bool test_console_write(test_console_t *console, const char *line, size_t len);
+
+/**
+ * @brief 结束本次测试的终端输出
+ *
+ * 状态行模式下换行，避免后续输出覆盖状态行
+ *
+ * @param console 终端输出级
+ */
+void test_console_end(test_console_t *console);
+
+/**
+ * @brief 解析输出模式名称
+ *
+ * @param name 模式名称(all/every/change/status/off)
+ * @param mode 输出的模式
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_NOT_FOUND: 未知模式
+ */
+esp_err_t test_console_parse_mode(const char *name, test_console_mode_t *mode);
+
+/**
+ * @brief 获取输出模式名称
+ *
+ * @param mode 输出模式
+ * @return 模式名称
+ */
+const char *test_console_mode_str(test_console_mode_t mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_CONSOLE_H */
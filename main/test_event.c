@@ -0,0 +1,318 @@
+/**
+ * @file test_event.c
+ * @brief 测试事件总线和日志记录模块实现
+ */
+
+#include "test_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "TEST_EVENT";
+
+// 日志任务等待新事件的最长时间，决定重排窗口到期后的写出延迟
+#define TEST_EVENT_POLL_MS 20
+
+// 关闭标记，排在日志流所有事件之后通过队列送到日志任务
+#define TEST_EVENT_CLOSE 0xFF
+
+/* 日志流 */
+typedef struct {
+    FILE *file;                                          // 日志文件，NULL为未打开
+    volatile bool closing;                               // 已请求关闭，不再接受事件
+    SemaphoreHandle_t closed;                            // 日志任务关闭文件后释放
+    int64_t last_written_us;                             // 最后写出的事件时间
+    int64_t last_flush_us;                               // 上次刷新文件的时间
+    bool sd_busy;                                        // 本轮写过该日志流的文件
+    test_phase_stats_t *phase_stats;                     // 所属会话的阶段统计
+    test_event_stats_t stats;
+} test_event_stream_t;
+
+static QueueHandle_t event_queue = NULL;
+static TaskHandle_t event_task_handle = NULL;
+static test_event_stream_t streams[TEST_EVENT_MAX_STREAMS];
+
+// 按时间戳升序排列的重排缓冲区(所有日志流共用)
+static test_event_t pending[TEST_EVENT_REORDER_LEN];
+static uint16_t pending_count = 0;
+
+static const char *event_type_names[] = {
+    [TEST_EVENT_SAMPLE] = "SAMPLE",
+    [TEST_EVENT_STEP]   = "STEP",
+    [TEST_EVENT_KEY]    = "KEY",
+    [TEST_EVENT_ERROR]  = "ERROR",
+};
+
+/**
+ * @brief 以统一格式写出一个事件
+ */
+static void test_event_write(const test_event_t *event)
+{
+    test_event_stream_t *stream = &streams[event->stream];
+    FILE *file = stream->file;
+    if (file == NULL) {
+        return;
+    }
+
+    fprintf(file, "%lld,%s,%lu,%d,0x%04X,0x%X,", event->timestamp_us,
+            event_type_names[event->type], event->cycle, event->step, event->output, event->led_mask);
+
+    if (event->type == TEST_EVENT_SAMPLE) {
+        fprintf(file, "%ld,%lu", event->sample.lateness_us, event->sample.missed);
+        for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT; ch++) {
+            if (event->sample.valid_mask & (1 << ch)) {
+                int16_t raw = event->sample.raw[ch];
+                fprintf(file, ",%.4fV,%.2fmA", (float)raw * 4.096f / 32768.0f, ads1115_raw_to_current_ma(raw));
+            } else {
+                fprintf(file, ",ERROR,ERROR");
+            }
+        }
+        fprintf(file, ",\n");
+    } else if (event->type == TEST_EVENT_KEY) {
+        fprintf(file, ",,,,,,,,,,%s\n", event->key.pressed ? "按键按下" : "按键松开");
+    } else if (event->type == TEST_EVENT_ERROR) {
+        fprintf(file, ",,,,,,,,,,%s: %s\n", event->error.source, esp_err_to_name(event->error.code));
+    } else {
+        fprintf(file, ",,,,,,,,,,\n");
+    }
+
+    if (event->timestamp_us < stream->last_written_us) {
+        stream->stats.late++;
+    } else {
+        stream->last_written_us = event->timestamp_us;
+    }
+    stream->stats.written++;
+    stream->sd_busy = true;
+}
+
+/**
+ * @brief 按时间戳插入重排缓冲区
+ *
+ * 事件基本按序到达，从尾部向前查找插入位置
+ */
+static void test_event_insert(const test_event_t *event)
+{
+    // 缓冲区满时先写出最早的事件
+    if (pending_count == TEST_EVENT_REORDER_LEN) {
+        test_event_write(&pending[0]);
+        memmove(&pending[0], &pending[1], (pending_count - 1) * sizeof(test_event_t));
+        pending_count--;
+    }
+
+    uint16_t pos = pending_count;
+    while (pos > 0 && pending[pos - 1].timestamp_us > event->timestamp_us) {
+        pending[pos] = pending[pos - 1];
+        pos--;
+    }
+    pending[pos] = *event;
+    pending_count++;
+
+    test_event_stats_t *stats = &streams[event->stream].stats;
+    if (pos != pending_count - 1) {
+        stats->reordered++;
+    }
+    if (pending_count > stats->max_pending) {
+        stats->max_pending = pending_count;
+    }
+}
+
+/**
+ * @brief 写出时间戳不晚于deadline_us的事件，以及close_mask中日志流的全部事件
+ *
+ * @return 写出的事件数
+ */
+static uint16_t test_event_release(int64_t deadline_us, uint32_t close_mask)
+{
+    uint16_t kept = 0;
+    uint16_t released = 0;
+    for (uint16_t i = 0; i < pending_count; i++) {
+        if (pending[i].timestamp_us <= deadline_us || (close_mask & (1UL << pending[i].stream))) {
+            test_event_write(&pending[i]);
+            released++;
+        } else {
+            if (kept != i) {
+                pending[kept] = pending[i];
+            }
+            kept++;
+        }
+    }
+    pending_count = kept;
+    return released;
+}
+
+/**
+ * @brief 日志任务：合并排序所有事件并写入各日志流的文件
+ */
+static void test_event_task(void *arg)
+{
+    while (1) {
+        // 收到关闭标记时，该日志流之前投递的事件都已出队
+        uint32_t close_mask = 0;
+        test_event_t event;
+        BaseType_t received = xQueueReceive(event_queue, &event, pdMS_TO_TICKS(TEST_EVENT_POLL_MS));
+        while (received == pdTRUE) {
+            if (event.type == TEST_EVENT_CLOSE) {
+                close_mask |= 1UL << event.stream;
+            } else {
+                test_event_insert(&event);
+            }
+            received = xQueueReceive(event_queue, &event, 0);
+        }
+
+        int64_t now_us = esp_timer_get_time();
+        test_event_release(now_us - TEST_EVENT_REORDER_US, close_mask);
+
+        for (uint8_t i = 0; i < TEST_EVENT_MAX_STREAMS; i++) {
+            test_event_stream_t *stream = &streams[i];
+            if (stream->file == NULL) {
+                continue;
+            }
+
+            if (close_mask & (1UL << i)) {
+                // 事件已全部写出，关闭文件，统计耗时后通知等待的任务
+                fclose(stream->file);
+                stream->file = NULL;
+                stream->closing = false;
+                stream->sd_busy = true;
+            } else if (now_us - stream->last_flush_us >= TEST_EVENT_FLUSH_MS * 1000LL) {
+                fflush(stream->file);
+                stream->last_flush_us = now_us;
+                stream->sd_busy = true;
+            }
+        }
+        
+        // 只统计实际写卡的轮次，空闲轮询不计入；一轮同时写多个日志流时各会话都计入整轮耗时
+        int64_t end_us = esp_timer_get_time();
+        for (uint8_t i = 0; i < TEST_EVENT_MAX_STREAMS; i++) {
+            test_event_stream_t *stream = &streams[i];
+            if (stream->sd_busy) {
+                stream->sd_busy = false;
+                test_phase_record(stream->phase_stats, TEST_PHASE_SD, (uint32_t)(end_us - now_us));
+                // 记录耗时后再通知关闭完成，会话随后清空统计时不会混入本轮
+                if (close_mask & (1UL << i)) {
+                    xSemaphoreGive(stream->closed);
+                }
+            }
+        }
+    }
+}
+
+esp_err_t test_event_open(uint8_t stream_id, const char *path, test_phase_stats_t *phase_stats)
+{
+    if (stream_id >= TEST_EVENT_MAX_STREAMS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 上次关闭标记没有送出时文件仍打开，先重新关闭
+    test_event_stream_t *stream = &streams[stream_id];
+    if (stream->file != NULL && (stream->closing || test_event_close(stream_id) != ESP_OK)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (event_queue == NULL) {
+        event_queue = xQueueCreate(TEST_EVENT_QUEUE_LEN, sizeof(test_event_t));
+        if (event_queue == NULL) {
+            ESP_LOGE(TAG, "创建事件队列失败");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    // 日志任务创建后常驻，所有日志流共用
+    if (event_task_handle == NULL) {
+        // 优先级低于测试任务，写卡不影响采样节拍
+        if (xTaskCreate(test_event_task, "event_log", 4096, NULL, 4, &event_task_handle) != pdPASS) {
+            event_task_handle = NULL;
+            ESP_LOGE(TAG, "创建日志任务失败");
+            return ESP_FAIL;
+        }
+    }
+
+    if (stream->closed == NULL) {
+        stream->closed = xSemaphoreCreateBinary();
+        if (stream->closed == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    xSemaphoreTake(stream->closed, 0);
+
+    FILE *file = fopen(path, "a");
+    if (file == NULL) {
+        ESP_LOGE(TAG, "无法打开日志文件: %s", path);
+        return ESP_FAIL;
+    }
+
+    memset(&stream->stats, 0, sizeof(stream->stats));
+    stream->last_written_us = 0;
+    stream->last_flush_us = esp_timer_get_time();
+    stream->sd_busy = false;
+    stream->phase_stats = phase_stats;
+    stream->closing = false;
+    stream->file = file;
+
+    return ESP_OK;
+}
+
+esp_err_t test_event_close(uint8_t stream_id)
+{
+    if (stream_id >= TEST_EVENT_MAX_STREAMS || streams[stream_id].file == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    test_event_stream_t *stream = &streams[stream_id];
+    stream->closing = true;
+
+    // 关闭标记排在已投递事件之后，日志任务收到后立即写出并关闭文件
+    test_event_t mark = {
+        .timestamp_us = esp_timer_get_time(),
+        .type = TEST_EVENT_CLOSE,
+        .stream = stream_id,
+    };
+    TickType_t timeout = pdMS_TO_TICKS(TEST_EVENT_CLOSE_TIMEOUT_MS);
+    if (xQueueSend(event_queue, &mark, timeout) != pdTRUE) {
+        // 关闭标记没有送出，日志任务不会关闭文件，恢复为打开状态以便再次关闭
+        stream->closing = false;
+        ESP_LOGW(TAG, "日志流%d关闭失败，事件队列已满", stream_id);
+        return ESP_ERR_TIMEOUT;
+    }
+    if (xSemaphoreTake(stream->closed, timeout) != pdTRUE) {
+        ESP_LOGW(TAG, "日志流%d关闭超时", stream_id);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    ESP_LOGI(TAG, "日志流%d已关闭 (写入%lu个事件, 丢弃%lu, 重排%lu)", stream_id,
+             stream->stats.written, stream->stats.dropped, stream->stats.reordered);
+    return ESP_OK;
+}
+
+esp_err_t test_event_post(const test_event_t *event)
+{
+    if (event->stream >= TEST_EVENT_MAX_STREAMS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    test_event_stream_t *stream = &streams[event->stream];
+    if (stream->file == NULL || stream->closing) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (xQueueSend(event_queue, event, 0) != pdTRUE) {
+        stream->stats.dropped++;
+        return ESP_ERR_TIMEOUT;
+    }
+
+    stream->stats.posted++;
+    return ESP_OK;
+}
+
+const test_event_stats_t *test_event_get_stats(uint8_t stream_id)
+{
+    if (stream_id >= TEST_EVENT_MAX_STREAMS) {
+        stream_id = 0;
+    }
+    return &streams[stream_id].stats;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file test_event.h
+ * @brief 测试事件总线和日志记录模块头文件
+ *
+ * 按键事件、步骤切换(IO/LED)、ADC采样和错误都以带64位微秒时间戳
+ * (esp_timer_get_time)的事件投递到同一个队列，由日志任务按时间戳
+ * 排序后以统一的CSV格式写入测试日志，日志文件只由日志任务打开。
+ * 每个测试会话对应一个日志流(独立的日志文件)，所有流共用一个日志任务。
+ *
+ * 事件可能晚于其时间戳投递(如按键事件在防抖后才确认)，日志任务
+ * 保留一个重排窗口，时间戳早于(当前时间 - 窗口)的事件才写出。
+ */
+
+#ifndef TEST_EVENT_H
+#define TEST_EVENT_H
+
+#include "esp_err.h"
+#include "i2c_config.h"
+#include "test_phase.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 事件总线配置常量 */
+#define TEST_EVENT_MAX_STREAMS      4                    /*!< 最大日志流数(每个测试会话一个) */
+#define TEST_EVENT_QUEUE_LEN        64                   /*!< 事件队列长度 */
+#define TEST_EVENT_REORDER_LEN      64                   /*!< 重排缓冲区容量 */
+#define TEST_EVENT_REORDER_US       100000               /*!< 重排窗口(微秒)，需大于按键防抖时间 */
+#define TEST_EVENT_FLUSH_MS         1000                 /*!< 日志文件刷新间隔(毫秒) */
+#define TEST_EVENT_CLOSE_TIMEOUT_MS 1000                 /*!< 等待日志流关闭的最长时间(毫秒) */
+
+/* 统一日志CSV表头 */
+#define TEST_EVENT_CSV_HEADER "时间戳(us),事件,循环计数,步骤号,IO输出字,LED掩码,调度延迟(us),丢失节拍," \
+    "CH0电压(V),CH0电流(mA),CH1电压(V),CH1电流(mA),CH2电压(V),CH2电流(mA),CH3电压(V),CH3电流(mA),说明\n"
+
+/* 事件类型 */
+typedef enum {
+    TEST_EVENT_SAMPLE = 0,                               /*!< ADC采样 */
+    TEST_EVENT_STEP,                                     /*!< 步骤切换(IO/LED输出) */
+    TEST_EVENT_KEY,                                      /*!< 按键事件 */
+    TEST_EVENT_ERROR,                                    /*!< 错误 */
+} test_event_type_t;
+
+/* 测试事件 */
+typedef struct {
+    int64_t timestamp_us;                                /*!< 事件时间(esp_timer，微秒) */
+    uint32_t cycle;                                      /*!< 循环计数 */
+    uint16_t step;                                       /*!< 步骤号(从1开始) */
+    uint16_t output;                                     /*!< TCA9535输出字 */
+    uint8_t led_mask;                                    /*!< LED掩码 */
+    uint8_t type;                                        /*!< 事件类型(test_event_type_t) */
+    uint8_t stream;                                      /*!< 日志流(测试会话)编号 */
+    union {
+        struct {
+            int16_t raw[ADS1115_CHANNEL_COUNT];          /*!< 各通道原始ADC值 */
+            uint8_t valid_mask;                          /*!< 读取成功的通道掩码 */
+            int32_t lateness_us;                         /*!< 调度延迟(微秒) */
+            uint32_t missed;                             /*!< 丢失节拍 */
+        } sample;
+        struct {
+            bool pressed;                                /*!< true: 按下, false: 松开 */
+        } key;
+        struct {
+            esp_err_t code;                              /*!< 错误码 */
+            char source[12];                             /*!< 出错的部件 */
+        } error;
+    };
+} test_event_t;
+
+/* 事件总线统计 */
+typedef struct {
+    uint32_t posted;                                     /*!< 投递成功的事件数 */
+    uint32_t dropped;                                    /*!< 队列满丢弃的事件数 */
+    uint32_t written;                                    /*!< 写入日志的事件数 */
+    uint32_t reordered;                                  /*!< 晚于后续事件到达而被重排的事件数 */
+    uint32_t late;                                       /*!< 超出重排窗口、无法按序写出的事件数 */
+    uint32_t max_pending;                                /*!< 重排缓冲区最大占用 */
+} test_event_stats_t;
+
+/**
+ * @brief 打开日志流
+ *
+ * 第一次调用时创建事件队列和日志任务。日志任务每轮写卡的耗时计入该轮
+ * 写过的各日志流的SD写入阶段
+ *
+ * @param stream 日志流编号(0 ~ TEST_EVENT_MAX_STREAMS-1)
+ * @param path 日志文件路径(追加写入)
+ * @param phase_stats 所属会话的阶段统计，NULL为不统计
+ * @return esp_err_t
+ *         - ESP_OK: 打开成功
+ *         - ESP_ERR_INVALID_ARG: 编号无效
+ *         - ESP_ERR_INVALID_STATE: 日志流已打开(上次关闭失败遗留的日志流先重新关闭，仍失败时)
+ *         - ESP_ERR_NO_MEM: 队列创建失败
+ *         - ESP_FAIL: 文件打开或任务创建失败
+ */
+esp_err_t test_event_open(uint8_t stream, const char *path, test_phase_stats_t *phase_stats);
+
+/**
+ * @brief 关闭日志流
+ *
+ * 写出该流所有未写事件并关闭日志文件，返回后可直接追加写入该文件。
+ * 日志任务关闭文件后立即返回，不等待重排窗口
+ *
+ * @param stream 日志流编号
+ * @return esp_err_t
+ *         - ESP_OK: 已关闭
+ *         - ESP_ERR_INVALID_STATE: 日志流未打开
+ *         - ESP_ERR_TIMEOUT: 等待日志任务超时(关闭标记未送出时日志流保持打开，可再次关闭)
+ */
+esp_err_t test_event_close(uint8_t stream);
+
+/**
+ * @brief 投递事件
+ *
+ * 不阻塞，可在任意任务中调用；队列满时丢弃并计数
+ *
+ * @param event 事件(stream指定日志流)
+ * @return esp_err_t
+ *         - ESP_OK: 投递成功
+ *         - ESP_ERR_INVALID_STATE: 日志流未打开
+ *         - ESP_ERR_TIMEOUT: 队列满
+ */
+esp_err_t test_event_post(const test_event_t *event);
+
+/**
+ * @brief 获取日志流统计
+ *
+ * @param stream 日志流编号
+ * @return 统计指针
+ */
+const test_event_stats_t *test_event_get_stats(uint8_t stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_EVENT_H */
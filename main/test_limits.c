@@ -0,0 +1,178 @@
+/**
+ * @file test_limits.c
+ * @brief 测试限值判定模块实现
+ */
+
+#include "test_limits.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+esp_err_t test_limits_init(test_limits_t *limits, uint16_t step_count)
+{
+    if (limits == NULL || step_count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t size = sizeof(test_limit_stat_t) * step_count * ADS1115_CHANNEL_COUNT;
+
+    // 步骤数不变时复用已分配的数组
+    if (limits->stats == NULL || limits->step_count != step_count) {
+        test_limit_stat_t *stats = realloc(limits->stats, size);
+        if (stats == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        limits->stats = stats;
+        limits->step_count = step_count;
+    }
+
+    memset(limits->stats, 0, size);
+    limits->fail_count = 0;
+    limits->error_count = 0;
+
+    return ESP_OK;
+}
+
+void test_limits_free(test_limits_t *limits)
+{
+    if (limits == NULL) {
+        return;
+    }
+
+    free(limits->stats);
+    memset(limits, 0, sizeof(test_limits_t));
+}
+
+test_limit_stat_t *test_limits_get(const test_limits_t *limits, uint16_t step_index, uint8_t ch)
+{
+    if (limits->stats == NULL || step_index >= limits->step_count || ch >= ADS1115_CHANNEL_COUNT) {
+        return NULL;
+    }
+
+    return &limits->stats[step_index * ADS1115_CHANNEL_COUNT + ch];
+}
+
+bool test_limits_add(test_limits_t *limits, const test_step_t *step, uint16_t step_index,
+                     uint8_t ch, float current_ma)
+{
+    test_limit_stat_t *stat = test_limits_get(limits, step_index, ch);
+    if (stat == NULL) {
+        return true;
+    }
+
+    // Welford在线更新均值和方差
+    stat->count++;
+    if (stat->count == 1) {
+        stat->min_ma = current_ma;
+        stat->max_ma = current_ma;
+    } else {
+        if (current_ma < stat->min_ma) stat->min_ma = current_ma;
+        if (current_ma > stat->max_ma) stat->max_ma = current_ma;
+    }
+    float delta = current_ma - stat->mean_ma;
+    stat->mean_ma += delta / stat->count;
+    stat->m2 += delta * (current_ma - stat->mean_ma);
+
+    if ((step->limit_mask & (1 << ch)) &&
+        (current_ma < step->min_ma[ch] || current_ma > step->max_ma[ch])) {
+        stat->fail_count++;
+        limits->fail_count++;
+        return false;
+    }
+
+    return true;
+}
+
+void test_limits_add_error(test_limits_t *limits, const test_step_t *step, uint16_t step_index, uint8_t ch)
+{
+    test_limit_stat_t *stat = test_limits_get(limits, step_index, ch);
+    if (stat == NULL) {
+        return;
+    }
+
+    stat->error_count++;
+    if (step->limit_mask & (1 << ch)) {
+        limits->error_count++;
+    }
+}
+
+float test_limits_stddev(const test_limit_stat_t *stat)
+{
+    if (stat->count < 2) {
+        return 0.0f;
+    }
+
+    return sqrtf(stat->m2 / (stat->count - 1));
+}
+
+test_verdict_t test_limits_verdict(const test_limits_t *limits, const test_plan_t *plan)
+{
+    bool has_limits = false;
+    bool incomplete = false;
+
+    for (uint16_t i = 0; i < plan->step_count && i < limits->step_count; i++) {
+        const test_step_t *step = &plan->steps[i];
+        for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT; ch++) {
+            if (!(step->limit_mask & (1 << ch))) {
+                continue;
+            }
+            has_limits = true;
+            if (test_limits_get(limits, i, ch)->count == 0) {
+                incomplete = true;
+            }
+        }
+    }
+
+    if (!has_limits) {
+        return TEST_VERDICT_NO_LIMITS;
+    }
+    if (limits->fail_count > 0 || limits->error_count > 0) {
+        return TEST_VERDICT_FAIL;
+    }
+    if (incomplete) {
+        return TEST_VERDICT_INCOMPLETE;
+    }
+
+    return TEST_VERDICT_PASS;
+}
+
+const char *test_limits_verdict_str(test_verdict_t verdict)
+{
+    switch (verdict) {
+        case TEST_VERDICT_PASS:       return "合格(PASS)";
+        case TEST_VERDICT_FAIL:       return "不合格(FAIL)";
+        case TEST_VERDICT_INCOMPLETE: return "未完成(INCOMPLETE)";
+        default:                      return "未配置限值";
+    }
+}
+
+void test_limits_write_report(const test_limits_t *limits, const test_plan_t *plan, FILE *file)
+{
+    if (limits->stats == NULL || file == NULL) {
+        return;
+    }
+
+    fprintf(file, "--- 逐步骤统计 ---\n");
+    fprintf(file, "步骤,通道,样本数,最小(mA),最大(mA),均值(mA),标准差(mA),下限(mA),上限(mA),超限次数,读取失败,结果\n");
+
+    for (uint16_t i = 0; i < plan->step_count && i < limits->step_count; i++) {
+        const test_step_t *step = &plan->steps[i];
+        for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT; ch++) {
+            const test_limit_stat_t *stat = test_limits_get(limits, i, ch);
+            if (stat->count == 0 && stat->error_count == 0) {
+                continue;
+            }
+
+            fprintf(file, "%d,CH%d,%lu,%.3f,%.3f,%.3f,%.3f,", i + 1, ch, stat->count,
+                    stat->min_ma, stat->max_ma, stat->mean_ma, test_limits_stddev(stat));
+
+            if (step->limit_mask & (1 << ch)) {
+                bool pass = stat->fail_count == 0 && stat->error_count == 0 && stat->count > 0;
+                fprintf(file, "%.3f,%.3f,%lu,%lu,%s\n", step->min_ma[ch], step->max_ma[ch],
+                        stat->fail_count, stat->error_count, pass ? "PASS" : "FAIL");
+            } else {
+                fprintf(file, ",,%lu,%lu,-\n", stat->fail_count, stat->error_count);
+            }
+        }
+    }
+}
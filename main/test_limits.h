@@ -0,0 +1,144 @@
+/**
+ * @file test_limits.h
+ * @brief 测试限值判定模块头文件
+ *
+ * 按测试计划的步骤和通道在线累计电流统计(样本数/最小/最大/均值/方差)，
+ * 使用Welford算法，内存占用与采样次数无关。
+ * 与步骤中配置的电流窗口比较，测试结束时给出合格/不合格结论。
+ */
+
+#ifndef TEST_LIMITS_H
+#define TEST_LIMITS_H
+
+#include "esp_err.h"
+#include "test_plan.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 测试结论 */
+typedef enum {
+    TEST_VERDICT_NO_LIMITS = 0,                          /*!< 计划未配置限值 */
+    TEST_VERDICT_PASS,                                   /*!< 合格 */
+    TEST_VERDICT_FAIL,                                   /*!< 不合格 */
+    TEST_VERDICT_INCOMPLETE,                             /*!< 有限值的步骤未采样到 */
+} test_verdict_t;
+
+/* 单个步骤单个通道的统计 */
+typedef struct {
+    uint32_t count;                                      /*!< 有效样本数 */
+    uint32_t fail_count;                                 /*!< 超限样本数 */
+    uint32_t error_count;                                /*!< 读取失败次数 */
+    float min_ma;                                        /*!< 最小电流(毫安) */
+    float max_ma;                                        /*!< 最大电流(毫安) */
+    float mean_ma;                                       /*!< 平均电流(毫安) */
+    float m2;                                            /*!< 与均值差的平方和(Welford) */
+} test_limit_stat_t;
+
+/* 限值判定上下文 */
+typedef struct {
+    test_limit_stat_t *stats;                            /*!< 统计数组[步骤][通道] */
+    uint16_t step_count;                                 /*!< 步骤数量 */
+    uint32_t fail_count;                                 /*!< 超限样本总数 */
+    uint32_t error_count;                                /*!< 有限值通道的读取失败总数 */
+} test_limits_t;
+
+/**
+ * @brief 初始化限值判定上下文
+ *
+ * 按计划步骤数分配统计数组并清零，可重复调用
+ *
+ * @param limits 限值判定上下文
+ * @param step_count 计划步骤数
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数无效
+ *         - ESP_ERR_NO_MEM: 内存不足
+ */
+esp_err_t test_limits_init(test_limits_t *limits, uint16_t step_count);
+
+/**
+ * @brief 释放限值判定上下文
+ *
+ * @param limits 限值判定上下文
+ */
+void test_limits_free(test_limits_t *limits);
+
+/**
+ * @brief 获取步骤通道的统计
+ *
+ * @param limits 限值判定上下文
+ * @param step_index 步骤索引
+ * @param ch 通道号
+ * @return 统计指针，索引无效时返回NULL
+ */
+test_limit_stat_t *test_limits_get(const test_limits_t *limits, uint16_t step_index, uint8_t ch);
+
+/**
+ * @brief 累计一个样本并与步骤电流窗口比较
+ *
+ * @param limits 限值判定上下文
+ * @param step 测试步骤
+ * @param step_index 步骤索引
+ * @param ch 通道号
+ * @param current_ma 电流(毫安)
+ * @return true: 在窗口内或未配置限值, false: 超限
+ */
+bool test_limits_add(test_limits_t *limits, const test_step_t *step, uint16_t step_index,
+                     uint8_t ch, float current_ma);
+
+/**
+ * @brief 记录一次通道读取失败
+ *
+ * 有限值的通道读取失败按超限处理
+ *
+ * @param limits 限值判定上下文
+ * @param step 测试步骤
+ * @param step_index 步骤索引
+ * @param ch 通道号
+ */
+void test_limits_add_error(test_limits_t *limits, const test_step_t *step, uint16_t step_index, uint8_t ch);
+
+/**
+ * @brief 计算统计的标准差
+ *
+ * @param stat 统计
+ * @return 样本标准差(毫安)，样本数不足时为0
+ */
+float test_limits_stddev(const test_limit_stat_t *stat);
+
+/**
+ * @brief 根据统计和计划得出测试结论
+ *
+ * @param limits 限值判定上下文
+ * @param plan 测试计划
+ * @return 测试结论
+ */
+test_verdict_t test_limits_verdict(const test_limits_t *limits, const test_plan_t *plan);
+
+/**
+ * @brief 获取测试结论的显示字符串
+ *
+ * @param verdict 测试结论
+ * @return 结论字符串
+ */
+const char *test_limits_verdict_str(test_verdict_t verdict);
+
+/**
+ * @brief 将逐步骤统计报告写入文件
+ *
+ * @param limits 限值判定上下文
+ * @param plan 测试计划
+ * @param file 已打开的文件
+ */
+void test_limits_write_report(const test_limits_t *limits, const test_plan_t *plan, FILE *file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_LIMITS_H */
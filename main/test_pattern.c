@@ -0,0 +1,133 @@
+/**
+ * @file test_pattern.c
+ * @brief TCA9535输出图案生成模块实现
+ */
+
+#include "test_pattern.h"
+#include <string.h>
+
+static const char *pattern_names[] = {
+    [TEST_PATTERN_NONE]  = "none",
+    [TEST_PATTERN_WALK1] = "walk1",
+    [TEST_PATTERN_WALK0] = "walk0",
+    [TEST_PATTERN_GRAY]  = "gray",
+    [TEST_PATTERN_PAIRS] = "pairs",
+};
+
+/**
+ * @brief 由当前迭代状态计算输出字
+ */
+static void test_pattern_update(test_pattern_iter_t *iter)
+{
+    uint16_t pattern = 0;
+
+    switch (iter->type) {
+    case TEST_PATTERN_WALK1:
+        pattern = 1 << iter->pins[iter->a];
+        break;
+    case TEST_PATTERN_WALK0:
+        pattern = iter->mask & ~(1 << iter->pins[iter->a]);
+        break;
+    case TEST_PATTERN_GRAY:
+        pattern = iter->gray;
+        break;
+    case TEST_PATTERN_PAIRS:
+        pattern = (1 << iter->pins[iter->a]) | (1 << iter->pins[iter->b]);
+        break;
+    default:
+        iter->output = iter->base;
+        return;
+    }
+
+    iter->output = (iter->base & ~iter->mask) | (pattern & iter->mask);
+}
+
+uint32_t test_pattern_count(test_pattern_type_t type, uint16_t mask)
+{
+    uint32_t n = __builtin_popcount(mask);
+
+    switch (type) {
+    case TEST_PATTERN_WALK1:
+    case TEST_PATTERN_WALK0:
+        return n;
+    case TEST_PATTERN_GRAY:
+        return 1UL << n;
+    case TEST_PATTERN_PAIRS:
+        return n * (n - 1) / 2;
+    default:
+        return 1;
+    }
+}
+
+void test_pattern_begin(test_pattern_iter_t *iter, test_pattern_type_t type, uint16_t mask, uint16_t base)
+{
+    memset(iter, 0, sizeof(test_pattern_iter_t));
+    iter->type = type;
+    iter->mask = mask;
+    iter->base = base;
+    iter->count = test_pattern_count(type, mask);
+
+    for (uint8_t pin = 0; pin < TEST_PATTERN_PIN_COUNT; pin++) {
+        if (mask & (1 << pin)) {
+            iter->pins[iter->pin_count++] = pin;
+        }
+    }
+
+    // 引脚不足以构成图案时退化为固定输出
+    if (iter->count == 0) {
+        iter->type = TEST_PATTERN_NONE;
+        iter->count = 1;
+    }
+
+    iter->b = 1;
+    test_pattern_update(iter);
+}
+
+bool test_pattern_next(test_pattern_iter_t *iter)
+{
+    if (iter->index + 1 >= iter->count) {
+        return false;
+    }
+    iter->index++;
+
+    switch (iter->type) {
+    case TEST_PATTERN_WALK1:
+    case TEST_PATTERN_WALK0:
+        iter->a++;
+        break;
+    case TEST_PATTERN_GRAY:
+        // 相邻格雷码只差序号最低置位对应的一位
+        iter->gray ^= 1 << iter->pins[__builtin_ctz(iter->index)];
+        break;
+    case TEST_PATTERN_PAIRS:
+        if (++iter->b >= iter->pin_count) {
+            iter->a++;
+            iter->b = iter->a + 1;
+        }
+        break;
+    default:
+        break;
+    }
+
+    test_pattern_update(iter);
+    return true;
+}
+
+esp_err_t test_pattern_parse(const char *name, test_pattern_type_t *type)
+{
+    for (size_t i = 0; i < sizeof(pattern_names) / sizeof(pattern_names[0]); i++) {
+        if (strcmp(name, pattern_names[i]) == 0) {
+            *type = (test_pattern_type_t)i;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+const char *test_pattern_name(test_pattern_type_t type)
+{
+    if ((size_t)type < sizeof(pattern_names) / sizeof(pattern_names[0])) {
+        return pattern_names[type];
+    }
+    return "unknown";
+}
@@ -0,0 +1,102 @@
+/**
+ * @file test_pattern.h
+ * @brief TCA9535输出图案生成模块头文件
+ *
+ * 在掩码选中的引脚上逐个生成测试图案，每次只由上一个值计算下一个值，
+ * 不需要预先展开的图案表：
+ * - walk1  走1：每次只有一个引脚为1
+ * - walk0  走0：每次只有一个引脚为0
+ * - gray   格雷码：遍历所有组合，相邻图案只有一个引脚变化
+ * - pairs  两两组合：每次两个引脚为1，覆盖所有引脚对
+ *
+ * 掩码以外的引脚保持步骤out参数的值。
+ */
+
+#ifndef TEST_PATTERN_H
+#define TEST_PATTERN_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TEST_PATTERN_PIN_COUNT 16                        /*!< TCA9535引脚数 */
+
+/* 图案类型 */
+typedef enum {
+    TEST_PATTERN_NONE = 0,                               /*!< 固定输出 */
+    TEST_PATTERN_WALK1,                                  /*!< 走1 */
+    TEST_PATTERN_WALK0,                                  /*!< 走0 */
+    TEST_PATTERN_GRAY,                                   /*!< 格雷码 */
+    TEST_PATTERN_PAIRS,                                  /*!< 两两组合 */
+} test_pattern_type_t;
+
+/* 图案迭代器 */
+typedef struct {
+    uint8_t type;                                        /*!< 图案类型 */
+    uint8_t pin_count;                                   /*!< 掩码选中的引脚数 */
+    uint8_t pins[TEST_PATTERN_PIN_COUNT];                /*!< 选中的引脚号(升序) */
+    uint16_t mask;                                       /*!< 引脚掩码 */
+    uint16_t base;                                       /*!< 掩码以外引脚的输出值 */
+    uint8_t a;                                           /*!< 当前引脚(走1/走0)或引脚对的第一个 */
+    uint8_t b;                                           /*!< 引脚对的第二个 */
+    uint16_t gray;                                       /*!< 当前格雷码图案(已映射到引脚) */
+    uint32_t index;                                      /*!< 当前图案序号(从0开始) */
+    uint32_t count;                                      /*!< 图案总数 */
+    uint16_t output;                                     /*!< 当前输出字 */
+} test_pattern_iter_t;
+
+/**
+ * @brief 计算图案数量
+ *
+ * @param type 图案类型
+ * @param mask 引脚掩码
+ * @return 图案数量(固定输出为1)
+ */
+uint32_t test_pattern_count(test_pattern_type_t type, uint16_t mask);
+
+/**
+ * @brief 开始迭代，计算第一个图案
+ *
+ * @param iter 迭代器
+ * @param type 图案类型
+ * @param mask 引脚掩码
+ * @param base 掩码以外引脚的输出值
+ */
+void test_pattern_begin(test_pattern_iter_t *iter, test_pattern_type_t type, uint16_t mask, uint16_t base);
+
+/**
+ * @brief 计算下一个图案
+ *
+ * @param iter 迭代器
+ * @return true: iter->output为新图案, false: 所有图案已完成
+ */
+bool test_pattern_next(test_pattern_iter_t *iter);
+
+/**
+ * @brief 解析图案名称
+ *
+ * @param name 名称(walk1/walk0/gray/pairs/none)
+ * @param type 输出的图案类型
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_NOT_FOUND: 未知图案
+ */
+esp_err_t test_pattern_parse(const char *name, test_pattern_type_t *type);
+
+/**
+ * @brief 获取图案名称
+ *
+ * @param type 图案类型
+ * @return 名称
+ */
+const char *test_pattern_name(test_pattern_type_t type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_PATTERN_H */
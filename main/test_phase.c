@@ -0,0 +1,135 @@
+/**
+ * @file test_phase.c
+ * @brief 测试循环阶段计时模块实现
+ */
+
+#include "test_phase.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+// 记录、清空和读取可能在不同任务中同时进行，临界区内只做少量赋值
+static portMUX_TYPE phase_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *phase_names[TEST_PHASE_COUNT] = {
+    [TEST_PHASE_ADC]     = "ADC扫描",
+    [TEST_PHASE_TCA]     = "TCA9535",
+    [TEST_PHASE_LED]     = "LED",
+    [TEST_PHASE_SD]      = "SD写入",
+    [TEST_PHASE_CONSOLE] = "终端输出",
+    [TEST_PHASE_CAPTURE] = "稳定捕获",
+    [TEST_PHASE_CYCLE]   = "整个循环",
+};
+
+/* 命令行中使用的阶段关键字 */
+static const char *phase_keys[TEST_PHASE_COUNT] = {
+    [TEST_PHASE_ADC]     = "adc",
+    [TEST_PHASE_TCA]     = "tca",
+    [TEST_PHASE_LED]     = "led",
+    [TEST_PHASE_SD]      = "sd",
+    [TEST_PHASE_CONSOLE] = "console",
+    [TEST_PHASE_CAPTURE] = "capture",
+    [TEST_PHASE_CYCLE]   = "cycle",
+};
+
+void test_phase_reset(test_phase_stats_t *stats)
+{
+    portENTER_CRITICAL(&phase_lock);
+    memset(stats, 0, sizeof(test_phase_stats_t));
+    portEXIT_CRITICAL(&phase_lock);
+}
+
+void test_phase_record(test_phase_stats_t *stats, test_phase_t phase, uint32_t elapsed_us)
+{
+    if (stats == NULL || phase >= TEST_PHASE_COUNT) {
+        return;
+    }
+
+    // 按最高有效位分桶
+    uint8_t bucket = (elapsed_us == 0) ? 0 : 32 - __builtin_clz(elapsed_us);
+    if (bucket >= TEST_PHASE_HIST_BUCKETS) {
+        bucket = TEST_PHASE_HIST_BUCKETS - 1;
+    }
+
+    portENTER_CRITICAL(&phase_lock);
+    test_phase_stat_t *stat = &stats->phase[phase];
+    if (stat->count == 0 || elapsed_us < stat->min_us) {
+        stat->min_us = elapsed_us;
+    }
+    if (elapsed_us > stat->max_us) {
+        stat->max_us = elapsed_us;
+    }
+    stat->count++;
+    stat->total_us += elapsed_us;
+    stat->hist[bucket]++;
+    portEXIT_CRITICAL(&phase_lock);
+}
+
+esp_err_t test_phase_get(const test_phase_stats_t *stats, test_phase_t phase, test_phase_stat_t *out)
+{
+    if (stats == NULL || phase >= TEST_PHASE_COUNT || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&phase_lock);
+    *out = stats->phase[phase];
+    portEXIT_CRITICAL(&phase_lock);
+    return ESP_OK;
+}
+
+const char *test_phase_name(test_phase_t phase)
+{
+    return (phase < TEST_PHASE_COUNT) ? phase_names[phase] : "未知";
+}
+
+esp_err_t test_phase_parse(const char *key, test_phase_t *phase)
+{
+    for (int i = 0; i < TEST_PHASE_COUNT; i++) {
+        if (strcmp(key, phase_keys[i]) == 0) {
+            *phase = (test_phase_t)i;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+uint32_t test_phase_bucket_limit(uint8_t bucket)
+{
+    if (bucket >= TEST_PHASE_HIST_BUCKETS - 1) {
+        return 0;
+    }
+    return 1UL << bucket;
+}
+
+void test_phase_write_report(const test_phase_stats_t *stats, FILE *file)
+{
+    if (stats == NULL || file == NULL) {
+        return;
+    }
+
+    fprintf(file, "--- 阶段耗时统计 ---\n");
+    fprintf(file, "阶段,次数,最小(us),平均(us),最大(us),直方图(上界us:次数)\n");
+
+    for (int i = 0; i < TEST_PHASE_COUNT; i++) {
+        test_phase_stat_t snapshot;
+        test_phase_get(stats, (test_phase_t)i, &snapshot);
+        const test_phase_stat_t *stat = &snapshot;
+        if (stat->count == 0) {
+            continue;
+        }
+
+        fprintf(file, "%s,%lu,%lu,%lu,%lu,", phase_names[i], stat->count, stat->min_us,
+                (uint32_t)(stat->total_us / stat->count), stat->max_us);
+        for (uint8_t b = 0; b < TEST_PHASE_HIST_BUCKETS; b++) {
+            if (stat->hist[b] == 0) {
+                continue;
+            }
+            uint32_t limit = test_phase_bucket_limit(b);
+            if (limit > 0) {
+                fprintf(file, " <%lu:%lu", limit, stat->hist[b]);
+            } else {
+                fprintf(file, " >=%lu:%lu", 1UL << (TEST_PHASE_HIST_BUCKETS - 2), stat->hist[b]);
+            }
+        }
+        fprintf(file, "\n");
+    }
+}
@@ -0,0 +1,133 @@
+/**
+ * @file test_phase.h
+ * @brief 测试循环阶段计时模块头文件
+ *
+ * 用esp_timer_get_time()记录测试循环各阶段(ADC扫描、TCA9535更新、LED更新、
+ * SD卡写入、终端输出、稳定过程捕获)的耗时，统计最小/最大/平均值和对数直方图，
+ * 用于定位循环耗时的瓶颈和发现性能退化。每个测试会话一组统计，测试任务、
+ * 日志任务和命令任务可同时访问。
+ */
+
+#ifndef TEST_PHASE_H
+#define TEST_PHASE_H
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 直方图桶数：桶0为0us，桶i(i>0)为[2^(i-1), 2^i)us，最后一个桶包含更大的值 */
+#define TEST_PHASE_HIST_BUCKETS 21
+
+/* 测试循环阶段 */
+typedef enum {
+    TEST_PHASE_ADC = 0,                                  /*!< ADS1115扫描 */
+    TEST_PHASE_TCA,                                      /*!< TCA9535输出更新 */
+    TEST_PHASE_LED,                                      /*!< LED更新 */
+    TEST_PHASE_SD,                                       /*!< SD卡写入 */
+    TEST_PHASE_CONSOLE,                                  /*!< 终端输出 */
+    TEST_PHASE_CAPTURE,                                  /*!< 稳定过程捕获 */
+    TEST_PHASE_CYCLE,                                    /*!< 整个循环 */
+    TEST_PHASE_COUNT
+} test_phase_t;
+
+/* 单个阶段的耗时统计 */
+typedef struct {
+    uint32_t count;                                      /*!< 次数 */
+    uint32_t min_us;                                     /*!< 最小耗时(微秒) */
+    uint32_t max_us;                                     /*!< 最大耗时(微秒) */
+    uint64_t total_us;                                   /*!< 总耗时(微秒) */
+    uint32_t hist[TEST_PHASE_HIST_BUCKETS];              /*!< 耗时直方图 */
+} test_phase_stat_t;
+
+/* 一个测试会话的各阶段统计 */
+typedef struct {
+    test_phase_stat_t phase[TEST_PHASE_COUNT];           /*!< 按阶段索引 */
+} test_phase_stats_t;
+
+/**
+ * @brief 清空一组阶段统计
+ *
+ * @param stats 阶段统计
+ */
+void test_phase_reset(test_phase_stats_t *stats);
+
+/**
+ * @brief 记录一次阶段耗时
+ *
+ * @param stats 阶段统计
+ * @param phase 阶段
+ * @param elapsed_us 耗时(微秒)
+ */
+void test_phase_record(test_phase_stats_t *stats, test_phase_t phase, uint32_t elapsed_us);
+
+/**
+ * @brief 记录从start_us到现在的阶段耗时
+ *
+ * @param stats 阶段统计
+ * @param phase 阶段
+ * @param start_us 阶段开始时间(esp_timer_get_time)
+ */
+static inline void test_phase_end(test_phase_stats_t *stats, test_phase_t phase, int64_t start_us)
+{
+    test_phase_record(stats, phase, (uint32_t)(esp_timer_get_time() - start_us));
+}
+
+/**
+ * @brief 获取阶段统计的一致副本
+ *
+ * 统计可能正被其他任务更新，复制时不会读到更新了一半的记录
+ *
+ * @param stats 阶段统计
+ * @param phase 阶段
+ * @param out 输出的统计副本
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 阶段无效
+ */
+esp_err_t test_phase_get(const test_phase_stats_t *stats, test_phase_t phase, test_phase_stat_t *out);
+
+/**
+ * @brief 获取阶段名称
+ *
+ * @param phase 阶段
+ * @return 阶段名称
+ */
+const char *test_phase_name(test_phase_t phase);
+
+/**
+ * @brief 解析阶段关键字
+ *
+ * @param key 阶段关键字(adc/tca/led/sd/console/capture/cycle)
+ * @param phase 输出的阶段
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_NOT_FOUND: 未知阶段
+ */
+esp_err_t test_phase_parse(const char *key, test_phase_t *phase);
+
+/**
+ * @brief 获取直方图桶的上界
+ *
+ * @param bucket 桶索引
+ * @return 桶上界(微秒，不含)，最后一个桶返回0表示无上界
+ */
+uint32_t test_phase_bucket_limit(uint8_t bucket);
+
+/**
+ * @brief 将各阶段统计写入文件
+ *
+ * @param stats 阶段统计
+ * @param file 已打开的文件
+ */
+void test_phase_write_report(const test_phase_stats_t *stats, FILE *file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_PHASE_H */
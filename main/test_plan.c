@@ -0,0 +1,314 @@
+/**
+ * @file test_plan.c
+ * @brief 测试计划模块实现
+ */
+
+#include "test_plan.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "TEST_PLAN";
+
+/* 内置默认计划参数 */
+#define TEST_PLAN_DEFAULT_IO_COUNT   8
+#define TEST_PLAN_DEFAULT_LED_COUNT  4
+
+/**
+ * @brief 初始化步骤为默认值
+ */
+static void test_plan_step_init(test_step_t *step)
+{
+    memset(step, 0, sizeof(test_step_t));
+    step->output = 0xFFFF;
+    step->samples = 1;
+    step->pattern = TEST_PATTERN_NONE;
+    step->pattern_mask = 0xFFFF;
+}
+
+/**
+ * @brief 解析电流窗口 "最小值:最大值"
+ */
+static bool test_plan_parse_window(const char *value, float *min_ma, float *max_ma)
+{
+    const char *sep = strchr(value, ':');
+    if (sep == NULL) {
+        return false;
+    }
+
+    char *end;
+    *min_ma = -1e9f;
+    *max_ma = 1e9f;
+
+    if (sep != value) {
+        *min_ma = strtof(value, &end);
+        if (end != sep) {
+            return false;
+        }
+    }
+
+    if (*(sep + 1) != '\0') {
+        *max_ma = strtof(sep + 1, &end);
+        if (*end != '\0') {
+            return false;
+        }
+    }
+
+    return *min_ma <= *max_ma;
+}
+
+/**
+ * @brief 解析一个step参数 key=value
+ */
+static bool test_plan_parse_param(test_step_t *step, char *token)
+{
+    char *value = strchr(token, '=');
+    if (value == NULL) {
+        return false;
+    }
+    *value++ = '\0';
+
+    char *end;
+    if (strcmp(token, "out") == 0) {
+        unsigned long out = strtoul(value, &end, 0);
+        if (*end != '\0' || out > 0xFFFF) {
+            return false;
+        }
+        step->output = (uint16_t)out;
+    } else if (strcmp(token, "led") == 0) {
+        unsigned long led = strtoul(value, &end, 0);
+        if (*end != '\0' || led > 0x0F) {
+            return false;
+        }
+        step->led_mask = (uint8_t)led;
+    } else if (strcmp(token, "dwell") == 0) {
+        unsigned long dwell = strtoul(value, &end, 0);
+        if (*end != '\0') {
+            return false;
+        }
+        step->dwell_ms = (uint32_t)dwell;
+    } else if (strcmp(token, "samples") == 0) {
+        unsigned long samples = strtoul(value, &end, 0);
+        if (*end != '\0' || samples > TEST_PLAN_MAX_SAMPLES) {
+            return false;
+        }
+        step->samples = (uint8_t)samples;
+    } else if (strncmp(token, "ch", 2) == 0 && token[2] >= '0' &&
+               token[2] < '0' + ADS1115_CHANNEL_COUNT && token[3] == '\0') {
+        uint8_t ch = token[2] - '0';
+        if (!test_plan_parse_window(value, &step->min_ma[ch], &step->max_ma[ch])) {
+            return false;
+        }
+        step->limit_mask |= (1 << ch);
+    } else if (strcmp(token, "pattern") == 0) {
+        test_pattern_type_t type;
+        if (test_pattern_parse(value, &type) != ESP_OK) {
+            return false;
+        }
+        step->pattern = type;
+    } else if (strcmp(token, "mask") == 0) {
+        unsigned long mask = strtoul(value, &end, 0);
+        if (*end != '\0' || mask == 0 || mask > 0xFFFF) {
+            return false;
+        }
+        step->pattern_mask = (uint16_t)mask;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+esp_err_t test_plan_load_default(test_plan_t *plan)
+{
+    test_step_t *steps = malloc(sizeof(test_step_t) * TEST_PLAN_DEFAULT_IO_COUNT);
+    if (steps == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // IO1-8依次拉低(P1保持全高)，LED1-4依次点亮
+    for (uint8_t i = 0; i < TEST_PLAN_DEFAULT_IO_COUNT; i++) {
+        test_plan_step_init(&steps[i]);
+        steps[i].output = 0xFFFF & ~(1 << i);
+        steps[i].led_mask = 1 << (i % TEST_PLAN_DEFAULT_LED_COUNT);
+    }
+
+    test_plan_free(plan);
+    plan->steps = steps;
+    plan->step_count = TEST_PLAN_DEFAULT_IO_COUNT;
+    plan->repeat = 0;
+    strncpy(plan->name, "内置默认计划", sizeof(plan->name) - 1);
+    plan->name[sizeof(plan->name) - 1] = '\0';
+
+    return ESP_OK;
+}
+
+esp_err_t test_plan_load_pattern(test_plan_t *plan, test_pattern_type_t type, uint16_t mask, uint32_t dwell_ms)
+{
+    if (test_pattern_count(type, mask) == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    test_step_t *step = malloc(sizeof(test_step_t));
+    if (step == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // 掩码以外的引脚保持高电平(与默认计划的非活动电平一致)
+    test_plan_step_init(step);
+    step->pattern = type;
+    step->pattern_mask = mask;
+    step->dwell_ms = dwell_ms;
+
+    test_plan_free(plan);
+    plan->steps = step;
+    plan->step_count = 1;
+    plan->repeat = 0;
+    snprintf(plan->name, sizeof(plan->name), "图案%s 掩码0x%04X", test_pattern_name(type), mask);
+
+    return ESP_OK;
+}
+
+esp_err_t test_plan_load_file(test_plan_t *plan, const char *path, char *error, size_t error_size)
+{
+    char dummy[8];
+    if (error == NULL) {
+        error = dummy;
+        error_size = sizeof(dummy);
+    }
+    error[0] = '\0';
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        snprintf(error, error_size, "无法打开文件 %s", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    test_step_t *steps = malloc(sizeof(test_step_t) * TEST_PLAN_MAX_STEPS);
+    if (steps == NULL) {
+        fclose(file);
+        snprintf(error, error_size, "内存不足");
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint16_t step_count = 0;
+    uint32_t repeat = 0;
+    esp_err_t ret = ESP_OK;
+    char line[256];
+    int line_number = 0;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+
+        // 去除注释
+        char *comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+
+        char *saveptr;
+        char *keyword = strtok_r(line, " \t\r\n", &saveptr);
+        if (keyword == NULL) {
+            continue; // 空行
+        }
+
+        if (strcmp(keyword, "repeat") == 0) {
+            char *value = strtok_r(NULL, " \t\r\n", &saveptr);
+            char *end;
+            if (value == NULL || (repeat = strtoul(value, &end, 0), *end != '\0')) {
+                snprintf(error, error_size, "第%d行: repeat参数无效", line_number);
+                ret = ESP_ERR_INVALID_ARG;
+                break;
+            }
+        } else if (strcmp(keyword, "step") == 0) {
+            if (step_count >= TEST_PLAN_MAX_STEPS) {
+                snprintf(error, error_size, "第%d行: 步骤数超过上限%d", line_number, TEST_PLAN_MAX_STEPS);
+                ret = ESP_ERR_INVALID_ARG;
+                break;
+            }
+
+            test_step_t *step = &steps[step_count];
+            test_plan_step_init(step);
+
+            char *token;
+            while ((token = strtok_r(NULL, " \t\r\n", &saveptr)) != NULL) {
+                if (!test_plan_parse_param(step, token)) {
+                    snprintf(error, error_size, "第%d行: 无效参数 '%s'", line_number, token);
+                    ret = ESP_ERR_INVALID_ARG;
+                    break;
+                }
+            }
+            if (ret != ESP_OK) {
+                break;
+            }
+            if (test_pattern_count(step->pattern, step->pattern_mask) == 0) {
+                snprintf(error, error_size, "第%d行: 掩码引脚数不足以构成%s图案",
+                         line_number, test_pattern_name(step->pattern));
+                ret = ESP_ERR_INVALID_ARG;
+                break;
+            }
+            step_count++;
+        } else {
+            snprintf(error, error_size, "第%d行: 未知关键字 '%s'", line_number, keyword);
+            ret = ESP_ERR_INVALID_ARG;
+            break;
+        }
+    }
+    fclose(file);
+
+    if (ret == ESP_OK && step_count == 0) {
+        snprintf(error, error_size, "计划中没有步骤");
+        ret = ESP_ERR_INVALID_ARG;
+    }
+
+    if (ret != ESP_OK) {
+        free(steps);
+        return ret;
+    }
+
+    // 收缩到实际大小
+    test_step_t *shrunk = realloc(steps, sizeof(test_step_t) * step_count);
+    if (shrunk != NULL) {
+        steps = shrunk;
+    }
+
+    test_plan_free(plan);
+    plan->steps = steps;
+    plan->step_count = step_count;
+    plan->repeat = repeat;
+    strncpy(plan->name, path, sizeof(plan->name) - 1);
+    plan->name[sizeof(plan->name) - 1] = '\0';
+
+    ESP_LOGI(TAG, "测试计划加载成功: %s (%d个步骤, 重复%lu次)", path, step_count, repeat);
+    return ESP_OK;
+}
+
+void test_plan_free(test_plan_t *plan)
+{
+    if (plan == NULL) {
+        return;
+    }
+
+    free(plan->steps);
+    plan->steps = NULL;
+    plan->step_count = 0;
+    plan->repeat = 0;
+    plan->name[0] = '\0';
+}
+
+uint32_t test_plan_output_count(const test_plan_t *plan)
+{
+    uint32_t count = 0;
+    for (uint16_t i = 0; i < plan->step_count; i++) {
+        count += test_pattern_count(plan->steps[i].pattern, plan->steps[i].pattern_mask);
+    }
+    return count;
+}
+
+uint32_t test_plan_dwell_ticks(const test_step_t *step, uint32_t period_ms)
+{
+    // 向上取整，输出切换后至少等待一个周期再采样
+    uint32_t ticks = (step->dwell_ms + period_ms - 1) / period_ms;
+    return ticks > 0 ? ticks : 1;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file test_plan.h
+ * @brief 测试计划模块头文件
+ *
+ * 测试计划描述自动化测试的步骤序列，从SD卡文本文件加载，
+ * 解析一次后保存为紧凑的步骤数组，由测试任务逐拍解释执行。
+ *
+ * 文件格式(每行一条，#开头为注释)：
+ * @code
+ * repeat 10                          # 计划重复次数，0为无限循环(默认)
+ * step out=0xFFFE led=0x1 dwell=500 samples=2 ch0=5.0:20.0 ch1=:50
+ * step pattern=walk0 mask=0xFFFF dwell=100 # 16个引脚依次拉低
+ * @endcode
+ *
+ * step参数：
+ * - out      TCA9535输出字(16位，P0为低字节)，默认0xFFFF
+ * - led      LED掩码(bit0=LED1 ... bit3=LED4)，默认0
+ * - dwell    输出切换后到首次采样的驻留时间(毫秒)，默认0(下一个周期)
+ * - samples  采样次数(每个周期一次)，默认1
+ * - chN      通道N的期望电流窗口 最小值:最大值(毫安)，可省略任一端
+ * - pattern  输出图案(walk1/walk0/gray/pairs，见test_pattern.h)，默认固定输出out
+ * - mask     图案作用的引脚掩码，默认0xFFFF；掩码以外的引脚保持out的值
+ *
+ * 带图案的步骤对每个图案依次执行一次驻留和采样，限值统计按步骤汇总。
+ */
+
+#ifndef TEST_PLAN_H
+#define TEST_PLAN_H
+
+#include "esp_err.h"
+#include "i2c_config.h"
+#include "test_pattern.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 测试计划配置常量 */
+#define TEST_PLAN_DEFAULT_PATH  "/sdcard/testplan.txt"   /*!< 默认测试计划文件 */
+#define TEST_PLAN_MAX_STEPS     256                      /*!< 最大步骤数 */
+#define TEST_PLAN_MAX_SAMPLES   255                      /*!< 单步最大采样次数 */
+#define TEST_PLAN_NAME_LEN      64                       /*!< 计划名称长度 */
+
+/* 单个测试步骤 */
+typedef struct {
+    uint32_t dwell_ms;                                   /*!< 驻留时间(毫秒) */
+    uint16_t output;                                     /*!< TCA9535输出字 */
+    uint8_t led_mask;                                    /*!< LED掩码 */
+    uint8_t samples;                                     /*!< 采样次数 */
+    uint8_t limit_mask;                                  /*!< 设置了电流窗口的通道掩码 */
+    uint8_t pattern;                                     /*!< 输出图案(test_pattern_type_t) */
+    uint16_t pattern_mask;                               /*!< 图案作用的引脚掩码 */
+    float min_ma[ADS1115_CHANNEL_COUNT];                 /*!< 电流下限(毫安) */
+    float max_ma[ADS1115_CHANNEL_COUNT];                 /*!< 电流上限(毫安) */
+} test_step_t;
+
+/* 测试计划 */
+typedef struct {
+    char name[TEST_PLAN_NAME_LEN];                       /*!< 计划名称(文件路径或内置) */
+    test_step_t *steps;                                  /*!< 步骤数组 */
+    uint16_t step_count;                                 /*!< 步骤数量 */
+    uint32_t repeat;                                     /*!< 重复次数，0为无限循环 */
+} test_plan_t;
+
+/**
+ * @brief 生成内置默认计划
+ *
+ * 与固定测试行为一致：IO1-8依次拉低，LED1-4依次点亮，每周期采样一次
+ *
+ * @param plan 输出的测试计划
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_NO_MEM: 内存不足
+ */
+esp_err_t test_plan_load_default(test_plan_t *plan);
+
+/**
+ * @brief 从文件加载测试计划
+ *
+ * 解析成功才会替换计划内容，失败时原计划保持不变
+ *
+ * @param plan 测试计划
+ * @param path 文件路径
+ * @param error 输出的错误描述(可为NULL)
+ * @param error_size 错误描述缓冲区大小
+ * @return esp_err_t
+ *         - ESP_OK: 加载成功
+ *         - ESP_ERR_NOT_FOUND: 文件不存在
+ *         - ESP_ERR_INVALID_ARG: 文件格式错误
+ *         - ESP_ERR_NO_MEM: 内存不足
+ */
+esp_err_t test_plan_load_file(test_plan_t *plan, const char *path, char *error, size_t error_size);
+
+/**
+ * @brief 释放测试计划
+ *
+ * @param plan 测试计划
+ */
+void test_plan_free(test_plan_t *plan);
+
+/**
+ * @brief 生成单步骤的图案计划
+ *
+ * 不需要SD卡即可对全部16个引脚执行图案测试
+ *
+ * @param plan 输出的测试计划
+ * @param type 图案类型
+ * @param mask 引脚掩码
+ * @param dwell_ms 每个图案的驻留时间(毫秒)
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 掩码引脚数不足以构成图案
+ *         - ESP_ERR_NO_MEM: 内存不足
+ */
+esp_err_t test_plan_load_pattern(test_plan_t *plan, test_pattern_type_t type, uint16_t mask, uint32_t dwell_ms);
+
+/**
+ * @brief 计算计划一轮的输出图案总数
+ *
+ * @param plan 测试计划
+ * @return 图案总数(固定输出的步骤计为1)
+ */
+uint32_t test_plan_output_count(const test_plan_t *plan);
+
+/**
+ * @brief 计算步骤驻留的周期数
+ *
+ * @param step 测试步骤
+ * @param period_ms 循环周期(毫秒)
+ * @return 驻留周期数(至少为1)
+ */
+uint32_t test_plan_dwell_ticks(const test_step_t *step, uint32_t period_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_PLAN_H */
@@ -0,0 +1,116 @@
+/**
+ * @file test_scheduler.c
+ * @brief 测试循环周期调度器实现
+ */
+
+#include "test_scheduler.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "TEST_SCHED";
+
+/**
+ * @brief 周期定时器回调(运行在esp_timer任务中)
+ */
+static void test_scheduler_timer_cb(void *arg)
+{
+    test_scheduler_t *sched = (test_scheduler_t *)arg;
+
+    // 节拍计数由定时器维护，任务据此判断是否丢失节拍
+    sched->fired_ticks++;
+    xTaskNotify(sched->task, TEST_SCHED_NOTIFY_TICK, eSetBits);
+}
+
+esp_err_t test_scheduler_start(test_scheduler_t *sched, TaskHandle_t task, uint32_t period_ms)
+{
+    return test_scheduler_start_us(sched, task, period_ms * 1000);
+}
+
+esp_err_t test_scheduler_start_us(test_scheduler_t *sched, TaskHandle_t task, uint32_t period_us)
+{
+    if (sched == NULL || task == NULL || period_us < TEST_SCHED_MIN_PERIOD_US) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(sched, 0, sizeof(test_scheduler_t));
+    sched->task = task;
+    sched->period_us = period_us;
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = test_scheduler_timer_cb,
+        .arg = sched,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "test_sched",
+        .skip_unhandled_events = false,
+    };
+
+    esp_err_t ret = esp_timer_create(&timer_args, &sched->timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "创建调度定时器失败: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    sched->start_us = esp_timer_get_time();
+    ret = esp_timer_start_periodic(sched->timer, sched->period_us);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "启动调度定时器失败: %s", esp_err_to_name(ret));
+        esp_timer_delete(sched->timer);
+        sched->timer = NULL;
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "调度器启动，周期: %lu us", period_us);
+    return ESP_OK;
+}
+
+esp_err_t test_scheduler_wait(test_scheduler_t *sched, test_scheduler_tick_t *tick, TickType_t timeout)
+{
+    uint32_t bits = 0;
+
+    // 节拍已到但尚未处理时直接返回，否则阻塞等待定时器通知或停止请求
+    while (sched->fired_ticks == sched->consumed_ticks || sched->stop_requested) {
+        if (sched->stop_requested) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        if (xTaskNotifyWait(0, TEST_SCHED_NOTIFY_TICK | TEST_SCHED_NOTIFY_STOP, &bits, timeout) != pdTRUE) {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    uint32_t fired = sched->fired_ticks;
+
+    // 一次唤醒跨越多个节拍说明上一个循环超时
+    tick->missed = fired - sched->consumed_ticks - 1;
+    tick->tick = fired;
+    tick->timestamp_us = now_us;
+    tick->lateness_us = (int32_t)(now_us - (sched->start_us + (int64_t)fired * sched->period_us));
+    sched->consumed_ticks = fired;
+
+    return ESP_OK;
+}
+
+void test_scheduler_request_stop(test_scheduler_t *sched)
+{
+    sched->stop_requested = true;
+
+    // 调度器未启动时任务尚未开始等待，只设置标志
+    TaskHandle_t task = sched->task;
+    if (task != NULL) {
+        xTaskNotify(task, TEST_SCHED_NOTIFY_STOP, eSetBits);
+    }
+}
+
+void test_scheduler_stop(test_scheduler_t *sched)
+{
+    if (sched == NULL || sched->timer == NULL) {
+        return;
+    }
+
+    esp_timer_stop(sched->timer);
+    esp_timer_delete(sched->timer);
+    sched->timer = NULL;
+    sched->task = NULL;
+
+    ESP_LOGI(TAG, "调度器停止，共 %lu 个节拍", sched->fired_ticks);
+}
@@ -0,0 +1,117 @@
+/**
+ * @file test_scheduler.h
+ * @brief 测试循环周期调度器头文件
+ *
+ * 基于esp_timer周期定时器驱动测试循环：
+ * - 周期与单次循环耗时无关，不随ADC/SD延迟漂移
+ * - 周期可配置到毫秒甚至亚毫秒级(不受FreeRTOS节拍10ms限制)
+ * - 检测超时(丢失的节拍)并记录每个循环的调度延迟
+ */
+
+#ifndef TEST_SCHEDULER_H
+#define TEST_SCHEDULER_H
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 调度器任务通知位 */
+#define TEST_SCHED_NOTIFY_TICK  (1UL << 0)              /*!< 周期节拍到达 */
+#define TEST_SCHED_NOTIFY_STOP  (1UL << 1)              /*!< 请求停止，中止当前等待 */
+
+/* 最小周期(微秒)，更短的周期会使esp_timer任务负载过高 */
+#define TEST_SCHED_MIN_PERIOD_US 500
+
+/* 调度器结构体 */
+typedef struct {
+    esp_timer_handle_t timer;                           /*!< 周期定时器句柄 */
+    TaskHandle_t task;                                  /*!< 被驱动的任务 */
+    uint32_t period_us;                                 /*!< 周期(微秒) */
+    int64_t start_us;                                   /*!< 定时器启动时间(微秒) */
+    volatile uint32_t fired_ticks;                      /*!< 定时器已触发的节拍数 */
+    uint32_t consumed_ticks;                            /*!< 任务已处理的节拍数 */
+    volatile bool stop_requested;                       /*!< 已请求停止 */
+} test_scheduler_t;
+
+/* 单个节拍的调度信息 */
+typedef struct {
+    uint32_t tick;                                      /*!< 当前节拍序号(从1开始) */
+    uint32_t missed;                                    /*!< 本次等待前丢失的节拍数(超时) */
+    int32_t lateness_us;                                /*!< 相对理想节拍时刻的延迟(微秒) */
+    int64_t timestamp_us;                               /*!< 任务被唤醒的时间(微秒) */
+} test_scheduler_tick_t;
+
+/**
+ * @brief 启动调度器
+ *
+ * 创建并启动周期定时器，每个周期通过任务通知唤醒指定任务
+ *
+ * @param sched 调度器
+ * @param task 被驱动的任务句柄
+ * @param period_ms 周期(毫秒)
+ * @return esp_err_t
+ *         - ESP_OK: 启动成功
+ *         - ESP_ERR_INVALID_ARG: 参数无效
+ *         - 其他: 定时器创建或启动失败
+ */
+esp_err_t test_scheduler_start(test_scheduler_t *sched, TaskHandle_t task, uint32_t period_ms);
+
+/**
+ * @brief 以微秒周期启动调度器
+ *
+ * 用于短于系统节拍的采样周期
+ *
+ * @param sched 调度器
+ * @param task 被驱动的任务句柄
+ * @param period_us 周期(微秒，不小于TEST_SCHED_MIN_PERIOD_US)
+ * @return esp_err_t
+ *         - ESP_OK: 启动成功
+ *         - ESP_ERR_INVALID_ARG: 参数无效
+ *         - 其他: 定时器创建或启动失败
+ */
+esp_err_t test_scheduler_start_us(test_scheduler_t *sched, TaskHandle_t task, uint32_t period_us);
+
+/**
+ * @brief 等待下一个节拍
+ *
+ * 必须在被驱动的任务中调用
+ *
+ * @param sched 调度器
+ * @param tick 输出的节拍调度信息
+ * @param timeout 最长等待时间(系统节拍)
+ * @return esp_err_t
+ *         - ESP_OK: 节拍到达
+ *         - ESP_ERR_TIMEOUT: 等待超时
+ *         - ESP_ERR_INVALID_STATE: 已请求停止
+ */
+esp_err_t test_scheduler_wait(test_scheduler_t *sched, test_scheduler_tick_t *tick, TickType_t timeout);
+
+/**
+ * @brief 请求停止被驱动的任务
+ *
+ * 可在其他任务中调用，正在等待节拍的任务立即返回，
+ * 之后的test_scheduler_wait都返回ESP_ERR_INVALID_STATE
+ *
+ * @param sched 调度器
+ */
+void test_scheduler_request_stop(test_scheduler_t *sched);
+
+/**
+ * @brief 停止并删除调度器定时器
+ *
+ * @param sched 调度器
+ */
+void test_scheduler_stop(test_scheduler_t *sched);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_SCHEDULER_H */
@@ -0,0 +1,435 @@
+/**
+ * @file test_trigger.c
+ * @brief 电流通道触发捕获模块实现
+ */
+
+#include "test_trigger.h"
+#include "test_scheduler.h"
+#include "sd.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "TEST_TRIGGER";
+
+#define TEST_TRIGGER_MASK (TEST_TRIGGER_DEPTH - 1)
+
+/* 捕获状态 */
+typedef enum {
+    TRIGGER_STATE_ARMED = 0,                             /*!< 已布防，等待触发 */
+    TRIGGER_STATE_POST,                                  /*!< 已触发，采集触发后样本 */
+    TRIGGER_STATE_DONE,                                  /*!< 单次捕获完成，只更新最新值 */
+} trigger_state_t;
+
+static const char *source_names[] = {
+    [TEST_CAPTURE_SOURCE_IO_STEP] = "io",
+    [TEST_CAPTURE_SOURCE_LEVEL]   = "level",
+    [TEST_CAPTURE_SOURCE_SLOPE]   = "slope",
+    [TEST_CAPTURE_SOURCE_KEY]     = "key",
+    [TEST_CAPTURE_SOURCE_MANUAL]  = "manual",
+};
+
+static test_trigger_config_t trigger_config;
+static test_trigger_stats_t trigger_stats;
+static test_scheduler_t trigger_scheduler;
+static TaskHandle_t trigger_task_handle = NULL;
+static SemaphoreHandle_t trigger_task_exited = NULL;     // 捕获任务退出时释放
+static SemaphoreHandle_t trigger_task_ready = NULL;      // 捕获任务获取ADC后释放，结果在trigger_start_ret
+static esp_err_t trigger_start_ret;
+static volatile bool trigger_running = false;
+static volatile int8_t trigger_pending = -1;             // 外部触发源，-1表示无
+
+// 每通道环形缓冲区，head为该通道累计写入的样本数
+static int16_t trigger_ring[ADS1115_CHANNEL_COUNT][TEST_TRIGGER_DEPTH];
+static volatile uint32_t trigger_head[ADS1115_CHANNEL_COUNT];
+static uint32_t trigger_pos[ADS1115_CHANNEL_COUNT];      // 触发时刻各通道的head
+
+// 写入记录的测试上下文
+static volatile uint32_t context_cycle;
+static volatile uint16_t context_step;
+static volatile uint16_t context_output;
+
+/**
+ * @brief 将一个通道的冻结波形写入文件
+ */
+static void test_trigger_write_channel(FILE *file, uint8_t ch, test_capture_source_t source,
+                                       int64_t trigger_us, uint32_t cycle, uint16_t step, uint16_t output)
+{
+    uint32_t head = trigger_head[ch];
+    uint32_t oldest = (head > TEST_TRIGGER_DEPTH) ? head - TEST_TRIGGER_DEPTH : 0;
+    uint32_t start = (trigger_pos[ch] > trigger_config.pre_samples) ?
+                     trigger_pos[ch] - trigger_config.pre_samples : 0;
+    if (start < oldest) {
+        start = oldest;
+    }
+    uint16_t count = head - start;
+    if (count == 0) {
+        return;
+    }
+
+    // 峰值和终值(最后1/8样本平均)
+    int16_t peak_raw = trigger_ring[ch][start & TEST_TRIGGER_MASK];
+    int32_t tail_sum = 0;
+    uint16_t tail = (count >= 8) ? count / 8 : 1;
+    for (uint32_t i = start; i < head; i++) {
+        int16_t raw = trigger_ring[ch][i & TEST_TRIGGER_MASK];
+        if (raw > peak_raw) {
+            peak_raw = raw;
+        }
+        if (i >= head - tail) {
+            tail_sum += raw;
+        }
+    }
+
+    float lsb_ma = ads1115_raw_to_current_ma(1);
+    test_capture_header_t header = {
+        .magic = TEST_CAPTURE_MAGIC,
+        .version = TEST_CAPTURE_VERSION,
+        .header_size = sizeof(test_capture_header_t),
+        .cycle = cycle,
+        .step = step,
+        .output = output,
+        .channel = ch,
+        .sample_count = count,
+        .sample_period_us = trigger_stats.sample_period_us,
+        .timestamp_us = trigger_us - (int64_t)(trigger_pos[ch] - start) * trigger_stats.sample_period_us,
+        .lsb_ma = lsb_ma,
+        .peak_ma = ads1115_raw_to_current_ma(peak_raw),
+        .final_ma = (float)tail_sum / tail * lsb_ma,
+        .settle_us = 0,
+        .trigger_index = trigger_pos[ch] - start,
+        .trigger_source = source,
+    };
+    fwrite(&header, sizeof(header), 1, file);
+
+    // 环形缓冲区可能跨越末尾，分两段写入
+    uint32_t first = start & TEST_TRIGGER_MASK;
+    uint32_t span = TEST_TRIGGER_DEPTH - first;
+    if (span >= count) {
+        fwrite(&trigger_ring[ch][first], sizeof(int16_t), count, file);
+    } else {
+        fwrite(&trigger_ring[ch][first], sizeof(int16_t), span, file);
+        fwrite(&trigger_ring[ch][0], sizeof(int16_t), count - span, file);
+    }
+}
+
+/**
+ * @brief 将所有通道的冻结波形写入SD卡
+ */
+static void test_trigger_save(test_capture_source_t source, int64_t trigger_us,
+                              uint32_t cycle, uint16_t step, uint16_t output)
+{
+    FILE *file = sd_card_is_mounted() ? fopen(TEST_CAPTURE_FILE_PATH, "ab") : NULL;
+    if (file == NULL) {
+        trigger_stats.save_errors++;
+        return;
+    }
+
+    for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT; ch++) {
+        if (trigger_config.channel_mask & (1 << ch)) {
+            test_trigger_write_channel(file, ch, source, trigger_us, cycle, step, output);
+        }
+    }
+    fclose(file);
+
+    trigger_stats.saved_count++;
+    ESP_LOGI(TAG, "触发捕获已保存 (触发源: %s, 步骤%d)", test_trigger_source_str(source), step);
+}
+
+/**
+ * @brief 捕获任务
+ *
+ * 每个节拍读取当前通道的转换结果，再切换到下一个通道开始转换。
+ * ADC互斥锁由本任务获取和释放(互斥锁只能由持有的任务释放)，
+ * 获取结果通过trigger_task_ready交给test_trigger_start
+ */
+static void test_trigger_task(void *arg)
+{
+    // 捕获期间独占ADC
+    esp_err_t ret = ads1115_lock(pdMS_TO_TICKS(I2C_MASTER_TIMEOUT_MS));
+    if (ret == ESP_OK) {
+        ret = ads1115_continuous_start(__builtin_ctz(trigger_config.channel_mask));
+        if (ret != ESP_OK) {
+            ads1115_unlock();
+        }
+    }
+    trigger_start_ret = ret;
+    if (ret != ESP_OK) {
+        trigger_running = false;
+        trigger_task_handle = NULL;
+        xSemaphoreGive(trigger_task_ready);
+        vTaskDelete(NULL);
+        return;
+    }
+    xSemaphoreGive(trigger_task_ready);
+    
+    uint8_t channels[ADS1115_CHANNEL_COUNT];
+    uint8_t channel_count = 0;
+    for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT; ch++) {
+        if (trigger_config.channel_mask & (1 << ch)) {
+            channels[channel_count++] = ch;
+        }
+    }
+
+    // 阈值预先换算为原始值，采样路径只做整数比较
+    float lsb_ma = ads1115_raw_to_current_ma(1);
+    int32_t level_raw = (int32_t)(trigger_config.level_ma / lsb_ma);
+    int32_t slope_raw = (int32_t)(trigger_config.slope_ma / lsb_ma);
+
+    uint32_t period_us = (channel_count > 1) ? TEST_TRIGGER_PERIOD_MULTI_US : TEST_TRIGGER_PERIOD_SINGLE_US;
+    trigger_stats.sample_period_us = period_us * channel_count;
+
+    trigger_state_t state = TRIGGER_STATE_ARMED;
+    uint32_t post_left = 0;
+    test_capture_source_t source = TEST_CAPTURE_SOURCE_MANUAL;
+    int64_t trigger_us = 0;
+    uint32_t trig_cycle = 0;
+    uint16_t trig_step = 0, trig_output = 0;
+    uint8_t index = 0;
+    bool resync = false;
+
+    if (test_scheduler_start_us(&trigger_scheduler, xTaskGetCurrentTaskHandle(), period_us) != ESP_OK) {
+        trigger_running = false;
+    }
+
+    while (trigger_running) {
+        test_scheduler_tick_t tick;
+        if (test_scheduler_wait(&trigger_scheduler, &tick, pdMS_TO_TICKS(100)) != ESP_OK) {
+            continue;
+        }
+        // 写SD卡期间的节拍不计为丢失
+        if (tick.missed > 0 && !resync) {
+            trigger_stats.missed_ticks += tick.missed;
+        }
+        resync = false;
+
+        uint8_t ch = channels[index];
+        int16_t raw;
+        if (ads1115_continuous_read(&raw) != ESP_OK) {
+            trigger_stats.read_errors++;
+            continue;
+        }
+
+        uint32_t head = trigger_head[ch];
+        int16_t prev = (head > 0) ? trigger_ring[ch][(head - 1) & TEST_TRIGGER_MASK] : raw;
+        trigger_ring[ch][head & TEST_TRIGGER_MASK] = raw;
+        trigger_head[ch] = head + 1;
+        trigger_stats.sample_count++;
+
+        // 切换到下一个通道，下个节拍读取其转换结果
+        if (channel_count > 1) {
+            index = (index + 1) % channel_count;
+            ads1115_continuous_select(channels[index]);
+        }
+
+        if (state == TRIGGER_STATE_ARMED) {
+            int8_t fired = -1;
+            if ((trigger_config.source_mask & TEST_TRIGGER_SRC(TEST_CAPTURE_SOURCE_LEVEL)) &&
+                head > 0 && prev < level_raw && raw >= level_raw) {
+                fired = TEST_CAPTURE_SOURCE_LEVEL;
+            } else if ((trigger_config.source_mask & TEST_TRIGGER_SRC(TEST_CAPTURE_SOURCE_SLOPE)) &&
+                       head > 0 && abs(raw - prev) >= slope_raw) {
+                fired = TEST_CAPTURE_SOURCE_SLOPE;
+            } else if (trigger_pending >= 0) {
+                fired = trigger_pending;
+            }
+            trigger_pending = -1;
+
+            if (fired >= 0) {
+                source = (test_capture_source_t)fired;
+                trigger_us = tick.timestamp_us;
+                trig_cycle = context_cycle;
+                trig_step = context_step;
+                trig_output = context_output;
+                for (uint8_t i = 0; i < ADS1115_CHANNEL_COUNT; i++) {
+                    trigger_pos[i] = trigger_head[i];
+                }
+                post_left = (uint32_t)trigger_config.post_samples * channel_count;
+                trigger_stats.trigger_count[source]++;
+                state = TRIGGER_STATE_POST;
+            }
+        } else if (state == TRIGGER_STATE_POST && --post_left == 0) {
+            // 触发后样本采集完成，冻结并写入
+            test_trigger_save(source, trigger_us, trig_cycle, trig_step, trig_output);
+            resync = true;
+
+            if (trigger_config.auto_rearm) {
+                // 重新积累触发前样本
+                for (uint8_t i = 0; i < ADS1115_CHANNEL_COUNT; i++) {
+                    trigger_head[i] = 0;
+                }
+                trigger_pending = -1;
+                state = TRIGGER_STATE_ARMED;
+            } else {
+                state = TRIGGER_STATE_DONE;
+            }
+        }
+    }
+
+    test_scheduler_stop(&trigger_scheduler);
+    ads1115_continuous_stop();
+    ads1115_unlock();
+
+    ESP_LOGI(TAG, "捕获任务结束 (样本: %lu, 保存: %lu)", trigger_stats.sample_count, trigger_stats.saved_count);
+    trigger_task_handle = NULL;
+    xSemaphoreGive(trigger_task_exited);
+    vTaskDelete(NULL);
+}
+
+esp_err_t test_trigger_start(const test_trigger_config_t *config)
+{
+    if (config == NULL || (config->channel_mask & 0x0F) == 0 || config->source_mask == 0 ||
+        config->pre_samples + config->post_samples > TEST_TRIGGER_DEPTH || config->post_samples == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (trigger_task_handle != NULL || ads1115_get_handle() == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // 停止时等待任务退出的信号，启动时等待任务获取ADC的信号
+    if (trigger_task_exited == NULL) {
+        trigger_task_exited = xSemaphoreCreateBinary();
+        if (trigger_task_exited == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (trigger_task_ready == NULL) {
+        trigger_task_ready = xSemaphoreCreateBinary();
+        if (trigger_task_ready == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    xSemaphoreTake(trigger_task_exited, 0);
+    xSemaphoreTake(trigger_task_ready, 0);
+
+    trigger_config = *config;
+    trigger_config.channel_mask &= 0x0F;
+    memset(&trigger_stats, 0, sizeof(trigger_stats));
+    for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT; ch++) {
+        trigger_head[ch] = 0;
+    }
+    trigger_pending = -1;
+
+    // 优先级高于测试任务，保证采样节拍
+    trigger_running = true;
+    if (xTaskCreate(test_trigger_task, "trigger_task", 4096, NULL, 6, &trigger_task_handle) != pdPASS) {
+        trigger_running = false;
+        trigger_task_handle = NULL;
+        ESP_LOGE(TAG, "创建捕获任务失败");
+        return ESP_FAIL;
+    }
+
+    // 任务获取ADC最多等待I2C超时
+    if (xSemaphoreTake(trigger_task_ready, pdMS_TO_TICKS(I2C_MASTER_TIMEOUT_MS + 100)) != pdTRUE) {
+        test_trigger_stop();
+        return ESP_ERR_TIMEOUT;
+    }
+    if (trigger_start_ret != ESP_OK) {
+        return trigger_start_ret;
+    }
+
+    ESP_LOGI(TAG, "触发捕获已布防 (通道掩码: 0x%X, 触发源掩码: 0x%X)",
+             trigger_config.channel_mask, trigger_config.source_mask);
+    return ESP_OK;
+}
+
+void test_trigger_stop(void)
+{
+    if (trigger_task_handle == NULL) {
+        return;
+    }
+
+    trigger_running = false;
+    test_scheduler_request_stop(&trigger_scheduler);
+
+    // 中止节拍等待后，捕获任务最多在一次SD写入后退出
+    if (xSemaphoreTake(trigger_task_exited, pdMS_TO_TICKS(TEST_TRIGGER_STOP_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "等待捕获任务退出超时");
+    }
+}
+
+bool test_trigger_is_running(void)
+{
+    return trigger_task_handle != NULL;
+}
+
+void test_trigger_fire(test_capture_source_t source)
+{
+    if (trigger_running && (trigger_config.source_mask & TEST_TRIGGER_SRC(source))) {
+        trigger_pending = (int8_t)source;
+    }
+}
+
+void test_trigger_set_context(uint32_t cycle, uint16_t step, uint16_t output)
+{
+    context_cycle = cycle;
+    context_step = step;
+    context_output = output;
+}
+
+esp_err_t test_trigger_get_latest(ads1115_channel_data_t channel_data[ADS1115_CHANNEL_COUNT])
+{
+    if (trigger_task_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (uint8_t ch = 0; ch < ADS1115_CHANNEL_COUNT; ch++) {
+        uint32_t head = trigger_head[ch];
+        if (head == 0) {
+            channel_data[ch].status = ESP_ERR_INVALID_STATE;
+            continue;
+        }
+
+        int16_t raw = trigger_ring[ch][(head - 1) & TEST_TRIGGER_MASK];
+        channel_data[ch].raw_value = raw;
+        channel_data[ch].voltage_v = (float)raw * 4.096f / 32768.0f;
+        channel_data[ch].current_ma = ads1115_raw_to_current_ma(raw);
+        channel_data[ch].status = ESP_OK;
+    }
+
+    return ESP_OK;
+}
+
+const test_trigger_stats_t *test_trigger_get_stats(void)
+{
+    return &trigger_stats;
+}
+
+esp_err_t test_trigger_parse_sources(const char *list, uint8_t *mask)
+{
+    char buffer[64];
+    strncpy(buffer, list, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+
+    uint8_t result = 0;
+    char *saveptr;
+    for (char *name = strtok_r(buffer, ",", &saveptr); name != NULL; name = strtok_r(NULL, ",", &saveptr)) {
+        size_t i;
+        for (i = 0; i < sizeof(source_names) / sizeof(source_names[0]); i++) {
+            if (strcmp(name, source_names[i]) == 0) {
+                result |= TEST_TRIGGER_SRC(i);
+                break;
+            }
+        }
+        if (i == sizeof(source_names) / sizeof(source_names[0])) {
+            return ESP_ERR_NOT_FOUND;
+        }
+    }
+
+    *mask = result;
+    return ESP_OK;
+}
+
+const char *test_trigger_source_str(test_capture_source_t source)
+{
+    if ((size_t)source < sizeof(source_names) / sizeof(source_names[0])) {
+        return source_names[source];
+    }
+    return "unknown";
+}
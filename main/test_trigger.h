@@ -0,0 +1,151 @@
+/**
+ * @file test_trigger.h
+ * @brief 电流通道触发捕获模块头文件
+ *
+ * 独立的捕获任务以ADS1115连续转换模式轮流采样选定通道，
+ * 每个通道保存一个环形预触发缓冲区。满足触发条件(电平、斜率、
+ * 按键事件、IO切换或手动)后继续采集触发后样本，随后冻结缓冲区，
+ * 以test_capture的二进制记录格式写入SD卡。
+ *
+ * 捕获任务运行期间独占ADC，测试任务通过test_trigger_get_latest()
+ * 获取各通道的最新值，不再自行扫描。
+ */
+
+#ifndef TEST_TRIGGER_H
+#define TEST_TRIGGER_H
+
+#include "esp_err.h"
+#include "i2c_config.h"
+#include "test_capture.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 触发捕获配置常量 */
+#define TEST_TRIGGER_DEPTH            256                /*!< 每通道环形缓冲区深度(2的幂) */
+#define TEST_TRIGGER_PERIOD_SINGLE_US 1250               /*!< 单通道采样周期(微秒，约800SPS) */
+#define TEST_TRIGGER_PERIOD_MULTI_US  2000               /*!< 多通道轮流采样周期(含通道切换) */
+#define TEST_TRIGGER_DEFAULT_PRE      64                 /*!< 默认触发前样本数(每通道) */
+#define TEST_TRIGGER_DEFAULT_POST     192                /*!< 默认触发后样本数(每通道) */
+#define TEST_TRIGGER_STOP_TIMEOUT_MS  1000               /*!< 等待捕获任务退出的最长时间(含一次SD写入) */
+
+/* 触发源掩码 */
+#define TEST_TRIGGER_SRC(source)      (1U << (source))   /*!< test_capture_source_t转换为掩码 */
+
+/* 触发捕获配置 */
+typedef struct {
+    bool enabled;                                        /*!< 测试运行时是否启用 */
+    bool auto_rearm;                                     /*!< 写入后自动重新布防 */
+    uint8_t channel_mask;                                /*!< 采样通道掩码 */
+    uint8_t source_mask;                                 /*!< 触发源掩码 */
+    uint16_t pre_samples;                                /*!< 每通道触发前样本数 */
+    uint16_t post_samples;                               /*!< 每通道触发后样本数 */
+    float level_ma;                                      /*!< 电平触发阈值(上升越过，毫安) */
+    float slope_ma;                                      /*!< 斜率触发阈值(相邻样本差，毫安) */
+} test_trigger_config_t;
+
+/* 触发捕获统计 */
+typedef struct {
+    uint32_t sample_count;                               /*!< 总样本数 */
+    uint32_t missed_ticks;                               /*!< 丢失的采样节拍 */
+    uint32_t read_errors;                                /*!< ADC读取失败次数 */
+    uint32_t trigger_count[TEST_CAPTURE_SOURCE_MANUAL + 1]; /*!< 各触发源的触发次数 */
+    uint32_t saved_count;                                /*!< 已写入SD卡的捕获次数 */
+    uint32_t save_errors;                                /*!< 写入失败次数 */
+    uint32_t sample_period_us;                           /*!< 每通道采样间隔(微秒) */
+} test_trigger_stats_t;
+
+/**
+ * @brief 启动捕获任务并布防
+ *
+ * 获取ADC独占访问权并切换到连续转换模式
+ *
+ * @param config 触发配置
+ * @return esp_err_t
+ *         - ESP_OK: 启动成功
+ *         - ESP_ERR_INVALID_ARG: 配置无效
+ *         - ESP_ERR_INVALID_STATE: 已在运行或ADS1115不可用
+ *         - ESP_ERR_TIMEOUT: ADC被占用
+ *         - ESP_FAIL: 任务创建失败
+ */
+esp_err_t test_trigger_start(const test_trigger_config_t *config);
+
+/**
+ * @brief 停止捕获任务
+ *
+ * 中止捕获任务的节拍等待并等待其退出，任务退出后立即返回；
+ * 任务退出时恢复ADC单次转换模式并释放访问权
+ */
+void test_trigger_stop(void);
+
+/**
+ * @brief 捕获任务是否在运行
+ *
+ * @return true: 运行中
+ */
+bool test_trigger_is_running(void);
+
+/**
+ * @brief 外部事件触发
+ *
+ * 可在任意任务中调用；未布防或触发源未启用时忽略
+ *
+ * @param source 触发源
+ */
+void test_trigger_fire(test_capture_source_t source);
+
+/**
+ * @brief 更新写入捕获记录的测试上下文
+ *
+ * @param cycle 测试循环计数
+ * @param step 步骤号(从1开始)
+ * @param output 当前TCA9535输出字
+ */
+void test_trigger_set_context(uint32_t cycle, uint16_t step, uint16_t output);
+
+/**
+ * @brief 获取各通道的最新采样值
+ *
+ * 未采样的通道status为ESP_ERR_INVALID_STATE
+ *
+ * @param channel_data 输出的通道数据
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_STATE: 捕获任务未运行
+ */
+esp_err_t test_trigger_get_latest(ads1115_channel_data_t channel_data[ADS1115_CHANNEL_COUNT]);
+
+/**
+ * @brief 获取触发捕获统计
+ *
+ * @return 统计指针
+ */
+const test_trigger_stats_t *test_trigger_get_stats(void);
+
+/**
+ * @brief 解析触发源列表
+ *
+ * @param list 逗号分隔的触发源(level,slope,key,io,manual)
+ * @param mask 输出的触发源掩码
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_NOT_FOUND: 包含未知触发源
+ */
+esp_err_t test_trigger_parse_sources(const char *list, uint8_t *mask);
+
+/**
+ * @brief 获取触发源名称
+ *
+ * @param source 触发源
+ * @return 名称
+ */
+const char *test_trigger_source_str(test_capture_source_t source);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_TRIGGER_H */